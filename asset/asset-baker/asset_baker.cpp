@@ -5,6 +5,12 @@
 #include <unordered_map>
 #include <unordered_set>
 #include <limits>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <algorithm>
+#include <sstream>
+#include <iterator>
 
 #include "json.hpp"
 
@@ -13,9 +19,13 @@
 #include "stb_image.h"
 #include "stb_image_resize.h"
 
+#include "lz4hc.h"
+
 #include "asset_loader.h"
+#include "compression.h"
 #include "texture_asset.h"
 #include "vk_mesh_asset.h"
+#include "bc_compression.h"
 
 #define TINYGLTF_IMPLEMENTATION
 #include "tiny_gltf.h"
@@ -38,11 +48,49 @@ using namespace assets;
 struct ConverterState {
 	fs::path asset_path;
 	fs::path export_path;
+	// how each kind of asset is compressed, numThreads is the threads each job may use to compress its output
+	CompressionSettings textureCompression;
+	CompressionSettings meshCompression;
+	CompressionSettings skeletonCompression;
+	// encode textures as BC4/BC5/BC7 instead of RGBA8
+	bool blockCompressTextures;
 
 	fs::path convertToExportRelative(fs::path path) const;
 };
 
-bool convertImage(const fs::path& input, const fs::path& output)
+// Picks the block compressed format for a texture based on the suffix of its name. Roughness, ao and metal
+// maps only carry one value, so we keep the channel pbr.frag samples them from and store it as BC4
+bool blockFormatForTexture(const std::string& suffix, TextureFormat& formatOut, BlockFormat& blockFormatOut, uint32_t& channelOut)
+{
+	channelOut = 0;
+
+	if (suffix == "_diff") {
+		formatOut = TextureFormat::BC7_SRGB;
+		blockFormatOut = BlockFormat::BC7;
+	} else if (suffix == "_norm") {
+		// z is reconstructed in the shader
+		formatOut = TextureFormat::BC5;
+		blockFormatOut = BlockFormat::BC5;
+	} else if (suffix == "_roug") {
+		formatOut = TextureFormat::BC4;
+		blockFormatOut = BlockFormat::BC4;
+		channelOut = 1;
+	} else if (suffix == "_ao__") {
+		formatOut = TextureFormat::BC4;
+		blockFormatOut = BlockFormat::BC4;
+		channelOut = 0;
+	} else if (suffix == "_meta") {
+		formatOut = TextureFormat::BC4;
+		blockFormatOut = BlockFormat::BC4;
+		channelOut = 2;
+	} else {
+		return false;
+	}
+
+	return true;
+}
+
+bool convertImage(const fs::path& input, const fs::path& output, const ConverterState& convState)
 {
 	int texWidth, texHeight, texChannels;
 
@@ -68,7 +116,8 @@ bool convertImage(const fs::path& input, const fs::path& output)
 
 
 	std::string s{ input.filename().generic_string() };
-	bool colorTexture{ s.size() >= 9 && (s.substr(s.size() - 9, 5) == "_diff") };
+	std::string suffix{ s.size() >= 9 ? s.substr(s.size() - 9, 5) : "" };
+	bool colorTexture{ suffix == "_diff" };
 
 	texinfo.textureFormat = colorTexture ? TextureFormat::SRGBA8 : TextureFormat::RGBA8;
 	texinfo.originalFile = input.string();
@@ -86,10 +135,10 @@ bool convertImage(const fs::path& input, const fs::path& output)
 	uint32_t height{ texinfo.height };
 	uint32_t miplevels{ 1 };
 
-	// make mipmaps
+	// make mipmaps, each level halves both dimensions (but never below 1) until we reach 1x1
 	while (width > 1 || height > 1) {
-		width >>= 1;
-		height >>= 1;
+		width = std::max(width >> 1, 1u);
+		height = std::max(height >> 1, 1u);
 		allBufferSize += (size_t)width * height * 4;
 		++miplevels;
 	}
@@ -103,11 +152,13 @@ bool convertImage(const fs::path& input, const fs::path& output)
 
 	memcpy(ptr, pixels, mipSize);
 
-	while (mipSize > 0) {
-		stbir_resize_uint8(ptr, width, height, 0, ptr + mipSize, width / 2, height / 2, 0, 4);
+	for (uint32_t i{ 1 }; i < miplevels; ++i) {
+		uint32_t nextWidth{ std::max(width >> 1, 1u) };
+		uint32_t nextHeight{ std::max(height >> 1, 1u) };
+		stbir_resize_uint8(ptr, width, height, 0, ptr + mipSize, nextWidth, nextHeight, 0, 4);
 		ptr += mipSize;
-		width >>= 1;
-		height >>= 1;
+		width = nextWidth;
+		height = nextHeight;
 		mipSize = (size_t)width * height * 4;
 	}
 
@@ -116,11 +167,41 @@ bool convertImage(const fs::path& input, const fs::path& output)
 
 	std::cout << "creating mipmaps took " << std::chrono::duration_cast<std::chrono::nanoseconds>(mipDiff).count() / 1000000.0 << "ms" << std::endl;
 
+	BlockFormat blockFormat;
+	uint32_t channel;
+	if (convState.blockCompressTextures && blockFormatForTexture(suffix, texinfo.textureFormat, blockFormat, channel)) {
+		auto bcStart{ std::chrono::high_resolution_clock::now() };
+
+		// encode every level of the RGBA mip chain, the levels stay tightly packed one after another
+		size_t blocksSize{ 0 };
+		for (uint32_t i{ 0 }; i < miplevels; ++i) {
+			blocksSize += blockCompressedSize(blockFormat, std::max(texinfo.width >> i, 1u), std::max(texinfo.height >> i, 1u));
+		}
+
+		std::vector<unsigned char> blocks(blocksSize);
+		const unsigned char* src{ allBuffer.data() };
+		unsigned char* dst{ blocks.data() };
+
+		for (uint32_t i{ 0 }; i < miplevels; ++i) {
+			width = std::max(texinfo.width >> i, 1u);
+			height = std::max(texinfo.height >> i, 1u);
+			compressBlocks(blockFormat, src, width, height, channel, dst, convState.textureCompression.numThreads);
+			src += (size_t)width * height * 4;
+			dst += blockCompressedSize(blockFormat, width, height);
+		}
+
+		allBuffer.swap(blocks);
+
+		auto bcEnd{ std::chrono::high_resolution_clock::now() };
+		std::cout << "block compressing to " << textureFormatName(texinfo.textureFormat) << " took "
+			<< std::chrono::duration_cast<std::chrono::nanoseconds>(bcEnd - bcStart).count() / 1000000.0 << "ms" << std::endl;
+	}
+
 	texinfo.originalSize = allBuffer.size();
 	assets::AssetFile newImage{ assets::packTexture(&texinfo, allBuffer.data()) };
 
 	nlohmann::json textureMetadata;
-	textureMetadata["format"] = "RGBA8";
+	textureMetadata["format"] = textureFormatName(texinfo.textureFormat);
 	textureMetadata["original_size"] = texinfo.originalSize;
 	textureMetadata["original_file"] = texinfo.originalFile;
 	textureMetadata["miplevels"] = texinfo.miplevels;
@@ -130,7 +211,7 @@ bool convertImage(const fs::path& input, const fs::path& output)
 	stbi_image_free(pixels);
 
 	// will write compression_mode field of textureMetadata, and write that to newImage before saving
-	saveBinaryFile(output.string().c_str(), textureMetadata, newImage);
+	saveBinaryFile(output.string().c_str(), textureMetadata, newImage, convState.textureCompression);
 
 	return true;
 }
@@ -407,7 +488,7 @@ std::string calculateSkeletonNameGLTF()
 }
 
 template <typename VFormat>
-bool extractMeshesGLTF(tinygltf::Model& model, const fs::path& input, const fs::path& outputFolder, const ConverterState& convState, VertexFormat vertexFormatEnum)
+bool extractMeshesGLTF(tinygltf::Model& model, const fs::path& input, const fs::path& outputFolder, const ConverterState& convState, VertexFormat vertexFormatEnum, std::vector<fs::path>& outputs)
 {
 	/*
 		Note: meshes are what we normally think of as meshes, but primitives do NOT refer to triangles in this case.
@@ -481,7 +562,8 @@ bool extractMeshesGLTF(tinygltf::Model& model, const fs::path& input, const fs::
 			fs::path meshpath = outputFolder / (meshname + ".mesh");
 
 			//save to disk
-			saveBinaryFile(meshpath.string().c_str(), metadata, newFile);
+			saveBinaryFile(meshpath.string().c_str(), metadata, newFile, convState.meshCompression);
+			outputs.push_back(meshpath);
 		}
 	}
 	return true;
@@ -692,10 +774,67 @@ void loadNode(SkeletalAnimationDataAsset& data, const tinygltf::Node& node, cons
 	}
 
 	data.nodes.push_back(newNode);
-	data.linearNodes.push_back(newNode);
 }
 
-void extractSkeletalAnimation(tinygltf::Model gltfModel, const fs::path& input, const fs::path& outputFolder)
+// Reorder the nodes breadth first from the roots, so every parent comes before its children,
+// and remap every node index in data to the new order. Returns false if the hierarchy isn't a tree
+bool sortNodes(SkeletalAnimationDataAsset& data)
+{
+	std::vector<int32_t> order;
+	order.reserve(data.nodes.size());
+	for (int32_t i = 0; i < data.nodes.size(); ++i) {
+		if (data.nodes[i].parentIdx < 0) {
+			order.push_back(i);
+		}
+	}
+	for (size_t i = 0; i < order.size(); ++i) {
+		for (int32_t child : data.nodes[order[i]].children) {
+			order.push_back(child);
+		}
+	}
+
+	if (order.size() != data.nodes.size()) {
+		std::cout << "Error: node hierarchy isn't a tree\n";
+		return false;
+	}
+
+	std::vector<int32_t> newIdx(data.nodes.size());
+	for (int32_t i = 0; i < order.size(); ++i) {
+		newIdx[order[i]] = i;
+	}
+
+	auto remap = [&](int32_t idx) { return idx < 0 ? idx : newIdx[idx]; };
+
+	std::vector<NodeAsset> sorted;
+	sorted.reserve(data.nodes.size());
+	for (int32_t oldIdx : order) {
+		NodeAsset node{ data.nodes[oldIdx] };
+		node.parentIdx = remap(node.parentIdx);
+		for (int32_t& child : node.children) {
+			child = remap(child);
+		}
+		sorted.push_back(node);
+	}
+	data.nodes = std::move(sorted);
+
+	for (Animation& animation : data.animations) {
+		for (AnimationChannel& channel : animation.channels) {
+			channel.nodeIdx = static_cast<uint32_t>(remap(static_cast<int32_t>(channel.nodeIdx)));
+		}
+	}
+
+	for (SkinAsset& skin : data.skins) {
+		skin.skeletonRootIdx = remap(skin.skeletonRootIdx);
+		skin.meshNodeIdx = remap(skin.meshNodeIdx);
+		for (int32_t& joint : skin.joints) {
+			joint = remap(joint);
+		}
+	}
+
+	return true;
+}
+
+bool extractSkeletalAnimation(tinygltf::Model gltfModel, const fs::path& input, const fs::path& outputFolder, const ConverterState& convState, std::vector<fs::path>& outputs)
 {
 	std::string error;
 
@@ -724,16 +863,510 @@ void extractSkeletalAnimation(tinygltf::Model gltfModel, const fs::path& input,
 
 	loadSkins(data, gltfModel, meshNodeIdx);
 
-	// serialize
-	std::string skelName{ calculateSkeletonNameGLTF() };
-	fs::path skelPath = outputFolder / (skelName + ".skel");
+	// the engine poses the nodes in order, so a skeleton it can't sort is useless
+	if (!sortNodes(data)) {
+		return false;
+	}
 
+	// serialize, then store it like any other asset so it can be compressed
+	std::ostringstream oss{ std::ios::binary };
 	{
-		std::ofstream ofs{ skelPath, std::ios::binary };
-		cereal::BinaryOutputArchive oarchive(ofs);
+		cereal::BinaryOutputArchive oarchive(oss);
 
 		oarchive(data);
 	}
+	std::string serialized{ oss.str() };
+
+	assets::AssetFile file;
+	file.type[0] = 'S';
+	file.type[1] = 'K';
+	file.type[2] = 'E';
+	file.type[3] = 'L';
+	file.version = 1;
+	file.binaryBlob.assign(serialized.begin(), serialized.end());
+
+	nlohmann::json metadata;
+	metadata["original_file"] = input.string();
+
+	std::string skelName{ calculateSkeletonNameGLTF() };
+	fs::path skelPath = outputFolder / (skelName + ".skel");
+
+	saveBinaryFile(skelPath.string().c_str(), metadata, file, convState.skeletonCompression);
+	outputs.push_back(skelPath);
+	return true;
+}
+
+// dependencies gets the external buffers and images the file references, outputs every file written
+bool convertGLTF(const fs::path& input, const fs::path& outputFolder, const ConverterState& convState, std::vector<fs::path>& dependencies, std::vector<fs::path>& outputs)
+{
+	tinygltf::Model model;
+	tinygltf::TinyGLTF loader;
+	std::string err;
+	std::string warn;
+
+	bool ret = loader.LoadASCIIFromFile(&model, &err, &warn, input.string().c_str());
+
+	if (!warn.empty()) {
+		printf("Warn: %s\n", warn.c_str());
+	}
+
+	if (!err.empty()) {
+		printf("Err: %s\n", err.c_str());
+	}
+
+	if (!ret) {
+		printf("Failed to parse glTF\n");
+		return false;
+	}
+
+	auto addDependency = [&](const std::string& uri) {
+		if (!uri.empty() && !tinygltf::IsDataURI(uri)) {
+			dependencies.push_back((input.parent_path() / tinygltf::dlib::urldecode(uri)).lexically_normal());
+		}
+	};
+	for (const tinygltf::Buffer& buffer : model.buffers) {
+		addDependency(buffer.uri);
+	}
+	for (const tinygltf::Image& image : model.images) {
+		addDependency(image.uri);
+	}
+
+	// If the mesh is skinned, we must use vertex format which includes skinning data
+	std::cout << "skins: " << model.skins.size() << '\n';
+	if (model.skins.size() == 0) {
+		extractMeshesGLTF<Vertex>(model, input, outputFolder, convState, VertexFormat::DEFAULT, outputs);
+	} else {
+		extractMeshesGLTF<VertexSkinned>(model, input, outputFolder, convState, VertexFormat::SKINNED, outputs);
+		if (!extractSkeletalAnimation(model, input, outputFolder, convState, outputs)) {
+			return false;
+		}
+	}
+
+	//extractMaterialsGLTF(model, input, outputFolder, convState);
+
+	return true;
+}
+
+// Bump whenever the baked output changes so that assets baked by an older baker get rebaked
+constexpr uint32_t BAKER_VERSION{ 6 };
+
+// What a file looked like when it was last baked
+struct FileStamp {
+	uint64_t size;
+	int64_t mtime;
+	// FNV-1a 64 of the file contents, empty until it has been computed
+	std::string hash;
+};
+
+// A file the source references, like a glTF's .bin buffers
+struct ManifestDependency {
+	std::string path;
+	FileStamp stamp;
+};
+
+struct ManifestEntry {
+	FileStamp source;
+	uint32_t bakerVersion;
+	std::string output;
+	// compression settings the output was baked with
+	std::string settings;
+	// changing any of these rebakes the source
+	std::vector<ManifestDependency> dependencies;
+	// every file the bake wrote, the source is rebaked if one of them is missing
+	std::vector<std::string> outputs;
+};
+
+// Keyed by source path relative to the asset directory
+using BakeManifest = std::unordered_map<std::string, ManifestEntry>;
+
+FileStamp readFileStamp(const nlohmann::json& json)
+{
+	FileStamp stamp;
+	stamp.size = json.at("size").get<uint64_t>();
+	stamp.mtime = json.at("mtime").get<int64_t>();
+	stamp.hash = json.at("hash").get<std::string>();
+	return stamp;
+}
+
+void writeFileStamp(const FileStamp& stamp, nlohmann::json& json)
+{
+	json["size"] = stamp.size;
+	json["mtime"] = stamp.mtime;
+	json["hash"] = stamp.hash;
+}
+
+BakeManifest loadManifest(const fs::path& path)
+{
+	BakeManifest manifest;
+
+	std::ifstream file{ path };
+	if (!file.is_open()) {
+		return manifest;
+	}
+
+	nlohmann::json json = nlohmann::json::parse(file, nullptr, false);
+	if (json.is_discarded() || !json.contains("files") || !json["files"].is_object()) {
+		std::cout << "Ignoring unreadable manifest " << path << "\n";
+		return manifest;
+	}
+
+	for (auto& [source, entryJson] : json["files"].items()) {
+		// a malformed entry is dropped, so only that source gets rebaked
+		try {
+			ManifestEntry entry;
+			entry.source = readFileStamp(entryJson);
+			entry.bakerVersion = entryJson.at("baker_version").get<uint32_t>();
+			entry.output = entryJson.at("output").get<std::string>();
+			entry.settings = entryJson.value("settings", "");
+			for (const nlohmann::json& dependencyJson : entryJson.value("dependencies", nlohmann::json::array())) {
+				entry.dependencies.push_back({ dependencyJson.at("path").get<std::string>(), readFileStamp(dependencyJson) });
+			}
+			entry.outputs = entryJson.value("outputs", std::vector<std::string>{});
+			// entries from before outputs were tracked are rebaked once
+			if (!entryJson.contains("outputs")) {
+				entry.bakerVersion = 0;
+			}
+			manifest[source] = entry;
+		} catch (const nlohmann::json::exception& e) {
+			std::cout << "Ignoring malformed manifest entry for " << source << ": " << e.what() << "\n";
+		}
+	}
+
+	return manifest;
+}
+
+void saveManifest(const fs::path& path, const BakeManifest& manifest)
+{
+	nlohmann::json json;
+	json["files"] = nlohmann::json::object();
+
+	for (const auto& [source, entry] : manifest) {
+		nlohmann::json& entryJson{ json["files"][source] };
+		writeFileStamp(entry.source, entryJson);
+		entryJson["baker_version"] = entry.bakerVersion;
+		entryJson["output"] = entry.output;
+		entryJson["settings"] = entry.settings;
+
+		entryJson["dependencies"] = nlohmann::json::array();
+		for (const ManifestDependency& dependency : entry.dependencies) {
+			nlohmann::json dependencyJson;
+			dependencyJson["path"] = dependency.path;
+			writeFileStamp(dependency.stamp, dependencyJson);
+			entryJson["dependencies"].push_back(dependencyJson);
+		}
+		entryJson["outputs"] = entry.outputs;
+	}
+
+	std::ofstream file{ path };
+	if (!file.is_open()) {
+		std::cout << "Error when trying to write manifest: " << path << std::endl;
+		return;
+	}
+	file << json.dump(1, '\t');
+}
+
+std::string hashFile(const fs::path& path)
+{
+	std::ifstream file{ path, std::ios::binary };
+	if (!file.is_open()) {
+		return "";
+	}
+
+	uint64_t hash{ 0xcbf29ce484222325ull };
+	std::vector<char> chunk(1 << 20);
+
+	while (file) {
+		file.read(chunk.data(), chunk.size());
+		std::streamsize readSize{ file.gcount() };
+
+		for (std::streamsize i{ 0 }; i < readSize; ++i) {
+			hash ^= (uint8_t)chunk[i];
+			hash *= 0x100000001b3ull;
+		}
+	}
+
+	char hex[17];
+	snprintf(hex, sizeof(hex), "%016llx", (unsigned long long)hash);
+	return hex;
+}
+
+// zstd defaults high, the files are smaller and decoding is as fast as at low levels
+int defaultCompressionLevel(CompressionCodec codec)
+{
+	switch (codec) {
+	case CompressionCodec::LZ4HC:
+		return LZ4HC_CLEVEL_DEFAULT;
+	case CompressionCodec::Zstd:
+		return 19;
+	default:
+		return 1;
+	}
+}
+
+std::string compressionSettingsKey(const CompressionSettings& settings)
+{
+	std::string key{ std::string{ compressionCodecName(settings.codec) } + " " + std::to_string(settings.level) + " " + std::to_string(settings.thresholdRatio) };
+
+	// a retrained dictionary gets a new id, so everything compressed with the old one is rebaked
+	if (settings.codec == CompressionCodec::Zstd && !settings.dictionary.empty()) {
+		key += " dict " + std::to_string(zstdDictionaryId(settings.dictionary.data(), settings.dictionary.size()));
+	}
+
+	return key;
+}
+
+// zstd dictionaries are capped at a size where they still fit in cache while decoding
+constexpr size_t DICTIONARY_SIZE{ 112 * 1024 };
+// Only the start of each asset is used as a sample. Further into a frame most matches are found in the asset's
+// own data rather than the dictionary, and whole multi megabyte meshes would make training very slow
+constexpr size_t DICTIONARY_SAMPLE_SIZE{ 128 * 1024 };
+
+// Trains the zstd dictionary of one kind of asset on what an earlier bake wrote, so assets of that kind share
+// the bytes they have in common instead of each one storing them. Dictionaries already in use must be
+// loaded first, since the assets they compressed are unpacked to be used as samples
+bool trainDictionary(const fs::path& exportDir, const std::string& extension, const fs::path& dictionaryPath)
+{
+	std::vector<char> samples;
+	std::vector<size_t> sampleSizes;
+
+	for (auto& p : fs::recursive_directory_iterator(exportDir)) {
+		if (p.path().extension() != extension) {
+			continue;
+		}
+
+		AssetFile file;
+		nlohmann::json metadata;
+		if (!loadBinaryFile(p.path().string().c_str(), file, metadata)) {
+			std::cout << "Warning: failed to load " << p.path().generic_string() << ", it isn't used to train the dictionary\n";
+			continue;
+		}
+
+		size_t sampleSize{ std::min(file.binaryBlob.size(), DICTIONARY_SAMPLE_SIZE) };
+		samples.insert(samples.end(), file.binaryBlob.begin(), file.binaryBlob.begin() + sampleSize);
+		sampleSizes.push_back(sampleSize);
+	}
+
+	std::cout << "training " << dictionaryPath.filename().generic_string() << " on " << sampleSizes.size() << " " << extension << " files\n";
+
+	std::vector<char> dictionary(DICTIONARY_SIZE);
+	size_t dictionarySize{ trainZstdDictionary(dictionary.data(), dictionary.size(), samples.data(), sampleSizes.data(), (uint32_t)sampleSizes.size()) };
+	if (dictionarySize == 0) {
+		std::cout << "Error: couldn't train " << dictionaryPath.generic_string() << ", bake more " << extension << " files first\n";
+		return false;
+	}
+
+	fs::create_directories(dictionaryPath.parent_path());
+	std::ofstream outFile{ dictionaryPath, std::ios::binary };
+	outFile.write(dictionary.data(), dictionarySize);
+	if (!outFile) {
+		std::cout << "Error when trying to write file: " << dictionaryPath.generic_string() << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+// Loads the dictionary into settings if it's compressed with zstd and the dictionary was trained. Without one
+// zstd still works, the assets are just larger
+bool loadDictionary(const fs::path& dictionaryPath, CompressionSettings& settings)
+{
+	if (settings.codec != CompressionCodec::Zstd || !fs::exists(dictionaryPath)) {
+		return true;
+	}
+
+	std::ifstream file{ dictionaryPath, std::ios::binary };
+	settings.dictionary.assign(std::istreambuf_iterator<char>{ file }, std::istreambuf_iterator<char>{});
+
+	if (zstdDictionaryId(settings.dictionary.data(), settings.dictionary.size()) == 0) {
+		std::cout << "Error: " << dictionaryPath.generic_string() << " isn't a zstd dictionary\n";
+		settings.dictionary.clear();
+		return false;
+	}
+
+	return true;
+}
+
+// size and mtime only, the hash is computed when it's needed
+FileStamp stampFile(const fs::path& path)
+{
+	FileStamp stamp{};
+	stamp.size = fs::file_size(path);
+	stamp.mtime = fs::last_write_time(path).time_since_epoch().count();
+	return stamp;
+}
+
+// Size and mtime are checked first, and the contents are only hashed when those disagree,
+// so a no-op rebuild doesn't read any sources. Fills in current's hash
+bool fileUnchanged(const FileStamp& previous, FileStamp& current, const fs::path& path)
+{
+	if (previous.size != current.size) {
+		return false;
+	}
+
+	if (previous.mtime == current.mtime) {
+		current.hash = previous.hash;
+		return true;
+	}
+
+	// the file was touched, it's only stale if the contents actually changed
+	current.hash = hashFile(path);
+	return current.hash == previous.hash;
+}
+
+ManifestEntry stampSource(const fs::path& input, const fs::path& output, const std::string& settings)
+{
+	ManifestEntry entry{};
+	entry.source = stampFile(input);
+	entry.bakerVersion = BAKER_VERSION;
+	entry.output = output.generic_string();
+	entry.settings = settings;
+	return entry;
+}
+
+// Compares the source, the files it references and its outputs against its manifest entry
+bool isUpToDate(const BakeManifest& manifest, const std::string& source, const fs::path& input, ManifestEntry& stamp)
+{
+	auto it{ manifest.find(source) };
+	if (it == manifest.end()) {
+		return false;
+	}
+
+	const ManifestEntry& entry{ it->second };
+	if (entry.bakerVersion != stamp.bakerVersion || entry.output != stamp.output || entry.settings != stamp.settings) {
+		return false;
+	}
+
+	for (const std::string& output : entry.outputs) {
+		if (!fs::exists(output)) {
+			return false;
+		}
+	}
+
+	if (!fileUnchanged(entry.source, stamp.source, input)) {
+		return false;
+	}
+
+	// the source is unchanged, so it still references the same files
+	for (const ManifestDependency& dependency : entry.dependencies) {
+		if (!fs::exists(dependency.path)) {
+			return false;
+		}
+
+		ManifestDependency current{ dependency.path, stampFile(dependency.path) };
+		if (!fileUnchanged(dependency.stamp, current.stamp, dependency.path)) {
+			return false;
+		}
+		stamp.dependencies.push_back(current);
+	}
+
+	stamp.outputs = entry.outputs;
+	return true;
+}
+
+enum class BakeJobType {
+	Texture,
+	GLTF
+};
+
+// A single source file to convert. Sources that would share an output are rejected when the jobs are gathered, so jobs can run on any thread
+struct BakeJob {
+	BakeJobType type;
+	fs::path input;
+	// output file for textures, output folder for glTF files
+	fs::path output;
+	// manifest key and the state of the source when the job was created
+	std::string source;
+	ManifestEntry stamp;
+	bool succeeded;
+};
+
+// Bakes the job and stamps the files it read and wrote into job.stamp
+bool runBakeJob(BakeJob& job, const ConverterState& convState)
+{
+	std::vector<fs::path> dependencies;
+	std::vector<fs::path> outputs;
+	bool success{ false };
+
+	switch (job.type) {
+	case BakeJobType::Texture:
+		success = convertImage(job.input, job.output, convState);
+		outputs.push_back(job.output);
+		break;
+	case BakeJobType::GLTF:
+		success = convertGLTF(job.input, job.output, convState, dependencies, outputs);
+		break;
+	default:
+		break;
+	}
+
+	job.stamp.dependencies.clear();
+	for (const fs::path& dependency : dependencies) {
+		// images aren't loaded by the mesh baker, so one can be missing without failing the bake
+		if (!fs::exists(dependency)) {
+			std::cout << "Warning: " << job.input.generic_string() << " references missing file " << dependency.generic_string() << "\n";
+			continue;
+		}
+
+		ManifestDependency stamped{ dependency.generic_string(), stampFile(dependency) };
+		stamped.stamp.hash = hashFile(dependency);
+		job.stamp.dependencies.push_back(stamped);
+	}
+
+	job.stamp.outputs.clear();
+	for (const fs::path& output : outputs) {
+		job.stamp.outputs.push_back(output.generic_string());
+	}
+
+	return success;
+}
+
+// Runs the jobs on numThreads worker threads, each pulling the next unclaimed job. Returns number of failed jobs
+uint32_t runBakeJobs(std::vector<BakeJob>& jobs, const ConverterState& convState, uint32_t numThreads)
+{
+	std::atomic<size_t> nextJob{ 0 };
+	std::atomic<uint32_t> failedJobs{ 0 };
+	std::atomic<size_t> finishedJobs{ 0 };
+	std::mutex printMutex;
+
+	auto worker = [&]() {
+		for (size_t i{ nextJob++ }; i < jobs.size(); i = nextJob++) {
+			BakeJob& job{ jobs[i] };
+
+			auto start{ std::chrono::high_resolution_clock::now() };
+			if (job.stamp.source.hash.empty()) {
+				job.stamp.source.hash = hashFile(job.input);
+			}
+			bool success{ runBakeJob(job, convState) };
+			auto end{ std::chrono::high_resolution_clock::now() };
+
+			job.succeeded = success;
+			if (!success) {
+				++failedJobs;
+			}
+
+			double ms{ std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count() / 1000000.0 };
+			std::lock_guard<std::mutex> lock{ printMutex };
+			std::cout << "[" << ++finishedJobs << "/" << jobs.size() << "] " << (success ? "baked " : "FAILED ")
+				<< job.input.lexically_proximate(convState.asset_path).generic_string() << " in " << ms << "ms" << std::endl;
+		}
+	};
+
+	numThreads = std::max(1u, std::min(numThreads, (uint32_t)jobs.size()));
+
+	if (numThreads == 1) {
+		worker();
+	} else {
+		std::vector<std::thread> threads;
+		threads.reserve(numThreads);
+		for (uint32_t i{ 0 }; i < numThreads; ++i) {
+			threads.emplace_back(worker);
+		}
+		for (std::thread& t : threads) {
+			t.join();
+		}
+	}
+
+	return failedJobs;
 }
 
 int main(int argc, char* argv[])
@@ -745,6 +1378,64 @@ int main(int argc, char* argv[])
 
 		fs::path path{ argv[1] };
 
+		// number of files baked concurrently, 0 means one per hardware thread
+		uint32_t numJobs{ 1 };
+		// rebake everything, even if the manifest says it's up to date
+		bool force{ false };
+		// -1 means the default level for the chosen codec
+		CompressionSettings textureCompression;
+		CompressionSettings meshCompression;
+		CompressionSettings skeletonCompression;
+		int textureLevel{ -1 };
+		int meshLevel{ -1 };
+		int skeletonLevel{ -1 };
+		bool blockCompressTextures{ true };
+		// retrain the zstd dictionaries on the last bake's output before baking
+		bool trainDictionaries{ false };
+
+		for (int i{ 2 }; i < argc; ++i) {
+			std::string arg{ argv[i] };
+
+			if (arg == "--jobs" && i + 1 < argc) {
+				numJobs = (uint32_t)std::max(0, atoi(argv[++i]));
+			} else if (arg == "--force") {
+				force = true;
+			} else if (arg == "--no-block-compression") {
+				blockCompressTextures = false;
+			} else if (arg == "--texture-codec" && i + 1 < argc && parseCompressionCodec(argv[i + 1], textureCompression.codec)) {
+				++i;
+			} else if (arg == "--mesh-codec" && i + 1 < argc && parseCompressionCodec(argv[i + 1], meshCompression.codec)) {
+				++i;
+			} else if (arg == "--skeleton-codec" && i + 1 < argc && parseCompressionCodec(argv[i + 1], skeletonCompression.codec)) {
+				++i;
+			} else if (arg == "--texture-level" && i + 1 < argc) {
+				textureLevel = atoi(argv[++i]);
+			} else if (arg == "--mesh-level" && i + 1 < argc) {
+				meshLevel = atoi(argv[++i]);
+			} else if (arg == "--skeleton-level" && i + 1 < argc) {
+				skeletonLevel = atoi(argv[++i]);
+			} else if (arg == "--compression-threshold" && i + 1 < argc) {
+				textureCompression.thresholdRatio = (float)atof(argv[++i]);
+				meshCompression.thresholdRatio = textureCompression.thresholdRatio;
+				skeletonCompression.thresholdRatio = textureCompression.thresholdRatio;
+			} else if (arg == "--train-dictionaries") {
+				trainDictionaries = true;
+			} else {
+				std::cout << "Unrecognized argument: " << arg << "\n";
+				std::cout << "Usage: baker <asset directory> [--jobs N] [--force]\n"
+					<< "  [--texture-codec none|lz4|lz4hc|zstd] [--texture-level N]\n"
+					<< "  [--mesh-codec none|lz4|lz4hc|zstd] [--mesh-level N]\n"
+					<< "  [--skeleton-codec none|lz4|lz4hc|zstd] [--skeleton-level N]\n"
+					<< "  [--compression-threshold RATIO] [--no-block-compression]\n"
+					<< "  [--train-dictionaries]  retrain the zstd mesh and skeleton dictionaries on the last bake, then rebake with them\n";
+				return -1;
+			}
+		}
+
+		if (numJobs == 0) {
+			numJobs = std::max(1u, std::thread::hardware_concurrency());
+		}
+
 		fs::path directory = path;
 
 		fs::path exported_dir = path.parent_path() / "assets_export";
@@ -754,6 +1445,68 @@ int main(int argc, char* argv[])
 		ConverterState convstate;
 		convstate.asset_path = path;
 		convstate.export_path = exported_dir;
+		convstate.textureCompression = textureCompression;
+		convstate.textureCompression.level = textureLevel >= 0 ? textureLevel : defaultCompressionLevel(textureCompression.codec);
+		convstate.meshCompression = meshCompression;
+		convstate.meshCompression.level = meshLevel >= 0 ? meshLevel : defaultCompressionLevel(meshCompression.codec);
+		convstate.skeletonCompression = skeletonCompression;
+		convstate.skeletonCompression.level = skeletonLevel >= 0 ? skeletonLevel : defaultCompressionLevel(skeletonCompression.codec);
+
+		// split the cores between the jobs running at once
+		uint32_t compressionThreads{ std::max(1u, std::thread::hardware_concurrency() / numJobs) };
+		convstate.textureCompression.numThreads = compressionThreads;
+		convstate.meshCompression.numThreads = compressionThreads;
+		convstate.skeletonCompression.numThreads = compressionThreads;
+
+		convstate.blockCompressTextures = blockCompressTextures;
+
+		fs::create_directory(exported_dir);
+
+		// meshes and skeletons are small and alike, so with zstd each kind shares a dictionary. The engine loads
+		// every dictionary in this folder before loading assets
+		fs::path dictionaryDir{ exported_dir / "dictionaries" };
+		fs::path meshDictionaryPath{ dictionaryDir / "mesh.zdict" };
+		fs::path skeletonDictionaryPath{ dictionaryDir / "skeleton.zdict" };
+		bool dictionariesTrained{ true };
+
+		if (trainDictionaries) {
+			// the samples may have been compressed with the current dictionaries
+			for (const fs::path& dictionaryPath : { meshDictionaryPath, skeletonDictionaryPath }) {
+				if (fs::exists(dictionaryPath)) {
+					loadCompressionDictionary(dictionaryPath.string().c_str());
+				}
+			}
+
+			if (meshCompression.codec == CompressionCodec::Zstd && !trainDictionary(exported_dir, ".mesh", meshDictionaryPath)) {
+				dictionariesTrained = false;
+			}
+			if (skeletonCompression.codec == CompressionCodec::Zstd && !trainDictionary(exported_dir, ".skel", skeletonDictionaryPath)) {
+				dictionariesTrained = false;
+			}
+		}
+
+		if (!loadDictionary(meshDictionaryPath, convstate.meshCompression) || !loadDictionary(skeletonDictionaryPath, convstate.skeletonCompression)) {
+			return -1;
+		}
+
+		// anything that changes the baked output goes in here so the manifest knows to rebake
+		std::string textureSettings{ compressionSettingsKey(convstate.textureCompression) + (blockCompressTextures ? " bc" : " rgba8") };
+		// glTF files bake to meshes and skeletons
+		std::string meshSettings{ compressionSettingsKey(convstate.meshCompression) + " | " + compressionSettingsKey(convstate.skeletonCompression) };
+
+		std::cout << "texture settings: " << textureSettings << "\n";
+		std::cout << "mesh settings: " << meshSettings << "\n";
+		fs::path manifestPath{ exported_dir / "bake_manifest.json" };
+		BakeManifest manifest{ loadManifest(manifestPath) };
+		BakeManifest newManifest;
+		uint32_t upToDate{ 0 };
+
+		// gather all the work up front on this thread, creating output directories as we go,
+		// so the jobs themselves never touch the directory structure
+		std::vector<BakeJob> jobs;
+		// source that claimed each output, foo.png and foo.jpg would both bake to foo.tx
+		std::unordered_map<std::string, fs::path> outputOwners;
+		uint32_t duplicateOutputs{ 0 };
 
 		for (auto& p : fs::recursive_directory_iterator(directory)) {
 			std::cout << "File: " << p << std::endl;
@@ -769,51 +1522,63 @@ int main(int argc, char* argv[])
 			if (p.path().extension() == ".png" || p.path().extension() == ".jpg" || p.path().extension() == ".TGA") {
 				std::cout << "found a texture" << std::endl;
 
-				auto newpath = p.path();
-
 				export_path.replace_extension(".tx");
 
-				convertImage(p.path(), export_path);
+				jobs.push_back({ BakeJobType::Texture, p.path(), export_path });
+			} else if (p.path().extension() == ".gltf") {
+				std::cout << "found a mesh (gltf)\n";
+
+				auto folder = export_path.parent_path() / (p.path().stem().string() + "_GLTF");
+				fs::create_directory(folder);
+
+				jobs.push_back({ BakeJobType::GLTF, p.path(), folder });
+			} else {
+				continue;
 			}
 
-			if (p.path().extension() == ".gltf") {
-				std::cout << "found a mesh (gltf)\n";
+			BakeJob& job{ jobs.back() };
 
-				tinygltf::Model model;
-				tinygltf::TinyGLTF loader;
-				std::string err;
-				std::string warn;
+			auto [owner, claimed] { outputOwners.emplace(job.output.generic_string(), job.input) };
+			if (!claimed) {
+				std::cout << "Error: " << job.input << " and " << owner->second << " both bake to " << job.output << ", skipping " << job.input << std::endl;
+				++duplicateOutputs;
+				jobs.pop_back();
+				continue;
+			}
 
-				bool ret = loader.LoadASCIIFromFile(&model, &err, &warn, p.path().string().c_str());
+			job.source = relative.generic_string();
+			job.stamp = stampSource(job.input, job.output, job.type == BakeJobType::Texture ? textureSettings : meshSettings);
 
-				if (!warn.empty()) {
-					printf("Warn: %s\n", warn.c_str());
-				}
+			if (!force && isUpToDate(manifest, job.source, job.input, job.stamp)) {
+				std::cout << "up to date, skipping" << std::endl;
+				newManifest[job.source] = job.stamp;
+				++upToDate;
+				jobs.pop_back();
+			}
+		}
 
-				if (!err.empty()) {
-					printf("Err: %s\n", err.c_str());
-				}
+		std::cout << upToDate << " files up to date" << std::endl;
 
-				if (!ret) {
-					printf("Failed to parse glTF\n");
-					return -1;
-				} else {
-					auto folder = export_path.parent_path() / (p.path().stem().string() + "_GLTF");
-					fs::create_directory(folder);
-
-					// If the mesh is skinned, we must use vertex format which includes skinning data
-					std::cout << "skins: " << model.skins.size() << '\n';
-					if (model.skins.size() == 0) {
-						extractMeshesGLTF<Vertex>(model, p.path(), folder, convstate, VertexFormat::DEFAULT);
-					} else {
-						extractMeshesGLTF<VertexSkinned>(model, p.path(), folder, convstate, VertexFormat::SKINNED);
-						extractSkeletalAnimation(model, p.path(), folder);
-					}
+		std::cout << "baking " << jobs.size() << " files using " << numJobs << " thread(s)" << std::endl;
 
-					//extractMaterialsGLTF(model, p.path(), folder, convstate);
-				}
+		auto bakeStart{ std::chrono::high_resolution_clock::now() };
+		uint32_t failedJobs{ runBakeJobs(jobs, convstate, numJobs) };
+		auto bakeEnd{ std::chrono::high_resolution_clock::now() };
+
+		// failed jobs are left out of the manifest so they get retried next time
+		for (const BakeJob& job : jobs) {
+			if (job.succeeded) {
+				newManifest[job.source] = job.stamp;
 			}
 		}
+		saveManifest(manifestPath, newManifest);
+
+		std::cout << "baked " << jobs.size() - failedJobs << "/" << jobs.size() << " files in "
+			<< std::chrono::duration_cast<std::chrono::milliseconds>(bakeEnd - bakeStart).count() / 1000.0 << "s" << std::endl;
+
+		if (failedJobs > 0 || duplicateOutputs > 0 || !dictionariesTrained) {
+			return -1;
+		}
 	}
 
 	return 0;
@@ -0,0 +1,356 @@
+#include "bc_compression.h"
+
+#include <cmath>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+
+#include "compression.h"
+
+// ------------------------------------------------------------------------------------------ //
+//                                         Helpers                                            //
+// ------------------------------------------------------------------------------------------ //
+
+// Appends values to a block least significant bit first, which is the bit order of every BC format
+struct BitWriter {
+	uint8_t* out;
+	uint32_t pos;
+
+	void write(uint32_t value, uint32_t bits)
+	{
+		for (uint32_t i{ 0 }; i < bits; ++i) {
+			uint32_t bit{ (value >> i) & 1 };
+			out[pos >> 3] |= (uint8_t)(bit << (pos & 7));
+			++pos;
+		}
+	}
+};
+
+// copies the 4x4 block at (bx, by) into block, clamping to the edge for blocks that hang off the image
+void fetchBlock(const uint8_t* rgba, uint32_t width, uint32_t height, uint32_t bx, uint32_t by, uint8_t block[16][4])
+{
+	for (uint32_t y{ 0 }; y < 4; ++y) {
+		uint32_t py{ std::min(by * 4 + y, height - 1) };
+
+		for (uint32_t x{ 0 }; x < 4; ++x) {
+			uint32_t px{ std::min(bx * 4 + x, width - 1) };
+			memcpy(block[y * 4 + x], rgba + ((size_t)py * width + px) * 4, 4);
+		}
+	}
+}
+
+// ------------------------------------------------------------------------------------------ //
+//                                          BC4                                               //
+// ------------------------------------------------------------------------------------------ //
+
+// 8 byte block: two endpoints then 16 3-bit indices. With e0 > e1 the palette is
+// e0, e1 and 6 evenly spaced values between them
+void encodeBC4Block(const uint8_t values[16], uint8_t out[8])
+{
+	uint8_t e0{ *std::max_element(values, values + 16) };
+	uint8_t e1{ *std::min_element(values, values + 16) };
+
+	memset(out, 0, 8);
+	out[0] = e0;
+	out[1] = e1;
+
+	// flat block, every index refers to e0
+	if (e0 == e1) {
+		return;
+	}
+
+	int palette[8];
+	palette[0] = e0;
+	palette[1] = e1;
+	for (int i{ 2 }; i < 8; ++i) {
+		palette[i] = ((8 - i) * e0 + (i - 1) * e1) / 7;
+	}
+
+	BitWriter writer{ out, 16 };
+	for (int i{ 0 }; i < 16; ++i) {
+		int bestIndex{ 0 };
+		int bestError{ 256 };
+
+		for (int j{ 0 }; j < 8; ++j) {
+			int error{ std::abs(palette[j] - values[i]) };
+			if (error < bestError) {
+				bestError = error;
+				bestIndex = j;
+			}
+		}
+
+		writer.write(bestIndex, 3);
+	}
+}
+
+// ------------------------------------------------------------------------------------------ //
+//                                          BC7                                               //
+// ------------------------------------------------------------------------------------------ //
+
+constexpr int BC7_WEIGHTS_4[16]{ 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+// Mode 6 endpoints are 7 bits per channel plus a shared p-bit that becomes the lowest bit,
+// so we try both p-bits and keep whichever quantized endpoint is closest
+void quantizeBC7Endpoint(const float endpoint[4], int quantized[4], int& pbit)
+{
+	float bestError{ 1e30f };
+
+	for (int p{ 0 }; p < 2; ++p) {
+		int q[4];
+		float error{ 0.0f };
+
+		for (int c{ 0 }; c < 4; ++c) {
+			q[c] = std::clamp((int)std::lround((endpoint[c] - p) / 2.0f), 0, 127);
+			float diff{ (float)((q[c] << 1) | p) - endpoint[c] };
+			error += diff * diff;
+		}
+
+		if (error < bestError) {
+			bestError = error;
+			pbit = p;
+			memcpy(quantized, q, sizeof(q));
+		}
+	}
+}
+
+// picks the nearest of the 16 palette entries for every texel, returns the total squared error
+float findBC7Indices(const uint8_t block[16][4], const int e0[4], const int e1[4], int indices[16])
+{
+	int palette[16][4];
+	for (int i{ 0 }; i < 16; ++i) {
+		for (int c{ 0 }; c < 4; ++c) {
+			palette[i][c] = ((64 - BC7_WEIGHTS_4[i]) * e0[c] + BC7_WEIGHTS_4[i] * e1[c] + 32) >> 6;
+		}
+	}
+
+	float totalError{ 0.0f };
+	for (int i{ 0 }; i < 16; ++i) {
+		int bestError{ INT32_MAX };
+
+		for (int j{ 0 }; j < 16; ++j) {
+			int error{ 0 };
+			for (int c{ 0 }; c < 4; ++c) {
+				int diff{ palette[j][c] - block[i][c] };
+				error += diff * diff;
+			}
+
+			if (error < bestError) {
+				bestError = error;
+				indices[i] = j;
+			}
+		}
+
+		totalError += (float)bestError;
+	}
+
+	return totalError;
+}
+
+// Mode 6: one subset, RGBA endpoints and 4-bit indices. Endpoints start at the extent of the texels along
+// their principal axis and are then refit with least squares to the indices that were chosen
+void encodeBC7Block(const uint8_t block[16][4], uint8_t out[16])
+{
+	float mean[4]{};
+	for (int i{ 0 }; i < 16; ++i) {
+		for (int c{ 0 }; c < 4; ++c) {
+			mean[c] += block[i][c] / 16.0f;
+		}
+	}
+
+	float covariance[4][4]{};
+	for (int i{ 0 }; i < 16; ++i) {
+		float d[4];
+		for (int c{ 0 }; c < 4; ++c) {
+			d[c] = block[i][c] - mean[c];
+		}
+		for (int r{ 0 }; r < 4; ++r) {
+			for (int c{ 0 }; c < 4; ++c) {
+				covariance[r][c] += d[r] * d[c];
+			}
+		}
+	}
+
+	// power iteration for the principal axis
+	float axis[4]{ 1.0f, 1.0f, 1.0f, 1.0f };
+	for (int iteration{ 0 }; iteration < 8; ++iteration) {
+		float next[4]{};
+		for (int r{ 0 }; r < 4; ++r) {
+			for (int c{ 0 }; c < 4; ++c) {
+				next[r] += covariance[r][c] * axis[c];
+			}
+		}
+
+		float length{ std::sqrt(next[0] * next[0] + next[1] * next[1] + next[2] * next[2] + next[3] * next[3]) };
+		if (length < 1e-6f) {
+			break;
+		}
+		for (int c{ 0 }; c < 4; ++c) {
+			axis[c] = next[c] / length;
+		}
+	}
+
+	float minT{ 1e30f };
+	float maxT{ -1e30f };
+	for (int i{ 0 }; i < 16; ++i) {
+		float t{ 0.0f };
+		for (int c{ 0 }; c < 4; ++c) {
+			t += (block[i][c] - mean[c]) * axis[c];
+		}
+		minT = std::min(minT, t);
+		maxT = std::max(maxT, t);
+	}
+
+	float endpoints[2][4];
+	for (int c{ 0 }; c < 4; ++c) {
+		endpoints[0][c] = std::clamp(mean[c] + axis[c] * minT, 0.0f, 255.0f);
+		endpoints[1][c] = std::clamp(mean[c] + axis[c] * maxT, 0.0f, 255.0f);
+	}
+
+	int e0[4], e1[4], p0, p1;
+	quantizeBC7Endpoint(endpoints[0], e0, p0);
+	quantizeBC7Endpoint(endpoints[1], e1, p1);
+
+	int fullE0[4], fullE1[4];
+	for (int c{ 0 }; c < 4; ++c) {
+		fullE0[c] = (e0[c] << 1) | p0;
+		fullE1[c] = (e1[c] << 1) | p1;
+	}
+
+	int indices[16];
+	float error{ findBC7Indices(block, fullE0, fullE1, indices) };
+
+	// least squares refit of the endpoints given the current indices
+	{
+		float aa{ 0.0f }, bb{ 0.0f }, ab{ 0.0f };
+		float ax[4]{}, bx[4]{};
+		for (int i{ 0 }; i < 16; ++i) {
+			float w{ BC7_WEIGHTS_4[indices[i]] / 64.0f };
+			float a{ 1.0f - w };
+			aa += a * a;
+			bb += w * w;
+			ab += a * w;
+			for (int c{ 0 }; c < 4; ++c) {
+				ax[c] += a * block[i][c];
+				bx[c] += w * block[i][c];
+			}
+		}
+
+		float det{ aa * bb - ab * ab };
+		if (std::abs(det) > 1e-6f) {
+			float refit[2][4];
+			for (int c{ 0 }; c < 4; ++c) {
+				refit[0][c] = std::clamp((ax[c] * bb - bx[c] * ab) / det, 0.0f, 255.0f);
+				refit[1][c] = std::clamp((bx[c] * aa - ax[c] * ab) / det, 0.0f, 255.0f);
+			}
+
+			int r0[4], r1[4], rp0, rp1;
+			quantizeBC7Endpoint(refit[0], r0, rp0);
+			quantizeBC7Endpoint(refit[1], r1, rp1);
+
+			int fullR0[4], fullR1[4];
+			for (int c{ 0 }; c < 4; ++c) {
+				fullR0[c] = (r0[c] << 1) | rp0;
+				fullR1[c] = (r1[c] << 1) | rp1;
+			}
+
+			int refitIndices[16];
+			float refitError{ findBC7Indices(block, fullR0, fullR1, refitIndices) };
+
+			if (refitError < error) {
+				memcpy(e0, r0, sizeof(e0));
+				memcpy(e1, r1, sizeof(e1));
+				memcpy(indices, refitIndices, sizeof(indices));
+				p0 = rp0;
+				p1 = rp1;
+			}
+		}
+	}
+
+	// the first index is stored with its top bit implied to be zero, so swap the endpoints if it's set
+	if (indices[0] & 8) {
+		std::swap(e0, e1);
+		std::swap(p0, p1);
+		for (int i{ 0 }; i < 16; ++i) {
+			indices[i] = 15 - indices[i];
+		}
+	}
+
+	memset(out, 0, 16);
+	BitWriter writer{ out, 0 };
+	// mode 6 is encoded as 6 zero bits followed by a one
+	writer.write(1 << 6, 7);
+	for (int c{ 0 }; c < 4; ++c) {
+		writer.write(e0[c], 7);
+		writer.write(e1[c], 7);
+	}
+	writer.write(p0, 1);
+	writer.write(p1, 1);
+	writer.write(indices[0], 3);
+	for (int i{ 1 }; i < 16; ++i) {
+		writer.write(indices[i], 4);
+	}
+}
+
+// ------------------------------------------------------------------------------------------ //
+//                                        Interface                                           //
+// ------------------------------------------------------------------------------------------ //
+
+uint32_t blockBytes(BlockFormat format)
+{
+	return format == BlockFormat::BC4 ? 8 : 16;
+}
+
+size_t blockCompressedSize(BlockFormat format, uint32_t width, uint32_t height)
+{
+	size_t blocksX{ (width + 3) / 4 };
+	size_t blocksY{ (height + 3) / 4 };
+	return blocksX * blocksY * blockBytes(format);
+}
+
+void compressBlocks(BlockFormat format, const uint8_t* rgba, uint32_t width, uint32_t height, uint32_t channel, uint8_t* out, uint32_t numThreads)
+{
+	const uint32_t blocksX{ (width + 3) / 4 };
+	const uint32_t blocksY{ (height + 3) / 4 };
+	const uint32_t bytes{ blockBytes(format) };
+
+	auto compressRow = [&](uint32_t by) {
+		uint8_t* dst{ out + (size_t)by * blocksX * bytes };
+
+		for (uint32_t bx{ 0 }; bx < blocksX; ++bx) {
+			uint8_t block[16][4];
+			fetchBlock(rgba, width, height, bx, by, block);
+
+			switch (format) {
+			case BlockFormat::BC4:
+			{
+				uint8_t values[16];
+				for (int i{ 0 }; i < 16; ++i) {
+					values[i] = block[i][channel];
+				}
+				encodeBC4Block(values, dst);
+				break;
+			}
+			case BlockFormat::BC5:
+			{
+				// red block followed by green block
+				uint8_t values[16];
+				for (int c{ 0 }; c < 2; ++c) {
+					for (int i{ 0 }; i < 16; ++i) {
+						values[i] = block[i][c];
+					}
+					encodeBC4Block(values, dst + c * 8);
+				}
+				break;
+			}
+			case BlockFormat::BC7:
+				encodeBC7Block(block, dst);
+				break;
+			}
+
+			dst += bytes;
+		}
+	};
+
+	// rows go through the same thread pool as the LZ4 blocks instead of new threads for every mip
+	parallelForBlocks(blocksY, numThreads, compressRow);
+}
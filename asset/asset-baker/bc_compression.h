@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+// GPU block compression formats the baker can encode to
+enum class BlockFormat {
+	// one channel, 8 bytes per 4x4 block
+	BC4,
+	// two channels (red and green), 16 bytes per 4x4 block
+	BC5,
+	// RGBA, 16 bytes per 4x4 block. Only mode 6 is used, which is a good fit for smooth color textures
+	BC7
+};
+
+uint32_t blockBytes(BlockFormat format);
+
+// size in bytes of a width x height image once compressed, partial blocks are padded to a full block
+size_t blockCompressedSize(BlockFormat format, uint32_t width, uint32_t height);
+
+// Encodes a tightly packed RGBA8 image into out, which must hold blockCompressedSize() bytes.
+// channel selects which of the RGBA channels is encoded for BC4 and is ignored otherwise.
+// Rows of blocks are spread over numThreads threads (0 == one per core)
+void compressBlocks(BlockFormat format, const uint8_t* rgba, uint32_t width, uint32_t height, uint32_t channel, uint8_t* out, uint32_t numThreads);
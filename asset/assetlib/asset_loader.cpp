@@ -2,28 +2,60 @@
 
 #include <fstream>
 #include <iostream>
+#include <cstring>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 #include "../tracy/Tracy.hpp"		// CPU profiling
 #include "compression.h"
 
 using namespace assets;
 
-bool assets::saveBinaryFile(const char* path, nlohmann::json& metadata, AssetFile& file)
+bool assets::saveBinaryFile(const char* path, nlohmann::json& metadata, AssetFile& file, const CompressionSettings& settings)
 {
 	//pixel data
-	char* compressedBlob{ new char[file.json.size() + file.binaryBlob.size()] };
+	std::vector<char> compressedBlob;
+	bool useCompression{ false };
+	CompressResult_t res{};
+
+	if (settings.codec == CompressionCodec::Zstd) {
+		compressedBlob.resize(compressZstdBound(file.binaryBlob.size()));
+		res = compressBufferZstd(file.binaryBlob.data(), compressedBlob.data(), file.binaryBlob.size(), compressedBlob.size(),
+			settings.level, settings.dictionary.data(), settings.dictionary.size());
+	} else if (settings.codec != CompressionCodec::None) {
+		compressedBlob.resize(compressBlocksBound(file.binaryBlob.size()));
+		res = compressBufferBlocks(file.binaryBlob.data(), compressedBlob.data(), file.binaryBlob.size(),
+			settings.codec == CompressionCodec::LZ4HC, settings.level, settings.numThreads);
+	}
 
-	CompressResult_t res{ compressBuffer(file.binaryBlob.data(), compressedBlob, file.binaryBlob.size()) };
+	if (settings.codec != CompressionCodec::None) {
+		float compressionRatio{ (float)res.sizeOut / (float)res.sizeIn };
+		useCompression = res.error == 0 && compressionRatio < settings.thresholdRatio;
 
-	float compressionRatio{ (float)res.sizeOut / (float)res.sizeIn };
-	float thresholdRatio{ 0.8f };
-	bool useCompression{ compressionRatio < thresholdRatio };
+		if (useCompression) {
+			std::cout << "Compression ratio (" << compressionRatio << ") < threshold (" << settings.thresholdRatio << "), compressing binary blob\n\n";
+		} else {
+			std::cout << "Compression ratio (" << compressionRatio << ") >= threshold (" << settings.thresholdRatio << "), NOT compressing binary blob\n\n";
+		}
+	}
 
 	if (useCompression) {
-		std::cout << "Compression ratio (" << compressionRatio << ") < threshold (" << thresholdRatio << "), compressing binary blob\n\n";
-		metadata["compression_mode"] = "LZ4";
+		metadata["compression_mode"] = settings.codec == CompressionCodec::Zstd ? "ZSTD" : "LZ4_BLOCKS";
+		metadata["compression_codec"] = compressionCodecName(settings.codec);
+		metadata["compression_level"] = settings.level;
+		if (settings.codec == CompressionCodec::Zstd && !settings.dictionary.empty()) {
+			metadata["compression_dictionary"] = zstdDictionaryId(settings.dictionary.data(), settings.dictionary.size());
+		}
 	} else {
-		std::cout << "Compression ratio (" << compressionRatio << ") >= threshold (" << thresholdRatio << "), NOT compressing binary blob\n\n";
 		metadata["compression_mode"] = "None";
 	}
 	file.json = metadata.dump();
@@ -52,13 +84,11 @@ bool assets::saveBinaryFile(const char* path, nlohmann::json& metadata, AssetFil
 
 
 	if (useCompression) {
-		outFile.write(compressedBlob, res.sizeOut);
+		outFile.write(compressedBlob.data(), res.sizeOut);
 	} else {
 		outFile.write(file.binaryBlob.data(), file.binaryBlob.size());
 	}
 
-	delete[] compressedBlob;
-
 	outFile.close();
 
 	return true;
@@ -66,45 +96,164 @@ bool assets::saveBinaryFile(const char* path, nlohmann::json& metadata, AssetFil
 
 bool assets::loadBinaryFile(const char* path, AssetFile& asset, nlohmann::json& metadataOut)
 {
-	std::ifstream inFile;
+	AssetView view;
+	if (!mapBinaryFile(path, view, metadataOut)) return false;
+
+	memcpy(asset.type, view.type, 4);
+	asset.version = view.version;
+	asset.json.assign(view.json, view.jsonSize);
+	asset.binaryBlob.resize(view.unpackedSize);
+
+	std::string compressionModeString = metadataOut["compression_mode"];
+	bool unpacked{ unpackBlob(view, parseCompression(compressionModeString.c_str()), asset.binaryBlob.data()) };
+
+	unmapBinaryFile(view);
+	return unpacked;
+}
+
+bool assets::mapBinaryFile(const char* path, AssetView& view, nlohmann::json& metadataOut)
+{
+	ZoneScoped;
+	view = {};
+
 	{
-		ZoneScopedN("open file");
-		inFile.open(path, std::ios::binary);
-	}
+		ZoneScopedN("map file");
+#ifdef _WIN32
+		HANDLE file{ CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr) };
+		if (file == INVALID_HANDLE_VALUE) return false;
+
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+			CloseHandle(file);
+			return false;
+		}
 
-	if (!inFile.is_open()) return false;
+		HANDLE mapping{ CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr) };
+		if (!mapping) {
+			CloseHandle(file);
+			return false;
+		}
+
+		void* data{ MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) };
+		if (!data) {
+			CloseHandle(mapping);
+			CloseHandle(file);
+			return false;
+		}
+
+		view.fileHandle = file;
+		view.mappingHandle = mapping;
+		view.mappedData = data;
+		view.mappedSize = (size_t)fileSize.QuadPart;
+#else
+		int fd{ open(path, O_RDONLY) };
+		if (fd < 0) return false;
+
+		struct stat st;
+		if (fstat(fd, &st) != 0 || st.st_size == 0) {
+			close(fd);
+			return false;
+		}
+
+		void* data{ mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0) };
+		// the mapping stays valid after the descriptor is closed
+		close(fd);
+		if (data == MAP_FAILED) return false;
+
+		// we read the whole blob front to back exactly once
+		madvise(data, (size_t)st.st_size, MADV_SEQUENTIAL);
+
+		view.mappedData = data;
+		view.mappedSize = (size_t)st.st_size;
+#endif
+	}
 
-	inFile.seekg(0);
-	uint32_t bloblen = 0;
 	{
 		ZoneScopedN("read header");
-		inFile.read(asset.type, 4);
+		const char* ptr{ (const char*)view.mappedData };
+		const char* end{ ptr + view.mappedSize };
+		const size_t headerSize{ 4 + 3 * sizeof(uint32_t) };
+
+		if (view.mappedSize < headerSize) {
+			std::cout << "Error: asset file is too small to hold a header: " << path << std::endl;
+			unmapBinaryFile(view);
+			return false;
+		}
+
+		uint32_t version, jsonlen, bloblen;
+		memcpy(view.type, ptr, 4);
+		memcpy(&version, ptr + 4, sizeof(uint32_t));
+		memcpy(&jsonlen, ptr + 8, sizeof(uint32_t));
+		memcpy(&bloblen, ptr + 12, sizeof(uint32_t));
+		ptr += headerSize;
+
+		if ((size_t)(end - ptr) < jsonlen) {
+			std::cout << "Error: asset file is truncated: " << path << std::endl;
+			unmapBinaryFile(view);
+			return false;
+		}
+
+		view.version = version;
+		view.json = ptr;
+		view.jsonSize = jsonlen;
+		view.blob = ptr + jsonlen;
+		view.blobSize = end - view.blob;
+		view.unpackedSize = bloblen;
+	}
+
+	try {
+		metadataOut = nlohmann::json::parse(view.json, view.json + view.jsonSize);
+	} catch (const nlohmann::json::exception& e) {
+		std::cout << "Error: asset file has invalid metadata: " << path << " (" << e.what() << ")" << std::endl;
+		unmapBinaryFile(view);
+		return false;
+	}
 
-		inFile.read((char*)&asset.version, sizeof(uint32_t));
+	return true;
+}
 
-		uint32_t jsonlen = 0;
-		inFile.read((char*)&jsonlen, sizeof(uint32_t));
+void assets::unmapBinaryFile(AssetView& view)
+{
+	if (!view.mappedData) return;
 
-		inFile.read((char*)&bloblen, sizeof(uint32_t));
+#ifdef _WIN32
+	UnmapViewOfFile(view.mappedData);
+	CloseHandle((HANDLE)view.mappingHandle);
+	CloseHandle((HANDLE)view.fileHandle);
+#else
+	munmap(view.mappedData, view.mappedSize);
+#endif
 
-		asset.json.resize(jsonlen);
+	view = {};
+}
 
-		inFile.read(asset.json.data(), jsonlen);
+bool assets::unpackBlob(const AssetView& view, CompressionMode compressionMode, void* destination, uint32_t numThreads)
+{
+	ZoneScoped;
 
-		asset.binaryBlob.resize(bloblen);
+	if (compressionMode == CompressionMode::LZ4Blocks) {
+		ZoneScopedN("decompress blocks");
+		return decompressBufferBlocks(view.blob, view.blobSize, destination, view.unpackedSize, numThreads) == 0;
 	}
 
-	metadataOut = nlohmann::json::parse(asset.json);
-	std::string compressionModeString = metadataOut["compression_mode"];
-	CompressionMode compressionMode{ parseCompression(compressionModeString.c_str()) };
+	if (compressionMode == CompressionMode::Zstd) {
+		ZoneScopedN("decompress zstd");
+		return decompressBufferZstd(view.blob, view.blobSize, destination, view.unpackedSize) == 0;
+	}
 
+	// legacy single LZ4 frame, written by older bakers
 	if (compressionMode == CompressionMode::LZ4) {
-		ZoneScopedN("decompress file");
-		decompressFile(inFile, asset.binaryBlob.data());
-	} else {
-		inFile.read(asset.binaryBlob.data(), bloblen);
+		ZoneScopedN("decompress blob");
+		return decompressBuffer(view.blob, view.blobSize, destination, view.unpackedSize) == 0;
 	}
 
+	if (view.blobSize < view.unpackedSize) {
+		std::cout << "Error: asset blob is truncated\n";
+		return false;
+	}
+
+	ZoneScopedN("copy blob");
+	memcpy(destination, view.blob, view.unpackedSize);
 	return true;
 }
 
@@ -112,7 +261,61 @@ assets::CompressionMode assets::parseCompression(const char* f)
 {
 	if (strcmp(f, "LZ4") == 0) {
 		return assets::CompressionMode::LZ4;
+	} else if (strcmp(f, "LZ4_BLOCKS") == 0) {
+		return assets::CompressionMode::LZ4Blocks;
+	} else if (strcmp(f, "ZSTD") == 0) {
+		return assets::CompressionMode::Zstd;
 	} else {
 		return assets::CompressionMode::None;
 	}
 }
+
+bool assets::parseCompressionCodec(const char* f, CompressionCodec& codecOut)
+{
+	if (strcmp(f, "none") == 0) {
+		codecOut = CompressionCodec::None;
+	} else if (strcmp(f, "lz4") == 0) {
+		codecOut = CompressionCodec::LZ4;
+	} else if (strcmp(f, "lz4hc") == 0) {
+		codecOut = CompressionCodec::LZ4HC;
+	} else if (strcmp(f, "zstd") == 0) {
+		codecOut = CompressionCodec::Zstd;
+	} else {
+		return false;
+	}
+	return true;
+}
+
+const char* assets::compressionCodecName(CompressionCodec codec)
+{
+	switch (codec) {
+	case CompressionCodec::LZ4:
+		return "lz4";
+	case CompressionCodec::LZ4HC:
+		return "lz4hc";
+	case CompressionCodec::Zstd:
+		return "zstd";
+	default:
+		return "none";
+	}
+}
+
+bool assets::loadCompressionDictionary(const char* path)
+{
+	std::ifstream file{ path, std::ios::binary | std::ios::ate };
+	if (!file.is_open()) {
+		std::cout << "Error: failed to open compression dictionary " << path << std::endl;
+		return false;
+	}
+
+	std::vector<char> dictionary((size_t)file.tellg());
+	file.seekg(0);
+	file.read(dictionary.data(), dictionary.size());
+
+	if (!file || !registerZstdDictionary(dictionary.data(), dictionary.size())) {
+		std::cout << "Error: " << path << " isn't a zstd dictionary" << std::endl;
+		return false;
+	}
+
+	return true;
+}
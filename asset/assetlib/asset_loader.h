@@ -12,15 +12,81 @@ namespace assets {
 		std::vector<char> binaryBlob;
 	};
 
+	// Read-only view of an asset file that has been memory mapped. The json and blob
+	// pointers point directly into the mapping so the payload can be unpacked straight
+	// into its final destination (e.g. a staging buffer) without an intermediate copy.
+	struct AssetView {
+		char type[4];
+		int version;
+		const char* json;
+		size_t jsonSize;
+		// blob exactly as stored on disk, may be compressed
+		const char* blob;
+		size_t blobSize;
+		// size of the blob once unpacked
+		size_t unpackedSize;
+
+		// mapping state, only touched by mapBinaryFile/unmapBinaryFile
+		void* mappedData;
+		size_t mappedSize;
+		void* fileHandle;
+		void* mappingHandle;
+	};
+
 	enum class CompressionMode : uint32_t {
 		None,
-		LZ4
+		// single LZ4 frame
+		LZ4,
+		// independently compressed LZ4 blocks that can be unpacked in parallel
+		LZ4Blocks,
+		// single zstd frame, possibly compressed with a dictionary
+		Zstd
+	};
+
+	// Encoder used when saving. LZ4 and LZ4HC produce the same block format, so this only
+	// affects bake time and file size, the loader decodes both as CompressionMode::LZ4Blocks.
+	// Zstd is smaller still, mostly for small assets of one kind that share a trained dictionary
+	enum class CompressionCodec : uint32_t {
+		None,
+		LZ4,
+		LZ4HC,
+		Zstd
+	};
+
+	struct CompressionSettings {
+		CompressionCodec codec{ CompressionCodec::LZ4 };
+		// LZ4: acceleration, 1 is default and higher is faster but larger. LZ4HC: 1-12, 9 is default. Zstd: 1-22
+		int level{ 1 };
+		// blob is only stored compressed if compressed size / original size is below this
+		float thresholdRatio{ 0.8f };
+		// 0 == one per core. Zstd always compresses on the calling thread
+		uint32_t numThreads{ 1 };
+		// zstd dictionary written by the baker, empty compresses without one
+		std::vector<char> dictionary;
 	};
 
 	// Writes metadata to file.json
-	bool saveBinaryFile(const char* path, nlohmann::json& metadata, AssetFile& file);
+	bool saveBinaryFile(const char* path, nlohmann::json& metadata, AssetFile& file, const CompressionSettings& settings = {});
 
 	bool loadBinaryFile(const char* path, AssetFile& asset, nlohmann::json& metadataOut);
 
+	// Maps the file into memory and parses its header and metadata. The view must be released with unmapBinaryFile
+	bool mapBinaryFile(const char* path, AssetView& view, nlohmann::json& metadataOut);
+
+	void unmapBinaryFile(AssetView& view);
+
+	// Copies or decompresses the blob of a mapped file into destination, which must hold view.unpackedSize bytes.
+	// numThreads is used for LZ4Blocks, 0 == one per core. Single threaded unless the caller opts in
+	bool unpackBlob(const AssetView& view, CompressionMode compressionMode, void* destination, uint32_t numThreads = 1);
+
 	assets::CompressionMode parseCompression(const char* f);
+
+	// returns false if f isn't a known codec
+	bool parseCompressionCodec(const char* f, CompressionCodec& codecOut);
+
+	const char* compressionCodecName(CompressionCodec codec);
+
+	// Register a zstd dictionary written by the baker, so assets compressed with it can be unpacked.
+	// Not thread safe, load every dictionary before loading any assets
+	bool loadCompressionDictionary(const char* path);
 }
@@ -8,9 +8,23 @@
 #include <cinttypes>
 #include <fstream>
 #include <iostream>
-
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <unordered_map>
+
+#include "lz4.h"
+#include "lz4hc.h"
 #include "lz4frame.h"
 
+#include "zstd.h"
+#include "zdict.h"
+
 
 constexpr size_t IN_CHUNK_SIZE{ 16 * 1024 };
 
@@ -342,6 +356,311 @@ int decompressFile(std::ifstream& inFile, void* outBuf)
 }
 
 
+/* ================================================= */
+/*              In-memory Decompression              */
+/* ================================================= */
+
+/* Since the whole frame is already in memory and outBuf is large enough for the
+ * decompressed result we can let LZ4F write straight into outBuf, without the
+ * intermediate src/dst chunks used by decompressFile.
+ * @result : 1==error, 0==success */
+int decompressBuffer(const void* inBuf, size_t inBufSize, void* outBuf, size_t dstCapacity)
+{
+	assert(inBuf != NULL);
+	assert(outBuf != NULL);
+
+	LZ4F_dctx* dctx;
+	{
+		const size_t dctxStatus = LZ4F_createDecompressionContext(&dctx, LZ4F_VERSION);
+		if (LZ4F_isError(dctxStatus)) {
+			printf("LZ4F_dctx creation error: %s\n", LZ4F_getErrorName(dctxStatus));
+			return 1;
+		}
+	}
+
+	const char* srcPtr = (const char*)inBuf;
+	const char* const srcEnd = srcPtr + inBufSize;
+	char* dstPtr = (char*)outBuf;
+	char* const dstEnd = dstPtr + dstCapacity;
+	size_t ret = 1;
+
+	while (srcPtr < srcEnd && ret != 0) {
+		size_t dstSize = dstEnd - dstPtr;
+		size_t srcSize = srcEnd - srcPtr;
+		ret = LZ4F_decompress(dctx, dstPtr, &dstSize, srcPtr, &srcSize, /* LZ4F_decompressOptions_t */ NULL);
+		if (LZ4F_isError(ret)) {
+			printf("Decompression error: %s\n", LZ4F_getErrorName(ret));
+			LZ4F_freeDecompressionContext(dctx);
+			return 1;
+		}
+		srcPtr += srcSize;
+		dstPtr += dstSize;
+
+		/* no progress means the output buffer is full before the frame ended */
+		if (srcSize == 0 && dstSize == 0) {
+			printf("Decompress: output buffer too small\n");
+			LZ4F_freeDecompressionContext(dctx);
+			return 1;
+		}
+	}
+
+	LZ4F_freeDecompressionContext(dctx);
+
+	if (ret != 0) {
+		printf("Decompress: not enough input (decompressBuffer)\n");
+		return 1;
+	}
+	if (srcPtr < srcEnd) {
+		printf("Decompress: Trailing data left in buffer after frame\n");
+		return 1;
+	}
+
+	return 0;
+}
+
+
+/* ================================================= */
+/*           Block-parallel (LZ4_BLOCKS)             */
+/* ================================================= */
+
+/* Worker threads shared by every compress/decompress call, created the first
+ * time a call asks for more than one thread. Calls can come from several
+ * threads at once (the baker runs jobs in parallel), each one queues a ticket
+ * per helper it wants and the idle workers pick them up. */
+class BlockThreadPool {
+public:
+	/* the calling thread always works too, so numThreads - 1 helpers are queued */
+	void parallelFor(uint32_t count, uint32_t numThreads, const std::function<void(uint32_t)>& fn)
+	{
+		Batch batch{ fn, count };
+
+		{
+			std::lock_guard<std::mutex> lock{ _mutex };
+			if (_threads.empty()) {
+				uint32_t workerCount = std::max(1u, std::thread::hardware_concurrency()) - 1;
+				for (uint32_t i = 0; i < workerCount; ++i) {
+					_threads.emplace_back([this]() { workerLoop(); });
+				}
+			}
+
+			uint32_t helpers = std::min(numThreads - 1, (uint32_t)_threads.size());
+			for (uint32_t i = 0; i < helpers; ++i) {
+				_tickets.push_back(&batch);
+			}
+		}
+		_wake.notify_all();
+
+		run(batch);
+
+		/* tickets nobody picked up yet must not outlive the batch */
+		std::unique_lock<std::mutex> lock{ _mutex };
+		_tickets.erase(std::remove(_tickets.begin(), _tickets.end(), &batch), _tickets.end());
+		_done.wait(lock, [&]() { return batch.activeHelpers == 0; });
+	}
+
+	~BlockThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock{ _mutex };
+			_stop = true;
+		}
+		_wake.notify_all();
+
+		for (std::thread& t : _threads) {
+			t.join();
+		}
+	}
+
+private:
+	struct Batch {
+		const std::function<void(uint32_t)>& fn;
+		uint32_t count;
+		std::atomic<uint32_t> nextBlock{ 0 };
+		/* guarded by _mutex */
+		uint32_t activeHelpers{ 0 };
+	};
+
+	static void run(Batch& batch)
+	{
+		for (uint32_t i = batch.nextBlock++; i < batch.count; i = batch.nextBlock++) {
+			batch.fn(i);
+		}
+	}
+
+	void workerLoop()
+	{
+		std::unique_lock<std::mutex> lock{ _mutex };
+		while (true) {
+			_wake.wait(lock, [&]() { return _stop || !_tickets.empty(); });
+			if (_stop) {
+				return;
+			}
+
+			Batch* batch = _tickets.front();
+			_tickets.pop_front();
+			++batch->activeHelpers;
+
+			lock.unlock();
+			run(*batch);
+			lock.lock();
+
+			if (--batch->activeHelpers == 0) {
+				_done.notify_all();
+			}
+		}
+	}
+
+	std::mutex _mutex;
+	std::condition_variable _wake;
+	std::condition_variable _done;
+	std::deque<Batch*> _tickets;
+	std::vector<std::thread> _threads;
+	bool _stop{ false };
+};
+
+void parallelForBlocks(uint32_t count, uint32_t numThreads, const std::function<void(uint32_t)>& fn)
+{
+	if (numThreads == 0) {
+		numThreads = std::max(1u, std::thread::hardware_concurrency());
+	}
+	numThreads = std::min(numThreads, count);
+
+	if (numThreads <= 1) {
+		for (uint32_t i = 0; i < count; ++i) {
+			fn(i);
+		}
+		return;
+	}
+
+	static BlockThreadPool pool;
+	pool.parallelFor(count, numThreads, fn);
+}
+
+uint32_t getBlockCount(size_t size)
+{
+	return (uint32_t)((size + COMPRESSION_BLOCK_SIZE - 1) / COMPRESSION_BLOCK_SIZE);
+}
+
+size_t blockHeaderSize(uint32_t blockCount)
+{
+	return 2 * sizeof(uint32_t) + blockCount * sizeof(uint32_t);
+}
+
+size_t compressBlocksBound(size_t inBufSize)
+{
+	/* incompressible blocks are stored raw, so the blocks never exceed the input */
+	return blockHeaderSize(getBlockCount(inBufSize)) + inBufSize;
+}
+
+CompressResult_t compressBufferBlocks(const void* inBuf, void* outBuf, size_t inBufSize, bool highCompression, int level, uint32_t numThreads)
+{
+	assert(inBuf != NULL || inBufSize == 0);
+	assert(outBuf != NULL);
+
+	const uint32_t blockCount = getBlockCount(inBufSize);
+	const size_t headerSize = blockHeaderSize(blockCount);
+	std::vector<uint32_t> blockSizes(blockCount);
+
+	/* every block is compressed into the slot it would occupy uncompressed, the
+	 * slots are packed together afterwards once all the sizes are known */
+	char* const slots = (char*)outBuf + headerSize;
+
+	parallelForBlocks(blockCount, numThreads, [&](uint32_t i) {
+		const size_t offset = (size_t)i * COMPRESSION_BLOCK_SIZE;
+		const int blockLen = (int)std::min((size_t)COMPRESSION_BLOCK_SIZE, inBufSize - offset);
+		const char* src = (const char*)inBuf + offset;
+		char* dst = slots + offset;
+
+		/* returns 0 when the output wouldn't fit in blockLen bytes */
+		int compressedSize = highCompression
+			? LZ4_compress_HC(src, dst, blockLen, blockLen - 1, level)
+			: LZ4_compress_fast(src, dst, blockLen, blockLen - 1, level);
+		if (compressedSize <= 0) {
+			memcpy(dst, src, blockLen);
+			compressedSize = blockLen;
+		}
+		blockSizes[i] = (uint32_t)compressedSize;
+	});
+
+	char* packed = slots;
+	for (uint32_t i = 0; i < blockCount; ++i) {
+		memmove(packed, slots + (size_t)i * COMPRESSION_BLOCK_SIZE, blockSizes[i]);
+		packed += blockSizes[i];
+	}
+
+	const uint32_t header[2] = { COMPRESSION_BLOCK_SIZE, blockCount };
+	memcpy(outBuf, header, sizeof(header));
+	memcpy((char*)outBuf + sizeof(header), blockSizes.data(), blockCount * sizeof(uint32_t));
+
+	CompressResult_t result;
+	result.error = 0;
+	result.sizeIn = inBufSize;
+	result.sizeOut = packed - (char*)outBuf;
+	return result;
+}
+
+/* @result : 1==error, 0==success */
+int decompressBufferBlocks(const void* inBuf, size_t inBufSize, void* outBuf, size_t dstCapacity, uint32_t numThreads)
+{
+	assert(inBuf != NULL);
+	assert(outBuf != NULL || dstCapacity == 0);
+
+	uint32_t header[2];
+	if (inBufSize < sizeof(header)) {
+		printf("Decompress: not enough input (decompressBufferBlocks)\n");
+		return 1;
+	}
+	memcpy(header, inBuf, sizeof(header));
+
+	const uint32_t blockSize = header[0];
+	const uint32_t blockCount = header[1];
+	const size_t headerSize = blockHeaderSize(blockCount);
+
+	if (blockSize == 0 || (size_t)blockCount != (dstCapacity + blockSize - 1) / blockSize || inBufSize < headerSize) {
+		printf("Decompress: block header doesn't match output size\n");
+		return 1;
+	}
+
+	/* prefix sum of the compressed sizes gives each block's offset */
+	std::vector<uint32_t> blockSizes(blockCount);
+	memcpy(blockSizes.data(), (const char*)inBuf + sizeof(header), blockCount * sizeof(uint32_t));
+
+	std::vector<size_t> blockOffsets(blockCount);
+	size_t offset = headerSize;
+	for (uint32_t i = 0; i < blockCount; ++i) {
+		blockOffsets[i] = offset;
+		offset += blockSizes[i];
+	}
+
+	if (offset != inBufSize) {
+		printf("Decompress: block sizes don't match input size\n");
+		return 1;
+	}
+
+	std::atomic<bool> failed{ false };
+
+	parallelForBlocks(blockCount, numThreads, [&](uint32_t i) {
+		const size_t dstOffset = (size_t)i * blockSize;
+		const int blockLen = (int)std::min((size_t)blockSize, dstCapacity - dstOffset);
+		const char* src = (const char*)inBuf + blockOffsets[i];
+		char* dst = (char*)outBuf + dstOffset;
+
+		if (blockSizes[i] == (uint32_t)blockLen) {
+			memcpy(dst, src, blockLen);
+		} else if (LZ4_decompress_safe(src, dst, (int)blockSizes[i], blockLen) != blockLen) {
+			failed = true;
+		}
+	});
+
+	if (failed) {
+		printf("Decompression error: corrupt LZ4 block\n");
+		return 1;
+	}
+
+	return 0;
+}
+
+
 int compareFiles(FILE* fp0, FILE* fp1)
 {
 	int result = 0;
@@ -436,3 +755,157 @@ int compareFiles(FILE* fp0, FILE* fp1)
 //
 //	return 0;
 //}
+
+
+/* ================================================= */
+/*                       Zstd                        */
+/* ================================================= */
+
+/* dictionaries registered for decompression, by id. Only written before
+ * anything is decompressed, so lookups don't need a lock */
+class ZstdDictionaries {
+public:
+	~ZstdDictionaries()
+	{
+		for (auto& entry : _dictionaries) {
+			ZSTD_freeDDict(entry.second);
+		}
+	}
+
+	bool add(const void* dict, size_t dictSize)
+	{
+		const uint32_t id = ZDICT_getDictID(dict, dictSize);
+		if (id == 0) {
+			return false;
+		}
+
+		ZSTD_DDict* ddict = ZSTD_createDDict(dict, dictSize);
+		if (ddict == NULL) {
+			return false;
+		}
+
+		auto it = _dictionaries.find(id);
+		if (it != _dictionaries.end()) {
+			ZSTD_freeDDict(it->second);
+		}
+		_dictionaries[id] = ddict;
+		return true;
+	}
+
+	const ZSTD_DDict* find(uint32_t id) const
+	{
+		auto it = _dictionaries.find(id);
+		return it == _dictionaries.end() ? NULL : it->second;
+	}
+
+private:
+	std::unordered_map<uint32_t, ZSTD_DDict*> _dictionaries;
+};
+
+ZstdDictionaries& zstdDictionaries()
+{
+	static ZstdDictionaries dictionaries;
+	return dictionaries;
+}
+
+/* a decompression context per thread, so loads on different threads don't share one
+ * and a thread doesn't allocate a new one for every asset */
+struct ZstdDCtx {
+	ZSTD_DCtx* ctx{ ZSTD_createDCtx() };
+
+	~ZstdDCtx()
+	{
+		ZSTD_freeDCtx(ctx);
+	}
+};
+
+size_t compressZstdBound(size_t inBufSize)
+{
+	return ZSTD_compressBound(inBufSize);
+}
+
+CompressResult_t compressBufferZstd(const void* inBuf, void* outBuf, size_t inBufSize, size_t outCapacity, int level, const void* dict, size_t dictSize)
+{
+	assert(inBuf != NULL || inBufSize == 0);
+	assert(outBuf != NULL);
+
+	CompressResult_t result = { 1, inBufSize, 0 };  /* result for an error */
+
+	ZSTD_CCtx* ctx = ZSTD_createCCtx();
+	if (ctx == NULL) {
+		printf("Failed to create zstd compression context\n");
+		return result;
+	}
+
+	const size_t compressedSize = ZSTD_compress_usingDict(ctx, outBuf, outCapacity, inBuf, inBufSize, dict, dictSize, level);
+	ZSTD_freeCCtx(ctx);
+
+	if (ZSTD_isError(compressedSize)) {
+		printf("Compression failed: %s\n", ZSTD_getErrorName(compressedSize));
+		return result;
+	}
+
+	result.error = 0;
+	result.sizeOut = compressedSize;
+	return result;
+}
+
+/* @result : 1==error, 0==success */
+int decompressBufferZstd(const void* inBuf, size_t inBufSize, void* outBuf, size_t dstCapacity)
+{
+	assert(inBuf != NULL);
+	assert(outBuf != NULL || dstCapacity == 0);
+
+	const ZSTD_DDict* ddict = NULL;
+	const uint32_t dictId = ZSTD_getDictID_fromFrame(inBuf, inBufSize);
+	if (dictId != 0) {
+		ddict = zstdDictionaries().find(dictId);
+		if (ddict == NULL) {
+			printf("Decompress: zstd dictionary %u isn't registered\n", dictId);
+			return 1;
+		}
+	}
+
+	thread_local ZstdDCtx dctx;
+	if (dctx.ctx == NULL) {
+		printf("Failed to create zstd decompression context\n");
+		return 1;
+	}
+
+	const size_t decompressedSize = ddict
+		? ZSTD_decompress_usingDDict(dctx.ctx, outBuf, dstCapacity, inBuf, inBufSize, ddict)
+		: ZSTD_decompressDCtx(dctx.ctx, outBuf, dstCapacity, inBuf, inBufSize);
+
+	if (ZSTD_isError(decompressedSize)) {
+		printf("Decompression error: %s\n", ZSTD_getErrorName(decompressedSize));
+		return 1;
+	}
+
+	if (decompressedSize != dstCapacity) {
+		printf("Decompress: zstd frame doesn't match output size\n");
+		return 1;
+	}
+
+	return 0;
+}
+
+bool registerZstdDictionary(const void* dict, size_t dictSize)
+{
+	return zstdDictionaries().add(dict, dictSize);
+}
+
+size_t trainZstdDictionary(void* dictBuf, size_t dictCapacity, const void* samples, const size_t* sampleSizes, uint32_t sampleCount)
+{
+	const size_t dictSize = ZDICT_trainFromBuffer(dictBuf, dictCapacity, samples, sampleSizes, sampleCount);
+	if (ZDICT_isError(dictSize)) {
+		printf("Dictionary training failed: %s\n", ZDICT_getErrorName(dictSize));
+		return 0;
+	}
+
+	return dictSize;
+}
+
+uint32_t zstdDictionaryId(const void* dict, size_t dictSize)
+{
+	return ZDICT_getDictID(dict, dictSize);
+}
@@ -1,5 +1,9 @@
 #include <cinttypes>
 #include <fstream>
+#include <functional>
+
+// Uncompressed size of each block in the LZ4_BLOCKS format
+constexpr uint32_t COMPRESSION_BLOCK_SIZE{ 256 * 1024 };
 
 struct CompressResult_t {
 	int error;
@@ -12,3 +16,44 @@ CompressResult_t compressBuffer(const void* inBuf, void* outBuf, uint32_t inBufS
 
 // Stream decompress file using LZ4
 int decompressFile(std::ifstream& inFile, void* outBuf);
+
+// Decompress an in-memory LZ4 frame directly into outBuf, which must hold dstCapacity bytes
+int decompressBuffer(const void* inBuf, size_t inBufSize, void* outBuf, size_t dstCapacity);
+
+// Upper bound on the output of compressBufferBlocks
+size_t compressBlocksBound(size_t inBufSize);
+
+// Compress a buffer into independently compressed LZ4 blocks, spread across numThreads threads (0 == one per core).
+// Layout is u32 block size, u32 block count, u32 compressed size per block, then the blocks themselves.
+// A block stored with its uncompressed size was incompressible and is stored as is.
+// With highCompression the blocks are encoded with LZ4-HC at the given level (1-12), otherwise level is the
+// LZ4 acceleration (1 == default, higher is faster but compresses less). Both decode with decompressBufferBlocks
+CompressResult_t compressBufferBlocks(const void* inBuf, void* outBuf, size_t inBufSize, bool highCompression, int level, uint32_t numThreads);
+
+// Decompress a buffer written by compressBufferBlocks, spread across numThreads threads (0 == one per core)
+int decompressBufferBlocks(const void* inBuf, size_t inBufSize, void* outBuf, size_t dstCapacity, uint32_t numThreads);
+
+// Upper bound on the output of compressBufferZstd
+size_t compressZstdBound(size_t inBufSize);
+
+// Compress a buffer into a single zstd frame at level (1-22). If dictSize isn't 0 the frame is compressed
+// with that dictionary, and it can only be decompressed once the same dictionary was registered
+CompressResult_t compressBufferZstd(const void* inBuf, void* outBuf, size_t inBufSize, size_t outCapacity, int level, const void* dict, size_t dictSize);
+
+// Decompress a frame written by compressBufferZstd, which must decompress to exactly dstCapacity bytes
+int decompressBufferZstd(const void* inBuf, size_t inBufSize, void* outBuf, size_t dstCapacity);
+
+// Make a dictionary available to decompressBufferZstd, which finds it by the id stored in each frame.
+// Not thread safe, register dictionaries before decompressing anything
+bool registerZstdDictionary(const void* dict, size_t dictSize);
+
+// Train a dictionary of at most dictCapacity bytes on samples, which are sampleCount buffers laid out back to back.
+// Returns the size of the dictionary, 0 if it couldn't be trained (usually because there were too few samples)
+size_t trainZstdDictionary(void* dictBuf, size_t dictCapacity, const void* samples, const size_t* sampleSizes, uint32_t sampleCount);
+
+// id that frames compressed with the dictionary refer to it by, 0 if dict isn't a zstd dictionary
+uint32_t zstdDictionaryId(const void* dict, size_t dictSize);
+
+// Calls fn(i) for every i in [0, count), with the indices handed out to numThreads threads one at a time
+// (0 == one per core). The helper threads are a pool shared by every caller, created on first use
+void parallelForBlocks(uint32_t count, uint32_t numThreads, const std::function<void(uint32_t)>& fn);
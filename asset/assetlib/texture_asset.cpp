@@ -12,6 +12,14 @@ assets::TextureFormat parseFormat(const char* f) {
 		return assets::TextureFormat::RGBA8;
 	} else if (strcmp(f, "SRGBA8") == 0) {
 		return assets::TextureFormat::SRGBA8;
+	} else if (strcmp(f, "BC4") == 0) {
+		return assets::TextureFormat::BC4;
+	} else if (strcmp(f, "BC5") == 0) {
+		return assets::TextureFormat::BC5;
+	} else if (strcmp(f, "BC7") == 0) {
+		return assets::TextureFormat::BC7;
+	} else if (strcmp(f, "BC7_SRGB") == 0) {
+		return assets::TextureFormat::BC7_SRGB;
 	} else {
 		return assets::TextureFormat::Unknown;
 	}
@@ -36,6 +44,26 @@ assets::TextureInfo assets::readTextureInfo(nlohmann::json& metadata)
 	return info;
 }
 
+const char* assets::textureFormatName(TextureFormat format)
+{
+	switch (format) {
+	case TextureFormat::RGBA8:
+		return "RGBA8";
+	case TextureFormat::SRGBA8:
+		return "SRGBA8";
+	case TextureFormat::BC4:
+		return "BC4";
+	case TextureFormat::BC5:
+		return "BC5";
+	case TextureFormat::BC7:
+		return "BC7";
+	case TextureFormat::BC7_SRGB:
+		return "BC7_SRGB";
+	default:
+		return "Unknown";
+	}
+}
+
 //void assets::unpackTexture(const char* compressedBuffer, char* destination, size_t compressedSize, size_t dstCapacity)
 //{
 //	LZ4F_dctx* context;
@@ -7,7 +7,12 @@ namespace assets {
 	{
 		Unknown = 0,
 		RGBA8,
-		SRGBA8
+		SRGBA8,
+		// block compressed, every mip is stored as 4x4 blocks
+		BC4,
+		BC5,
+		BC7,
+		BC7_SRGB
 	};
 
 	struct TextureInfo {
@@ -25,6 +30,9 @@ namespace assets {
 
 	TextureInfo readTextureInfo(nlohmann::json& metadata);
 
+	// name written to the "format" metadata field
+	const char* textureFormatName(TextureFormat format);
+
 	//void unpackTexture(const char* compressedBuffer, char* destination, size_t compressedSize, size_t dstCapacity);
 	void unpackTexture(const char* sourcebuffer, size_t sourceSize, void* destination);
 
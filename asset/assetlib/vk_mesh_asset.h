@@ -78,15 +78,15 @@ namespace assets {
 	};
 
 	struct SkeletalAnimationDataAsset {
+		// sorted so every node comes after its parent, so poses can be propagated in one pass over the array
 		std::vector<NodeAsset> nodes;
-		std::vector<NodeAsset> linearNodes;
 		std::vector<Animation> animations;
 		std::vector<SkinAsset> skins;
 
 		template<class Archive>
 		void serialize(Archive& archive)
 		{
-			archive(nodes, linearNodes, animations, skins); // serialize things by passing them to the archive
+			archive(nodes, animations, skins); // serialize things by passing them to the archive
 		}
 	};
 
@@ -1,12 +1,10 @@
 #version 460
-#define MAX_NUM_TOTAL_LIGHTS 10
+#define SHADOW_CASCADES 4
 
 layout (location = 0) in vec2 texCoord;
 layout (location = 1) in vec3 fragPos;
-layout (location = 2) in vec4 fragPosLightSpace;
 layout (location = 3) in vec3 camPos;
 layout (location = 4) in mat3 TBN;
-layout (location = 7) in vec3 lightPos[MAX_NUM_TOTAL_LIGHTS];
 
 layout (location = 0) out vec4 outFragColor;
 
@@ -17,18 +15,41 @@ layout (push_constant) uniform PushConstants
 } constants;
 
 struct Light {
-    vec4 position;  // w is unused
+    vec4 position;  // w is the radius of influence
     vec4 color;     // w is for intensity
 };
 
 layout (set = 0, binding = 1) uniform SceneData {
-    mat4 lightSpaceMatrix; // for shadow mapping
+    mat4 cascadeMatrices[SHADOW_CASCADES]; // for shadow mapping
+    vec4 cascadeSplits; // view depth where each cascade ends
     vec4 camPos; // w is unused
-    Light lights[MAX_NUM_TOTAL_LIGHTS];
-    int numLights;
+    vec4 camForward; // w is unused
+    uvec4 clusterGrid; // cluster counts, w is the capacity of each cluster's light list
+    vec4 clusterParams; // xy is one over the window size, z and w turn a view depth into a depth slice
 } sceneData;
 
-layout (set = 0, binding = 2) uniform sampler2D shadowMap;
+// comparison sampler, linear filtering gives a 2x2 PCF per tap for free
+layout (set = 0, binding = 2) uniform sampler2DArrayShadow shadowMap;
+// same image without comparison, for the PCSS blocker search
+layout (set = 0, binding = 3) uniform sampler2DArray shadowDepthMap;
+
+// every light in the scene
+layout (std430, set = 0, binding = 4) readonly buffer LightBuffer {
+    Light lights[];
+} lightBuffer;
+
+// number of lights in each cluster
+layout (std430, set = 0, binding = 5) readonly buffer LightGrid {
+    uint counts[];
+} lightGrid;
+
+// indices into lightBuffer, clusterGrid.w per cluster
+layout (std430, set = 0, binding = 6) readonly buffer LightIndices {
+    uint indices[];
+} lightIndices;
+
+// 0: hardware PCF, 1: Poisson disk PCF, 2: PCSS. Must match ShadowFilter
+layout (constant_id = 0) const int SHADOW_FILTER = 1;
 
 layout (set = 2, binding = 0) uniform sampler2D diffuseTex;
 layout (set = 2, binding = 1) uniform sampler2D normalTex;
@@ -48,6 +69,25 @@ const float PI = 3.14159265359;
 const float IRRADIANCE_SHADOW_CLAMP = 0.4;
 const float SPECULAR_SHADOW_CLAMP = 0.6;
 
+// Poisson disk PCF kernel radius in texels
+const float PCF_RADIUS = 1.5;
+// tangent of the light's angular radius, bigger means softer PCSS penumbrae
+const float LIGHT_SIZE = 0.02;
+// largest PCSS kernel radius in texels, to keep the cost bounded
+const float PCSS_MAX_RADIUS = 12.0;
+
+const int POISSON_SAMPLES = 16;
+const vec2 POISSON_DISK[POISSON_SAMPLES] = vec2[](
+    vec2(-0.94201624, -0.39906216), vec2(0.94558609, -0.76890725),
+    vec2(-0.09418410, -0.92938870), vec2(0.34495938, 0.29387760),
+    vec2(-0.91588581, 0.45771432), vec2(-0.81544232, -0.87912464),
+    vec2(-0.38277543, 0.27676845), vec2(0.97484398, 0.75648379),
+    vec2(0.44323325, -0.97511554), vec2(0.53742981, -0.47373420),
+    vec2(-0.26496911, -0.41893023), vec2(0.79197514, 0.19090188),
+    vec2(-0.24188840, 0.99706507), vec2(-0.81409955, 0.91437590),
+    vec2(0.19984126, 0.78641367), vec2(0.14383161, -0.14100790)
+);
+
 // F0 is the surface reflection at zero incidence (looking directly at surface)
 vec3 fresnelSchlick(float cosTheta, vec3 F0)
 {
@@ -94,16 +134,35 @@ float geometrySmith(vec3 N, vec3 V, vec3 L, float roughness)
     return ggx1 * ggx2;
 }
 
+// index of the cluster the fragment is in, the same way cluster_lights.comp lays them out
+uint clusterIndex(float viewDepth)
+{
+    uvec3 grid = sceneData.clusterGrid.xyz;
+    uvec2 tile = uvec2(min(gl_FragCoord.xy * sceneData.clusterParams.xy * vec2(grid.xy), vec2(grid.xy) - 1.0));
+    uint slice = uint(clamp(log(viewDepth) * sceneData.clusterParams.z - sceneData.clusterParams.w, 0.0, float(grid.z - 1)));
+    return tile.x + grid.x * (tile.y + grid.y * slice);
+}
+
 vec3 analytic_lights(vec3 N, vec3 V, vec3 F0, vec3 diffuse, float roughness, float metallic)
 {
+    float viewDepth = dot(fragPos - sceneData.camPos.xyz, sceneData.camForward.xyz);
+    uint cluster = clusterIndex(viewDepth);
+    uint first = cluster * sceneData.clusterGrid.w;
+    uint count = lightGrid.counts[cluster];
+
     vec3 Lo = vec3(0.0);
-    for (int i = 0; i < sceneData.numLights; ++i) {
-        vec3 L = normalize(lightPos[i] - fragPos);
+    for (uint i = 0; i < count; ++i) {
+        Light pointLight = lightBuffer.lights[lightIndices.indices[first + i]];
+        vec3 lightPos = pointLight.position.xyz;
+
+        vec3 L = normalize(lightPos - fragPos);
         vec3 H = normalize(V + L);
 
-        float dist = distance(fragPos, lightPos[i]);
-        float attentuation = 1.0 / (dist * dist);
-        vec3 light = sceneData.lights[i].color.xyz * sceneData.lights[i].color.w;
+        float dist = distance(fragPos, lightPos);
+        // fade to zero at the radius the light was binned with, so there's no edge at the cluster borders
+        float falloff = clamp(1.0 - pow(dist / pointLight.position.w, 4.0), 0.0, 1.0);
+        float attentuation = falloff * falloff / max(dist * dist, 0.0001);
+        vec3 light = pointLight.color.xyz * pointLight.color.w;
         vec3 radiance = light * attentuation;
 
         F0 = mix(F0, diffuse, metallic);
@@ -130,29 +189,100 @@ vec3 analytic_lights(vec3 N, vec3 V, vec3 F0, vec3 diffuse, float roughness, flo
     return Lo;
 }
 
-float shadowCalculation(vec4 fragPosLightSpace) {
+// rotates the Poisson disk per pixel, turning banding into noise that MSAA and the eye average out
+mat2 poissonRotation()
+{
+    float noise = fract(52.9829189 * fract(dot(gl_FragCoord.xy, vec2(0.06711056, 0.00583715))));
+    float angle = noise * 2.0 * PI;
+    float s = sin(angle);
+    float c = cos(angle);
+    return mat2(c, s, -s, c);
+}
+
+// returns the fraction of the filter footprint in shadow
+float poissonPCF(vec3 projCoords, float cascade, float radius)
+{
+    mat2 rotation = poissonRotation();
+    float lit = 0.0;
+    for (int i = 0; i < POISSON_SAMPLES; ++i) {
+        vec2 offset = rotation * POISSON_DISK[i] * radius;
+        lit += texture(shadowMap, vec4(projCoords.xy + offset, cascade, projCoords.z));
+    }
+    return 1.0 - lit / float(POISSON_SAMPLES);
+}
+
+// Percentage closer soft shadows. The penumbra widens with the distance between the receiver and the average
+// blocker. The light is directional and the cascade's depth range is as wide as its ortho extent, so depth
+// differences are already in the same units as uv offsets
+float pcss(vec3 projCoords, float cascade, float texelSize)
+{
+    mat2 rotation = poissonRotation();
+    float maxRadius = PCSS_MAX_RADIUS * texelSize;
+
+    // blocker search, over the part of the light that can see the receiver
+    float searchRadius = min(LIGHT_SIZE * projCoords.z, maxRadius);
+    float blockerDepth = 0.0;
+    int blockers = 0;
+    for (int i = 0; i < POISSON_SAMPLES; ++i) {
+        vec2 offset = rotation * POISSON_DISK[i] * searchRadius;
+        float depth = texture(shadowDepthMap, vec3(projCoords.xy + offset, cascade)).r;
+        if (depth < projCoords.z) {
+            blockerDepth += depth;
+            ++blockers;
+        }
+    }
+
+    if (blockers == 0) {
+        return 0.0;
+    }
+    blockerDepth /= float(blockers);
+
+    float penumbra = (projCoords.z - blockerDepth) * LIGHT_SIZE;
+    return poissonPCF(projCoords, cascade, clamp(penumbra, PCF_RADIUS * texelSize, maxRadius));
+}
+
+float shadowCalculation(vec3 fragPos) {
+    // pick the first cascade that reaches the fragment's view depth
+    float viewDepth = dot(fragPos - sceneData.camPos.xyz, sceneData.camForward.xyz);
+    int cascade = 0;
+    while (cascade < SHADOW_CASCADES && viewDepth > sceneData.cascadeSplits[cascade]) {
+        ++cascade;
+    }
+    // past the last cascade nothing is shadowed
+    if (cascade == SHADOW_CASCADES) {
+        return 0.0;
+    }
+
+    vec4 fragPosLightSpace = sceneData.cascadeMatrices[cascade] * vec4(fragPos, 1.0);
     // perform perspective divide
     vec3 projCoords = fragPosLightSpace.xyz / fragPosLightSpace.w;
     // fragment's lightspace position is in range [-1, 1] so we map it to rang [0, 1]
     projCoords.xy = projCoords.xy * 0.5 + 0.5;
-    // get closest depth from light's persepctive
-    float closestDepth = texture(shadowMap, projCoords.xy).r;
     // get depth of current fragment from light's perspective
-    float currentDepth = clamp(projCoords.z, 0.0, 1.0);
-    // check whether current frag pos is in shadow
-    float shadow = currentDepth > closestDepth ? 1.0 : 0.0;
+    projCoords.z = clamp(projCoords.z, 0.0, 1.0);
+
+    float texelSize = 1.0 / float(textureSize(shadowMap, 0).x);
 
-    return shadow;
+    if (SHADOW_FILTER == 2) {
+        return pcss(projCoords, float(cascade), texelSize);
+    } else if (SHADOW_FILTER == 1) {
+        return poissonPCF(projCoords, float(cascade), PCF_RADIUS * texelSize);
+    }
+    // the sampler compares against the fragment's depth, 1.0 means lit
+    return 1.0 - texture(shadowMap, vec4(projCoords.xy, float(cascade), projCoords.z));
 }
 
 void main()
 {
     vec3 diffuse = texture(diffuseTex, texCoord).rgb;
 
-    // obtain normal from normal map in range [0,1]
-    vec3 normal = texture(normalTex, texCoord).rgb;
-    // transform normal vector to range [-1, 1]
-    normal = normalize(normal * 2.0 - 1.0);
+    // obtain normal from normal map in range [0,1], only x and y are stored (BC5)
+    vec2 normalXY = texture(normalTex, texCoord).rg;
+    // transform normal vector to range [-1, 1] and reconstruct z, which always points out of the surface
+    vec3 normal;
+    normal.xy = normalXY * 2.0 - 1.0;
+    normal.z = sqrt(max(1.0 - dot(normal.xy, normal.xy), 0.0));
+    normal = normalize(normal);
     float roughness = texture(roughnessTex, texCoord).g * constants.roughness_multiplier.x;
     float ao = texture(aoTex, texCoord).r;
     float metallic = texture(metalTex, texCoord).b;
@@ -172,7 +302,7 @@ void main()
     vec3 kD = 1.0 - kS;
     kD *= 1.0 - metallic;
 
-    float shadow = shadowCalculation(fragPosLightSpace);
+    float shadow = shadowCalculation(fragPos);
     vec3 irradiance = texture(irradianceMap, N).rgb;
     irradiance = clamp(irradiance, 0.0, IRRADIANCE_SHADOW_CLAMP + 100.0 * (1.0 - shadow));
 
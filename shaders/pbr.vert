@@ -1,5 +1,5 @@
 #version 460 // version 460 required for indexing into transform array with gl_BaseInstance
-#define MAX_NUM_TOTAL_LIGHTS 10
+#define SHADOW_CASCADES 4
 
 layout (location = 0) in vec3 vPosition;
 layout (location = 1) in vec3 vNormal;
@@ -8,10 +8,8 @@ layout (location = 3) in vec2 vTexCoord;
 
 layout (location = 0) out vec2 texCoord;
 layout (location = 1) out vec3 fragPos;
-layout (location = 2) out vec4 fragPosLightSpace;
 layout (location = 3) out vec3 camPos;
 layout (location = 4) out mat3 outTBN;
-layout (location = 7) out vec3 lightPos[MAX_NUM_TOTAL_LIGHTS];
 
 layout (set = 0, binding = 0) uniform CameraBuffer {
     mat4 viewProjOrigin;
@@ -19,16 +17,13 @@ layout (set = 0, binding = 0) uniform CameraBuffer {
     mat4 viewProj;
 } cameraData;
 
-struct Light {
-    vec4 position;  // w is unused
-    vec4 color;     // w is for intensity
-};
-
 layout (set = 0, binding = 1) uniform SceneData {
-    mat4 lightSpaceMatrix; // for shadow mapping
+    mat4 cascadeMatrices[SHADOW_CASCADES]; // for shadow mapping
+    vec4 cascadeSplits; // view depth where each cascade ends
     vec4 camPos; // w is unused
-    Light lights[MAX_NUM_TOTAL_LIGHTS];
-    int numLights;
+    vec4 camForward; // w is unused
+    uvec4 clusterGrid;
+    vec4 clusterParams;
 } sceneData;
 
 struct ObjectData {
@@ -68,11 +63,6 @@ void main()
     // TBN = transpose(TBN);
 
     fragPos = worldPos4.xyz;
-    fragPosLightSpace = sceneData.lightSpaceMatrix * worldPos4;
     camPos = sceneData.camPos.xyz;
     outTBN = TBN;
-
-    for (int i = 0; i < MAX_NUM_TOTAL_LIGHTS; ++i) {
-        lightPos[i] = sceneData.lights[i].position.xyz;
-    }
 }
\ No newline at end of file
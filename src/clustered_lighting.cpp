@@ -0,0 +1,197 @@
+#include "clustered_lighting.h"
+
+#include <iostream>
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+#include "vk_engine.h"
+#include "vk_initializers.h"
+
+// must match local_size_x in cluster_lights.comp
+constexpr uint32_t BIN_GROUP_SIZE{ 64 };
+// radiance where a light's influence is cut off, for lights that don't set a radius
+constexpr float LIGHT_CUTOFF{ 0.01f };
+
+constexpr uint32_t CLUSTER_COUNT{ CLUSTER_X * CLUSTER_Y * CLUSTER_Z };
+
+void ClusteredLighting::init(VulkanEngine* engine)
+{
+	_engine = engine;
+
+	std::array<VkDescriptorSetLayoutBinding, 3> bindings{
+		vkinit::descriptorsetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0), // lights
+		vkinit::descriptorsetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1), // light grid
+		vkinit::descriptorsetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2)  // light indices
+	};
+
+	VkDescriptorSetLayoutCreateInfo setInfo{};
+	setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	setInfo.pNext = nullptr;
+	setInfo.flags = 0;
+	setInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+	setInfo.pBindings = bindings.data();
+
+	VK_CHECK(vkCreateDescriptorSetLayout(engine->_device, &setInfo, nullptr, &_binSetLayout));
+
+	VkPushConstantRange pushConstant{};
+	pushConstant.offset = 0;
+	pushConstant.size = sizeof(BinPushConstants);
+	pushConstant.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	VkPipelineLayoutCreateInfo layoutInfo{ vkinit::pipelineLayoutCreateInfo() };
+	layoutInfo.setLayoutCount = 1;
+	layoutInfo.pSetLayouts = &_binSetLayout;
+	layoutInfo.pushConstantRangeCount = 1;
+	layoutInfo.pPushConstantRanges = &pushConstant;
+
+	VK_CHECK(vkCreatePipelineLayout(engine->_device, &layoutInfo, nullptr, &_binPipelineLayout));
+
+	VkShaderModule binShader;
+	if (!engine->loadShaderModule("../../shaders/spirv/cluster_lights.comp.spv", &binShader)) {
+		std::cout << "Error when building the light binning compute shader module\n";
+	}
+
+	VkComputePipelineCreateInfo pipelineInfo{};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineInfo.pNext = nullptr;
+	pipelineInfo.stage = vkinit::pipelineShaderStageCreateInfo(VK_SHADER_STAGE_COMPUTE_BIT, binShader);
+	pipelineInfo.layout = _binPipelineLayout;
+
+	VK_CHECK(vkCreateComputePipelines(engine->_device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &_binPipeline));
+	vkDestroyShaderModule(engine->_device, binShader, nullptr);
+
+	_frames.resize(FRAME_OVERLAP);
+	for (uint32_t i{ 0 }; i < FRAME_OVERLAP; ++i) {
+		FrameResources& frame{ _frames[i] };
+
+		frame.lightBuffer = engine->createBuffer(sizeof(Light) * MAX_LIGHTS, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+		VK_CHECK(vmaMapMemory(engine->_allocator, frame.lightBuffer._allocation, &frame.lightData));
+		frame.gridBuffer = engine->createBuffer(sizeof(uint32_t) * CLUSTER_COUNT, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
+		frame.indexBuffer = engine->createBuffer(sizeof(uint32_t) * CLUSTER_COUNT * MAX_LIGHTS_PER_CLUSTER, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
+
+		VkDescriptorSetAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.pNext = nullptr;
+		allocInfo.descriptorPool = engine->_descriptorPool;
+		allocInfo.descriptorSetCount = 1;
+		allocInfo.pSetLayouts = &_binSetLayout;
+
+		VK_CHECK(vkAllocateDescriptorSets(engine->_device, &allocInfo, &frame.binDescriptor));
+
+		std::array<VkDescriptorBufferInfo, 3> bufferInfos{ lightBufferInfo(i), lightGridInfo(i), lightIndexInfo(i) };
+
+		std::array<VkWriteDescriptorSet, 3> writes{};
+		for (uint32_t binding{ 0 }; binding < writes.size(); ++binding) {
+			writes[binding] = vkinit::writeDescriptorBuffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, frame.binDescriptor, &bufferInfos[binding], binding);
+		}
+
+		vkUpdateDescriptorSets(engine->_device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+	}
+
+	engine->_mainDeletionQueue.pushFunction([=]() {
+		for (FrameResources& frame : _frames) {
+			vmaUnmapMemory(_engine->_allocator, frame.lightBuffer._allocation);
+			vmaDestroyBuffer(_engine->_allocator, frame.lightBuffer._buffer, frame.lightBuffer._allocation);
+			vmaDestroyBuffer(_engine->_allocator, frame.gridBuffer._buffer, frame.gridBuffer._allocation);
+			vmaDestroyBuffer(_engine->_allocator, frame.indexBuffer._buffer, frame.indexBuffer._allocation);
+		}
+		vkDestroyPipeline(_engine->_device, _binPipeline, nullptr);
+		vkDestroyPipelineLayout(_engine->_device, _binPipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(_engine->_device, _binSetLayout, nullptr);
+	});
+}
+
+void ClusteredLighting::setLights(const std::vector<Light>& lights)
+{
+	if (lights.size() > MAX_LIGHTS) {
+		std::cout << "Error: more than MAX_LIGHTS lights, the rest are dropped\n";
+	}
+
+	_lights.assign(lights.begin(), lights.begin() + std::min<size_t>(lights.size(), MAX_LIGHTS));
+}
+
+void ClusteredLighting::prepare(const glm::mat4& view, VkExtent2D extent, float fov, float nearPlane)
+{
+	ZoneScoped;
+	Light* gpuLights{ (Light*)currentFrame().lightData };
+
+	for (size_t i{ 0 }; i < _lights.size(); ++i) {
+		Light light{ _lights[i] };
+
+		// attenuation is inverse square, so find where the brightest channel falls below the cutoff
+		if (light.position.w <= 0.0f) {
+			float brightest{ std::max(light.color.r, std::max(light.color.g, light.color.b)) * light.color.w };
+			light.position.w = std::sqrt(std::max(brightest, 0.0f) / LIGHT_CUTOFF);
+		}
+		gpuLights[i] = light;
+	}
+
+	vmaFlushAllocation(_engine->_allocator, currentFrame().lightBuffer._allocation, 0, sizeof(Light) * _lights.size());
+
+	float tanHalfFovY{ std::tan(fov / 2.0f) };
+	_constants.view = view;
+	_constants.frustum = glm::vec4{ tanHalfFovY * extent.width / (float)extent.height, tanHalfFovY, nearPlane, CLUSTER_FAR_PLANE };
+	_constants.grid = grid();
+	_constants.lightCount = static_cast<uint32_t>(_lights.size());
+}
+
+void ClusteredLighting::cull(VkCommandBuffer cmd)
+{
+	// every cluster writes its count, even with no lights, so the grid is never stale
+	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, _binPipeline);
+	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, _binPipelineLayout, 0, 1, &currentFrame().binDescriptor, 0, nullptr);
+	vkCmdPushConstants(cmd, _binPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(BinPushConstants), &_constants);
+	vkCmdDispatch(cmd, (CLUSTER_COUNT + BIN_GROUP_SIZE - 1) / BIN_GROUP_SIZE, 1, 1);
+}
+
+glm::uvec4 ClusteredLighting::grid() const
+{
+	return glm::uvec4{ CLUSTER_X, CLUSTER_Y, CLUSTER_Z, MAX_LIGHTS_PER_CLUSTER };
+}
+
+glm::vec4 ClusteredLighting::sliceParams(VkExtent2D extent) const
+{
+	// slice = log(depth) * z - w, so slices are spaced exponentially between the near and far plane
+	float nearPlane{ _constants.frustum.z };
+	float logRange{ std::log(CLUSTER_FAR_PLANE / nearPlane) };
+	float scale{ CLUSTER_Z / logRange };
+	float bias{ CLUSTER_Z * std::log(nearPlane) / logRange };
+
+	return glm::vec4{ 1.0f / extent.width, 1.0f / extent.height, scale, bias };
+}
+
+VkDescriptorBufferInfo ClusteredLighting::lightBufferInfo(uint32_t frameIndex) const
+{
+	return VkDescriptorBufferInfo{ _frames[frameIndex].lightBuffer._buffer, 0, sizeof(Light) * MAX_LIGHTS };
+}
+
+VkDescriptorBufferInfo ClusteredLighting::lightGridInfo(uint32_t frameIndex) const
+{
+	return VkDescriptorBufferInfo{ _frames[frameIndex].gridBuffer._buffer, 0, sizeof(uint32_t) * CLUSTER_COUNT };
+}
+
+VkDescriptorBufferInfo ClusteredLighting::lightIndexInfo(uint32_t frameIndex) const
+{
+	return VkDescriptorBufferInfo{ _frames[frameIndex].indexBuffer._buffer, 0, sizeof(uint32_t) * CLUSTER_COUNT * MAX_LIGHTS_PER_CLUSTER };
+}
+
+VkBuffer ClusteredLighting::lightGridBuffer() const
+{
+	return currentFrame().gridBuffer._buffer;
+}
+
+VkBuffer ClusteredLighting::lightIndexBuffer() const
+{
+	return currentFrame().indexBuffer._buffer;
+}
+
+ClusteredLighting::FrameResources& ClusteredLighting::currentFrame()
+{
+	return _frames[_engine->_frameNumber % FRAME_OVERLAP];
+}
+
+const ClusteredLighting::FrameResources& ClusteredLighting::currentFrame() const
+{
+	return _frames[_engine->_frameNumber % FRAME_OVERLAP];
+}
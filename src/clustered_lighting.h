@@ -0,0 +1,96 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include "vk_types.h"
+#include "glm/glm.hpp"
+
+class VulkanEngine;
+
+// most point lights a scene can have
+constexpr uint32_t MAX_LIGHTS{ 1024 };
+// the view frustum is split into CLUSTER_X * CLUSTER_Y screen tiles and CLUSTER_Z exponential depth slices
+constexpr uint32_t CLUSTER_X{ 16 };
+constexpr uint32_t CLUSTER_Y{ 9 };
+constexpr uint32_t CLUSTER_Z{ 24 };
+// lights past this many in one cluster are dropped
+constexpr uint32_t MAX_LIGHTS_PER_CLUSTER{ 128 };
+// Rendering has an inf far plane, lights past this distance aren't shaded
+constexpr float CLUSTER_FAR_PLANE{ 200.0f };
+
+struct Light {
+	glm::vec4 position; // w is the radius of influence, 0 derives it from the intensity
+	glm::vec4 color;    // w is for intensity
+};
+
+// Clustered forward shading. A compute shader bins the lights into a 3D grid of view space clusters, then
+// the fragment shader only evaluates the lights of the cluster it falls in. Each cluster has a fixed size
+// slice of the light index buffer, so binning needs no atomics
+class ClusteredLighting {
+public:
+	void init(VulkanEngine* engine);
+
+	// lights shaded from the next prepare on
+	void setLights(const std::vector<Light>& lights);
+
+	// write the lights into the current frame's light buffer and set up binning for the camera
+	void prepare(const glm::mat4& view, VkExtent2D extent, float fov, float nearPlane);
+
+	// records the binning dispatch, must be outside of a render pass. The barrier between the
+	// dispatch and the fragment shader is left to the render graph
+	void cull(VkCommandBuffer cmd);
+
+	// x, y and z cluster counts, w is the capacity of each cluster's light list
+	glm::uvec4 grid() const;
+
+	// xy is one over the window size, z and w turn a view depth into a depth slice. Call after prepare
+	glm::vec4 sliceParams(VkExtent2D extent) const;
+
+	// buffers of frame frameIndex, for the global descriptor sets
+	VkDescriptorBufferInfo lightBufferInfo(uint32_t frameIndex) const;
+
+	VkDescriptorBufferInfo lightGridInfo(uint32_t frameIndex) const;
+
+	VkDescriptorBufferInfo lightIndexInfo(uint32_t frameIndex) const;
+
+	// the current frame's buffers written by cull and read by the main pass
+	VkBuffer lightGridBuffer() const;
+
+	VkBuffer lightIndexBuffer() const;
+
+private:
+	// matches the push constants in cluster_lights.comp
+	struct BinPushConstants {
+		glm::mat4 view;
+		// tan of half the horizontal and vertical fov, near and far plane
+		glm::vec4 frustum;
+		glm::uvec4 grid;
+		uint32_t lightCount;
+	};
+
+	struct FrameResources {
+		AllocatedBuffer lightBuffer;
+		// persistently mapped
+		void* lightData;
+		// light count of each cluster
+		AllocatedBuffer gridBuffer;
+		// MAX_LIGHTS_PER_CLUSTER light indices per cluster
+		AllocatedBuffer indexBuffer;
+		VkDescriptorSet binDescriptor;
+	};
+
+	FrameResources& currentFrame();
+
+	const FrameResources& currentFrame() const;
+
+	VulkanEngine* _engine{ nullptr };
+
+	VkDescriptorSetLayout _binSetLayout;
+	VkPipelineLayout _binPipelineLayout;
+	VkPipeline _binPipeline;
+
+	std::vector<FrameResources> _frames;
+	std::vector<Light> _lights;
+	BinPushConstants _constants{};
+};
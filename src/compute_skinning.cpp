@@ -0,0 +1,167 @@
+#include "compute_skinning.h"
+
+#include <iostream>
+#include <array>
+
+#include "vk_engine.h"
+#include "vk_initializers.h"
+
+// must match local_size_x in skinning.comp
+constexpr uint32_t SKIN_GROUP_SIZE{ 64 };
+
+void ComputeSkinning::init(VulkanEngine* engine)
+{
+	_engine = engine;
+
+	std::array<VkDescriptorSetLayoutBinding, 3> bindings{
+		vkinit::descriptorsetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0),        // bind pose vertices
+		vkinit::descriptorsetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_COMPUTE_BIT, 1), // joint matrices
+		vkinit::descriptorsetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2)         // skinned vertices
+	};
+
+	VkDescriptorSetLayoutCreateInfo setInfo{};
+	setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	setInfo.pNext = nullptr;
+	setInfo.flags = 0;
+	setInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+	setInfo.pBindings = bindings.data();
+
+	VK_CHECK(vkCreateDescriptorSetLayout(engine->_device, &setInfo, nullptr, &_skinSetLayout));
+
+	VkPushConstantRange pushConstant{};
+	pushConstant.offset = 0;
+	pushConstant.size = sizeof(SkinPushConstants);
+	pushConstant.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	VkPipelineLayoutCreateInfo layoutInfo{ vkinit::pipelineLayoutCreateInfo() };
+	layoutInfo.setLayoutCount = 1;
+	layoutInfo.pSetLayouts = &_skinSetLayout;
+	layoutInfo.pushConstantRangeCount = 1;
+	layoutInfo.pPushConstantRanges = &pushConstant;
+
+	VK_CHECK(vkCreatePipelineLayout(engine->_device, &layoutInfo, nullptr, &_skinPipelineLayout));
+
+	VkShaderModule skinShader;
+	if (!engine->loadShaderModule("../../shaders/spirv/skinning.comp.spv", &skinShader)) {
+		std::cout << "Error when building the skinning compute shader module\n";
+	}
+
+	VkComputePipelineCreateInfo pipelineInfo{};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineInfo.pNext = nullptr;
+	pipelineInfo.stage = vkinit::pipelineShaderStageCreateInfo(VK_SHADER_STAGE_COMPUTE_BIT, skinShader);
+	pipelineInfo.layout = _skinPipelineLayout;
+
+	VK_CHECK(vkCreateComputePipelines(engine->_device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &_skinPipeline));
+	vkDestroyShaderModule(engine->_device, skinShader, nullptr);
+
+	_frames.resize(FRAME_OVERLAP);
+	for (uint32_t i{ 0 }; i < FRAME_OVERLAP; ++i) {
+		FrameResources& frame{ _frames[i] };
+
+		frame.vertexBuffer = engine->createBuffer(sizeof(Vertex) * MAX_SKINNED_VERTICES, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
+
+		VkDescriptorSetAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.pNext = nullptr;
+		allocInfo.descriptorPool = engine->_descriptorPool;
+		allocInfo.descriptorSetCount = 1;
+		allocInfo.pSetLayouts = &_skinSetLayout;
+
+		VK_CHECK(vkAllocateDescriptorSets(engine->_device, &allocInfo, &frame.skinDescriptor));
+
+		// joint matrices are written to the frame allocator every frame and bound with a dynamic offset
+		std::array<VkDescriptorBufferInfo, 3> bufferInfos{};
+		bufferInfos[0].buffer = engine->_geometryPool.vertexBuffer(VertexFormat::SKINNED);
+		bufferInfos[0].range = VK_WHOLE_SIZE;
+		bufferInfos[1].buffer = engine->_frameAllocator.buffer();
+		bufferInfos[1].range = sizeof(Skin::UniformBlockSkinned);
+		bufferInfos[2].buffer = frame.vertexBuffer._buffer;
+		bufferInfos[2].range = sizeof(Vertex) * MAX_SKINNED_VERTICES;
+
+		std::array<VkWriteDescriptorSet, 3> writes{
+			vkinit::writeDescriptorBuffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, frame.skinDescriptor, &bufferInfos[0], 0),
+			vkinit::writeDescriptorBuffer(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, frame.skinDescriptor, &bufferInfos[1], 1),
+			vkinit::writeDescriptorBuffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, frame.skinDescriptor, &bufferInfos[2], 2)
+		};
+
+		vkUpdateDescriptorSets(engine->_device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+	}
+
+	engine->_mainDeletionQueue.pushFunction([=]() {
+		for (FrameResources& frame : _frames) {
+			vmaDestroyBuffer(_engine->_allocator, frame.vertexBuffer._buffer, frame.vertexBuffer._allocation);
+		}
+		vkDestroyPipeline(_engine->_device, _skinPipeline, nullptr);
+		vkDestroyPipelineLayout(_engine->_device, _skinPipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(_engine->_device, _skinSetLayout, nullptr);
+	});
+}
+
+void ComputeSkinning::prepare(std::vector<RenderObject>& objects, uint32_t objectCount)
+{
+	ZoneScoped;
+	_dispatches.clear();
+	uint32_t vertexCount{ 0 };
+
+	for (uint32_t idx{ 0 }; idx < objectCount; ++idx) {
+		RenderObject& object{ objects[idx] };
+		if (object.mesh->vertexFormat != VertexFormat::SKINNED) {
+			continue;
+		}
+
+		// drawn from the start of the buffer so it can't read out of bounds, but its vertices are garbage
+		object.animation.skinnedVertexOffset = 0;
+
+		if (object.animation.jointOffsets.empty()) {
+			std::cout << "Error: skinned mesh has no skin, load its skeletal animation before creating render objects\n";
+			continue;
+		}
+		if (vertexCount + object.mesh->vertexCount > MAX_SKINNED_VERTICES) {
+			std::cout << "Error: too many skinned vertices, increase MAX_SKINNED_VERTICES\n";
+			continue;
+		}
+
+		object.animation.skinnedVertexOffset = static_cast<int32_t>(vertexCount);
+
+		Dispatch dispatch{};
+		dispatch.constants.sourceOffset = static_cast<uint32_t>(object.mesh->vertexOffset);
+		dispatch.constants.skinnedOffset = vertexCount;
+		dispatch.constants.vertexCount = object.mesh->vertexCount;
+		// only the first skin is drawn
+		dispatch.jointOffset = object.animation.jointOffsets[0];
+		_dispatches.push_back(dispatch);
+
+		vertexCount += object.mesh->vertexCount;
+	}
+}
+
+void ComputeSkinning::skin(VkCommandBuffer cmd)
+{
+	if (_dispatches.empty()) {
+		return;
+	}
+
+	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, _skinPipeline);
+
+	for (const Dispatch& dispatch : _dispatches) {
+		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, _skinPipelineLayout, 0, 1, &currentFrame().skinDescriptor, 1, &dispatch.jointOffset);
+		vkCmdPushConstants(cmd, _skinPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(SkinPushConstants), &dispatch.constants);
+		vkCmdDispatch(cmd, (dispatch.constants.vertexCount + SKIN_GROUP_SIZE - 1) / SKIN_GROUP_SIZE, 1, 1);
+	}
+}
+
+VkBuffer ComputeSkinning::vertexBuffer() const
+{
+	return currentFrame().vertexBuffer._buffer;
+}
+
+ComputeSkinning::FrameResources& ComputeSkinning::currentFrame()
+{
+	return _frames[_engine->_frameNumber % FRAME_OVERLAP];
+}
+
+const ComputeSkinning::FrameResources& ComputeSkinning::currentFrame() const
+{
+	return _frames[_engine->_frameNumber % FRAME_OVERLAP];
+}
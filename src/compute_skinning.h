@@ -0,0 +1,65 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include "vk_types.h"
+#include "vk_mesh.h"
+
+class VulkanEngine;
+
+// skinned vertices written per frame, shared by every skinned render object
+constexpr uint32_t MAX_SKINNED_VERTICES{ 1024 * 1024 };
+
+// Skins every skinned render object once per frame. A compute shader applies the object's joint matrices to
+// its mesh in the geometry pool and writes plain Vertex data into a per frame buffer, so the shadow and main
+// passes draw skinned objects with the same pipelines as static meshes instead of skinning them per pass
+class ComputeSkinning {
+public:
+	void init(VulkanEngine* engine);
+
+	// give every skinned object its range of the current frame's vertex buffer and queue its dispatch.
+	// The objects' joint matrices must already be in the frame allocator
+	void prepare(std::vector<RenderObject>& objects, uint32_t objectCount);
+
+	// records the skinning dispatches, must be outside of a render pass. The barrier between the
+	// dispatches and the vertex input of the draws is left to the render graph
+	void skin(VkCommandBuffer cmd);
+
+	// the current frame's skinned vertices, in the DEFAULT vertex format
+	VkBuffer vertexBuffer() const;
+
+private:
+	// matches the push constants in skinning.comp
+	struct SkinPushConstants {
+		// first vertex of the mesh in the geometry pool's skinned vertex buffer
+		uint32_t sourceOffset;
+		// first vertex of the object in the frame's vertex buffer
+		uint32_t skinnedOffset;
+		uint32_t vertexCount;
+	};
+
+	struct Dispatch {
+		SkinPushConstants constants;
+		// of the object's joint matrices in the frame allocator
+		uint32_t jointOffset;
+	};
+
+	struct FrameResources {
+		AllocatedBuffer vertexBuffer;
+		VkDescriptorSet skinDescriptor;
+	};
+
+	FrameResources& currentFrame();
+
+	const FrameResources& currentFrame() const;
+
+	VulkanEngine* _engine{ nullptr };
+
+	VkDescriptorSetLayout _skinSetLayout;
+	VkPipelineLayout _skinPipelineLayout;
+	VkPipeline _skinPipeline;
+
+	std::vector<FrameResources> _frames;
+	std::vector<Dispatch> _dispatches;
+};
@@ -0,0 +1,87 @@
+#include "draw_list.h"
+
+#include <array>
+#include <cstring>
+#include <algorithm>
+
+namespace {
+	uint64_t keyBits(uint32_t value, uint32_t bits)
+	{
+		return static_cast<uint64_t>(std::min<uint32_t>(value, (1u << bits) - 1));
+	}
+}
+
+uint64_t makeSortKey(DrawPass pass, const RenderObject& object, float depth)
+{
+	// positive floats order the same as their bit patterns, so the top 16 bits are a monotonic depth
+	uint32_t depthBits{ 0 };
+	if (depth > 0.0f) {
+		std::memcpy(&depthBits, &depth, sizeof(float));
+	}
+
+	uint64_t key{ static_cast<uint64_t>(pass) << 62 };
+	key |= keyBits(object.material->pipelineSortId, 14) << 48;
+	key |= keyBits(object.material->sortId, 16) << 32;
+	key |= keyBits(object.mesh->sortId, 16) << 16;
+	key |= static_cast<uint64_t>(depthBits >> 16);
+	return key;
+}
+
+void DrawList::clear()
+{
+	_keys.clear();
+	_objectIndices.clear();
+}
+
+void DrawList::add(uint64_t key, uint32_t objectIndex)
+{
+	_keys.push_back(key);
+	_objectIndices.push_back(objectIndex);
+}
+
+void DrawList::sort()
+{
+	size_t count{ _keys.size() };
+	_tempKeys.resize(count);
+	_tempIndices.resize(count);
+
+	// least significant digit first radix sort, one byte per pass. It's stable, so draws
+	// with equal keys keep the order they were added in
+	for (uint32_t shift{ 0 }; shift < 64; shift += 8) {
+		std::array<uint32_t, 256> offsets{};
+		for (uint64_t key : _keys) {
+			++offsets[(key >> shift) & 0xFF];
+		}
+
+		// every key has the same byte here, nothing would move
+		if (count == 0 || offsets[(_keys[0] >> shift) & 0xFF] == count) {
+			continue;
+		}
+
+		uint32_t sum{ 0 };
+		for (uint32_t& offset : offsets) {
+			uint32_t digitCount{ offset };
+			offset = sum;
+			sum += digitCount;
+		}
+
+		for (size_t i{ 0 }; i < count; ++i) {
+			uint32_t dst{ offsets[(_keys[i] >> shift) & 0xFF]++ };
+			_tempKeys[dst] = _keys[i];
+			_tempIndices[dst] = _objectIndices[i];
+		}
+
+		_keys.swap(_tempKeys);
+		_objectIndices.swap(_tempIndices);
+	}
+}
+
+const std::vector<uint32_t>& DrawList::objectIndices() const
+{
+	return _objectIndices;
+}
+
+uint32_t DrawList::size() const
+{
+	return static_cast<uint32_t>(_objectIndices.size());
+}
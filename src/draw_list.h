@@ -0,0 +1,42 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include "vk_mesh.h"
+
+// pass the draw belongs to, in the highest bits of the sort key
+enum class DrawPass : uint64_t {
+	SHADOW = 0,
+	MAIN = 1
+};
+
+// 64 bit sort key, from most to least significant:
+// pass (2 bits) | pipeline (14 bits) | material (16 bits) | mesh (16 bits) | depth (16 bits)
+// so draws are grouped by state first, and front to back within the same mesh.
+// depth is a distance from the viewer, negative depths sort as zero
+uint64_t makeSortKey(DrawPass pass, const RenderObject& object, float depth);
+
+// Draws for one pass, radix sorted by their key every frame
+class DrawList {
+public:
+	void clear();
+
+	// objectIndex is the object's dense index in the RenderObjectStore, also its index in the object SSBO
+	void add(uint64_t key, uint32_t objectIndex);
+
+	void sort();
+
+	// object indices in draw order
+	const std::vector<uint32_t>& objectIndices() const;
+
+	uint32_t size() const;
+
+private:
+	std::vector<uint64_t> _keys;
+	std::vector<uint32_t> _objectIndices;
+
+	// ping pong buffers for the radix sort, kept around so sorting doesn't allocate every frame
+	std::vector<uint64_t> _tempKeys;
+	std::vector<uint32_t> _tempIndices;
+};
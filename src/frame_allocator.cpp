@@ -0,0 +1,68 @@
+#include "frame_allocator.h"
+
+#include <iostream>
+#include <cstdlib>
+
+#include "vk_engine.h"
+
+void FrameAllocator::init(VulkanEngine* engine, uint32_t framesInFlight)
+{
+	_engine = engine;
+	_alignment = engine->_gpuProperties.limits.minUniformBufferOffsetAlignment;
+
+	VkBufferCreateInfo bufferInfo{};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.pNext = nullptr;
+	bufferInfo.size = FRAME_ALLOCATOR_SIZE * framesInFlight;
+	bufferInfo.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+
+	VmaAllocationCreateInfo vmaAllocInfo{};
+	vmaAllocInfo.usage = VMA_MEMORY_USAGE_CPU_TO_GPU;
+	vmaAllocInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+	VmaAllocationInfo allocInfo{};
+	VK_CHECK(vmaCreateBuffer(engine->_allocator, &bufferInfo, &vmaAllocInfo, &_buffer._buffer, &_buffer._allocation, &allocInfo));
+	_data = static_cast<char*>(allocInfo.pMappedData);
+}
+
+void FrameAllocator::cleanup()
+{
+	vmaDestroyBuffer(_engine->_allocator, _buffer._buffer, _buffer._allocation);
+}
+
+void FrameAllocator::beginFrame(uint32_t frameIndex)
+{
+	_regionBegin = FRAME_ALLOCATOR_SIZE * frameIndex;
+	_head = _regionBegin;
+}
+
+FrameAllocator::Allocation FrameAllocator::allocate(VkDeviceSize size)
+{
+	VkDeviceSize offset{ (_head + _alignment - 1) / _alignment * _alignment };
+
+	if (offset + size > _regionBegin + FRAME_ALLOCATOR_SIZE) {
+		// everything already in the region is still bound this frame and the other regions are in use by the
+		// frames in flight, so there is nowhere to put the data that doesn't overwrite a live allocation
+		std::cout << "Error: frame allocator is out of memory, increase FRAME_ALLOCATOR_SIZE\n";
+		std::abort();
+	}
+
+	_head = offset + size;
+
+	Allocation allocation{};
+	allocation.offset = static_cast<uint32_t>(offset);
+	allocation.data = _data + offset;
+	return allocation;
+}
+
+void FrameAllocator::flush()
+{
+	if (_head > _regionBegin) {
+		vmaFlushAllocation(_engine->_allocator, _buffer._allocation, _regionBegin, _head - _regionBegin);
+	}
+}
+
+VkBuffer FrameAllocator::buffer() const
+{
+	return _buffer._buffer;
+}
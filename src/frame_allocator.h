@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+#include "vk_types.h"
+
+class VulkanEngine;
+
+// size of each frame's region of the transient uniform ring. Every skinned render object pushes its own
+// joint matrices (~8KB), so this is what bounds the number of characters on screen
+constexpr VkDeviceSize FRAME_ALLOCATOR_SIZE{ 4 * 1024 * 1024 };
+
+// Linear allocator for uniform data that only lives for one frame (camera, scene, light, joint matrices).
+// One persistently mapped buffer is split into a region per frame in flight. Each frame bump allocates from
+// the start of its region, and the data is bound through UNIFORM_BUFFER_DYNAMIC descriptors that all point at
+// the same buffer, so nothing is mapped, unmapped or rebound to a different buffer per write
+class FrameAllocator {
+public:
+	struct Allocation {
+		// dynamic offset to bind the data with
+		uint32_t offset;
+		void* data;
+	};
+
+	void init(VulkanEngine* engine, uint32_t framesInFlight);
+
+	void cleanup();
+
+	// Rewind to the start of frameIndex's region. Must be called after the frame's fence was waited on,
+	// since the GPU is done with everything that region held
+	void beginFrame(uint32_t frameIndex);
+
+	// aligned to minUniformBufferOffsetAlignment so the offset can be used as a dynamic offset
+	Allocation allocate(VkDeviceSize size);
+
+	// copy data into the frame's region and return its dynamic offset
+	template<typename T>
+	uint32_t push(const T& data)
+	{
+		Allocation allocation{ allocate(sizeof(T)) };
+		std::memcpy(allocation.data, &data, sizeof(T));
+		return allocation.offset;
+	}
+
+	// flush everything allocated this frame, call before submitting the frame
+	void flush();
+
+	VkBuffer buffer() const;
+
+private:
+	VulkanEngine* _engine{ nullptr };
+
+	AllocatedBuffer _buffer;
+	char* _data{ nullptr };
+	VkDeviceSize _alignment{ 0 };
+
+	VkDeviceSize _regionBegin{ 0 };
+	VkDeviceSize _head{ 0 };
+};
@@ -0,0 +1,105 @@
+#include "frustum_culling.h"
+
+#include <limits>
+#include <algorithm>
+#include <xmmintrin.h>
+
+// spheres tested per iteration, one per SSE lane
+constexpr uint32_t CULL_SIMD_WIDTH{ 4 };
+
+namespace {
+	glm::vec4 normalizePlane(const glm::vec4& plane)
+	{
+		return plane / glm::length(glm::vec3{ plane });
+	}
+}
+
+Frustum extractFrustum(const glm::mat4& viewProj, bool infiniteFar, bool cullNear)
+{
+	// glm matrices are column major so row i of viewProj is column i of the transpose
+	glm::mat4 m{ glm::transpose(viewProj) };
+
+	Frustum frustum{};
+	frustum.planes[0] = normalizePlane(m[3] + m[0]);
+	frustum.planes[1] = normalizePlane(m[3] - m[0]);
+	frustum.planes[2] = normalizePlane(m[3] + m[1]);
+	frustum.planes[3] = normalizePlane(m[3] - m[1]);
+	frustum.planeCount = 4;
+
+	// depth is zero to one, so the near plane is just the z row
+	if (cullNear) {
+		frustum.planes[frustum.planeCount++] = normalizePlane(m[2]);
+	}
+
+	// an infinite projection has a degenerate far plane
+	if (!infiniteFar) {
+		frustum.planes[frustum.planeCount++] = normalizePlane(m[3] - m[2]);
+	}
+
+	return frustum;
+}
+
+void BoundingSpheres::clear()
+{
+	_count = 0;
+}
+
+void BoundingSpheres::push(const MeshBounds& bounds, const glm::mat4& model)
+{
+	// grow a whole SIMD block at a time so cull never reads past the end
+	if (_count == _x.size()) {
+		size_t newSize{ _x.size() + CULL_SIMD_WIDTH };
+		_x.resize(newSize, 0.0f);
+		_y.resize(newSize, 0.0f);
+		_z.resize(newSize, 0.0f);
+		_radius.resize(newSize, 0.0f);
+	}
+
+	glm::vec3 center{ model * glm::vec4{ bounds.origin[0], bounds.origin[1], bounds.origin[2], 1.0f } };
+	// the largest axis scale keeps the sphere enclosing the mesh under non uniform scale
+	float scale{ std::max({ glm::length(glm::vec3{ model[0] }), glm::length(glm::vec3{ model[1] }), glm::length(glm::vec3{ model[2] }) }) };
+
+	_x[_count] = center.x;
+	_y[_count] = center.y;
+	_z[_count] = center.z;
+	_radius[_count] = bounds.radius < 0.0f ? std::numeric_limits<float>::max() : bounds.radius * scale;
+	++_count;
+}
+
+uint32_t BoundingSpheres::size() const
+{
+	return _count;
+}
+
+void BoundingSpheres::cull(const Frustum& frustum, std::vector<uint8_t>& visible) const
+{
+	visible.resize(_count);
+
+	const __m128 zero{ _mm_setzero_ps() };
+
+	for (uint32_t i{ 0 }; i < _count; i += CULL_SIMD_WIDTH) {
+		__m128 x{ _mm_loadu_ps(&_x[i]) };
+		__m128 y{ _mm_loadu_ps(&_y[i]) };
+		__m128 z{ _mm_loadu_ps(&_z[i]) };
+		__m128 negRadius{ _mm_sub_ps(zero, _mm_loadu_ps(&_radius[i])) };
+
+		// all lanes start inside, every plane can only clear them
+		__m128 inside{ _mm_cmpeq_ps(zero, zero) };
+
+		for (uint32_t p{ 0 }; p < frustum.planeCount; ++p) {
+			const glm::vec4& plane{ frustum.planes[p] };
+
+			__m128 distance{ _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(plane.x)), _mm_mul_ps(y, _mm_set1_ps(plane.y))),
+				_mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(plane.z)), _mm_set1_ps(plane.w))) };
+
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negRadius));
+		}
+
+		int mask{ _mm_movemask_ps(inside) };
+		uint32_t lanes{ std::min(CULL_SIMD_WIDTH, _count - i) };
+		for (uint32_t lane{ 0 }; lane < lanes; ++lane) {
+			visible[i + lane] = static_cast<uint8_t>((mask >> lane) & 1);
+		}
+	}
+}
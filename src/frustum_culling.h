@@ -0,0 +1,41 @@
+#pragma once
+
+#include <vector>
+#include <array>
+#include <cstdint>
+
+#include "glm/glm.hpp"
+#include "vk_mesh.h"
+
+// planes are (normal, distance) with the normals pointing into the frustum
+struct Frustum {
+	std::array<glm::vec4, 6> planes;
+	uint32_t planeCount;
+};
+
+// Gribb/Hartmann plane extraction for a zero to one depth projection, in the order
+// left, right, bottom, top, near, far. infiniteFar leaves out the far plane, and !cullNear
+// the near plane, for shadow casters that are pancaked onto it
+Frustum extractFrustum(const glm::mat4& viewProj, bool infiniteFar, bool cullNear);
+
+// World space bounding spheres of every renderable, in structure of arrays layout
+// padded to the SIMD width so they can be culled four at a time
+class BoundingSpheres {
+public:
+	void clear();
+
+	// mesh bounds with a negative radius are never culled
+	void push(const MeshBounds& bounds, const glm::mat4& model);
+
+	uint32_t size() const;
+
+	// visible[i] is 1 if sphere i intersects the frustum, otherwise 0
+	void cull(const Frustum& frustum, std::vector<uint8_t>& visible) const;
+
+private:
+	std::vector<float> _x;
+	std::vector<float> _y;
+	std::vector<float> _z;
+	std::vector<float> _radius;
+	uint32_t _count{ 0 };
+};
@@ -0,0 +1,166 @@
+#include "geometry_pool.h"
+
+#include <iostream>
+#include <iterator>
+
+#include "vk_engine.h"
+
+void FreeListAllocator::init(uint64_t capacity)
+{
+	_capacity = capacity;
+	_used = 0;
+	_freeBlocks.clear();
+	_freeBlocks[0] = capacity;
+}
+
+uint64_t FreeListAllocator::allocate(uint64_t size)
+{
+	if (size == 0) {
+		return 0;
+	}
+
+	for (auto it{ _freeBlocks.begin() }; it != _freeBlocks.end(); ++it) {
+		if (it->second >= size) {
+			uint64_t offset{ it->first };
+			uint64_t remaining{ it->second - size };
+
+			_freeBlocks.erase(it);
+			if (remaining > 0) {
+				_freeBlocks[offset + size] = remaining;
+			}
+
+			_used += size;
+			return offset;
+		}
+	}
+
+	return INVALID_OFFSET;
+}
+
+void FreeListAllocator::free(uint64_t offset, uint64_t size)
+{
+	if (size == 0) {
+		return;
+	}
+
+	_used -= size;
+
+	auto it{ _freeBlocks.emplace(offset, size).first };
+
+	// merge with the following block
+	auto next{ std::next(it) };
+	if (next != _freeBlocks.end() && it->first + it->second == next->first) {
+		it->second += next->second;
+		_freeBlocks.erase(next);
+	}
+
+	// merge with the preceding block
+	if (it != _freeBlocks.begin()) {
+		auto prev{ std::prev(it) };
+		if (prev->first + prev->second == it->first) {
+			prev->second += it->second;
+			_freeBlocks.erase(it);
+		}
+	}
+}
+
+uint64_t FreeListAllocator::capacity() const
+{
+	return _capacity;
+}
+
+uint64_t FreeListAllocator::used() const
+{
+	return _used;
+}
+
+void GeometryPool::init(VulkanEngine* engine)
+{
+	_engine = engine;
+
+	_vertices.allocator.init(GEOMETRY_POOL_VERTICES);
+	_vertices.buffer = engine->createBuffer(GEOMETRY_POOL_VERTICES * vertexStride(VertexFormat::DEFAULT), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
+
+	_verticesSkinned.allocator.init(GEOMETRY_POOL_VERTICES_SKINNED);
+	// only read by the skinning compute shader, skinned meshes are drawn from its output
+	_verticesSkinned.buffer = engine->createBuffer(GEOMETRY_POOL_VERTICES_SKINNED * vertexStride(VertexFormat::SKINNED), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
+
+	_indices.init(GEOMETRY_POOL_INDICES);
+	_indexBuffer = engine->createBuffer(GEOMETRY_POOL_INDICES * sizeof(uint16_t), VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
+}
+
+void GeometryPool::cleanup()
+{
+	vmaDestroyBuffer(_engine->_allocator, _vertices.buffer._buffer, _vertices.buffer._allocation);
+	vmaDestroyBuffer(_engine->_allocator, _verticesSkinned.buffer._buffer, _verticesSkinned.buffer._allocation);
+	vmaDestroyBuffer(_engine->_allocator, _indexBuffer._buffer, _indexBuffer._allocation);
+}
+
+bool GeometryPool::allocate(Mesh* mesh, uint32_t vertexCount, uint32_t indexCount)
+{
+	VertexPool& pool{ vertexPool(mesh->vertexFormat) };
+
+	uint64_t vertexOffset{ pool.allocator.allocate(vertexCount) };
+	if (vertexOffset == FreeListAllocator::INVALID_OFFSET) {
+		std::cout << "Error: geometry pool is out of vertices (" << pool.allocator.used() << "/" << pool.allocator.capacity() << " used)\n";
+		return false;
+	}
+
+	uint64_t firstIndex{ _indices.allocate(indexCount) };
+	if (firstIndex == FreeListAllocator::INVALID_OFFSET) {
+		std::cout << "Error: geometry pool is out of indices (" << _indices.used() << "/" << _indices.capacity() << " used)\n";
+		pool.allocator.free(vertexOffset, vertexCount);
+		return false;
+	}
+
+	mesh->vertexOffset = static_cast<int32_t>(vertexOffset);
+	mesh->vertexCount = vertexCount;
+	mesh->firstIndex = static_cast<uint32_t>(firstIndex);
+	mesh->indexCount = indexCount;
+
+	return true;
+}
+
+void GeometryPool::free(Mesh* mesh)
+{
+	vertexPool(mesh->vertexFormat).allocator.free(mesh->vertexOffset, mesh->vertexCount);
+	_indices.free(mesh->firstIndex, mesh->indexCount);
+
+	mesh->vertexCount = 0;
+	mesh->indexCount = 0;
+}
+
+VkBuffer GeometryPool::vertexBuffer(VertexFormat format) const
+{
+	return vertexPool(format).buffer._buffer;
+}
+
+VkBuffer GeometryPool::indexBuffer() const
+{
+	return _indexBuffer._buffer;
+}
+
+VkDeviceSize GeometryPool::vertexByteOffset(const Mesh* mesh) const
+{
+	return static_cast<VkDeviceSize>(mesh->vertexOffset) * vertexStride(mesh->vertexFormat);
+}
+
+VkDeviceSize GeometryPool::indexByteOffset(const Mesh* mesh) const
+{
+	return static_cast<VkDeviceSize>(mesh->firstIndex) * sizeof(uint16_t);
+}
+
+VkDeviceSize GeometryPool::vertexStride(VertexFormat format)
+{
+	return format == VertexFormat::SKINNED ? sizeof(VertexSkinned) : sizeof(Vertex);
+}
+
+GeometryPool::VertexPool& GeometryPool::vertexPool(VertexFormat format)
+{
+	return format == VertexFormat::SKINNED ? _verticesSkinned : _vertices;
+}
+
+const GeometryPool::VertexPool& GeometryPool::vertexPool(VertexFormat format) const
+{
+	return format == VertexFormat::SKINNED ? _verticesSkinned : _vertices;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <map>
+#include <cstdint>
+
+#include "vk_types.h"
+#include "vk_mesh.h"
+
+class VulkanEngine;
+
+// capacity of the shared geometry buffers, in elements
+constexpr uint64_t GEOMETRY_POOL_VERTICES{ 2 * 1024 * 1024 };
+constexpr uint64_t GEOMETRY_POOL_VERTICES_SKINNED{ 256 * 1024 };
+constexpr uint64_t GEOMETRY_POOL_INDICES{ 16 * 1024 * 1024 };
+
+// first fit free list over a range of elements, adjacent free blocks are merged when released
+class FreeListAllocator {
+public:
+	static constexpr uint64_t INVALID_OFFSET{ UINT64_MAX };
+
+	void init(uint64_t capacity);
+
+	// returns INVALID_OFFSET if there's no free block big enough
+	uint64_t allocate(uint64_t size);
+
+	void free(uint64_t offset, uint64_t size);
+
+	uint64_t capacity() const;
+
+	uint64_t used() const;
+
+private:
+	// offset -> size of each free block
+	std::map<uint64_t, uint64_t> _freeBlocks;
+	uint64_t _capacity{ 0 };
+	uint64_t _used{ 0 };
+};
+
+// One vertex buffer per VertexFormat and one index buffer shared by every mesh. Meshes are sub-allocated
+// from them and drawn with firstIndex/vertexOffset, so draws only rebind buffers when the vertex format changes
+class GeometryPool {
+public:
+	void init(VulkanEngine* engine);
+
+	void cleanup();
+
+	// reserves space for the mesh and fills in its vertexOffset and firstIndex. Returns false if the pool is full
+	bool allocate(Mesh* mesh, uint32_t vertexCount, uint32_t indexCount);
+
+	void free(Mesh* mesh);
+
+	VkBuffer vertexBuffer(VertexFormat format) const;
+
+	VkBuffer indexBuffer() const;
+
+	// bytes from the start of the format's vertex buffer to the mesh's first vertex
+	VkDeviceSize vertexByteOffset(const Mesh* mesh) const;
+
+	VkDeviceSize indexByteOffset(const Mesh* mesh) const;
+
+	static VkDeviceSize vertexStride(VertexFormat format);
+
+private:
+	struct VertexPool {
+		AllocatedBuffer buffer;
+		FreeListAllocator allocator;
+	};
+
+	VertexPool& vertexPool(VertexFormat format);
+
+	const VertexPool& vertexPool(VertexFormat format) const;
+
+	VulkanEngine* _engine{ nullptr };
+
+	VertexPool _vertices;
+	VertexPool _verticesSkinned;
+
+	AllocatedBuffer _indexBuffer;
+	FreeListAllocator _indices;
+};
@@ -0,0 +1,257 @@
+#include "indirect_draw.h"
+
+#include <iostream>
+#include <cstring>
+#include <array>
+
+#include "vk_engine.h"
+#include "vk_initializers.h"
+#include "frustum_culling.h"
+
+// must match local_size_x in cull.comp
+constexpr uint32_t CULL_GROUP_SIZE{ 64 };
+
+namespace {
+	bool deviceSupportsExtension(VkPhysicalDevice physicalDevice, const char* name)
+	{
+		uint32_t count{ 0 };
+		vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &count, nullptr);
+		std::vector<VkExtensionProperties> extensions(count);
+		vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &count, extensions.data());
+
+		for (const VkExtensionProperties& extension : extensions) {
+			if (std::strcmp(extension.extensionName, name) == 0) {
+				return true;
+			}
+		}
+		return false;
+	}
+}
+
+void IndirectDraw::init(VulkanEngine* engine)
+{
+	_engine = engine;
+
+	// vkbootstrap enables desired extensions whenever the device supports them
+	if (deviceSupportsExtension(engine->_chosenGPU, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME)) {
+		_drawIndexedIndirectCount = (PFN_vkCmdDrawIndexedIndirectCountKHR)vkGetDeviceProcAddr(engine->_device, "vkCmdDrawIndexedIndirectCountKHR");
+	}
+
+	std::array<VkDescriptorSetLayoutBinding, 4> bindings{
+		vkinit::descriptorsetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0), // object matrices
+		vkinit::descriptorsetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1), // draw objects
+		vkinit::descriptorsetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2), // commands
+		vkinit::descriptorsetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 3)  // counts
+	};
+
+	VkDescriptorSetLayoutCreateInfo setInfo{};
+	setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	setInfo.pNext = nullptr;
+	setInfo.flags = 0;
+	setInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+	setInfo.pBindings = bindings.data();
+
+	VK_CHECK(vkCreateDescriptorSetLayout(engine->_device, &setInfo, nullptr, &_cullSetLayout));
+
+	VkPushConstantRange pushConstant{};
+	pushConstant.offset = 0;
+	pushConstant.size = sizeof(CullPushConstants);
+	pushConstant.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	VkPipelineLayoutCreateInfo layoutInfo{ vkinit::pipelineLayoutCreateInfo() };
+	layoutInfo.setLayoutCount = 1;
+	layoutInfo.pSetLayouts = &_cullSetLayout;
+	layoutInfo.pushConstantRangeCount = 1;
+	layoutInfo.pPushConstantRanges = &pushConstant;
+
+	VK_CHECK(vkCreatePipelineLayout(engine->_device, &layoutInfo, nullptr, &_cullPipelineLayout));
+
+	VkShaderModule cullShader;
+	if (!engine->loadShaderModule("../../shaders/spirv/cull.comp.spv", &cullShader)) {
+		std::cout << "Error when building the culling compute shader module\n";
+	}
+
+	VkComputePipelineCreateInfo pipelineInfo{};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineInfo.pNext = nullptr;
+	pipelineInfo.stage = vkinit::pipelineShaderStageCreateInfo(VK_SHADER_STAGE_COMPUTE_BIT, cullShader);
+	pipelineInfo.layout = _cullPipelineLayout;
+
+	VK_CHECK(vkCreateComputePipelines(engine->_device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &_cullPipeline));
+	vkDestroyShaderModule(engine->_device, cullShader, nullptr);
+
+	_frames.resize(FRAME_OVERLAP);
+	for (uint32_t i{ 0 }; i < FRAME_OVERLAP; ++i) {
+		FrameResources& frame{ _frames[i] };
+
+		frame.drawObjectBuffer = engine->createBuffer(sizeof(GPUDrawObject) * MAX_OBJECTS, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+		VK_CHECK(vmaMapMemory(engine->_allocator, frame.drawObjectBuffer._allocation, &frame.drawObjectData));
+		frame.commandBuffer = engine->createBuffer(sizeof(VkDrawIndexedIndirectCommand) * MAX_OBJECTS,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
+		// there are never more batches than objects
+		frame.countBuffer = engine->createBuffer(sizeof(uint32_t) * MAX_OBJECTS,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
+
+		VkDescriptorSetAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.pNext = nullptr;
+		allocInfo.descriptorPool = engine->_descriptorPool;
+		allocInfo.descriptorSetCount = 1;
+		allocInfo.pSetLayouts = &_cullSetLayout;
+
+		VK_CHECK(vkAllocateDescriptorSets(engine->_device, &allocInfo, &frame.cullDescriptor));
+
+		std::array<VkDescriptorBufferInfo, 4> bufferInfos{};
+		bufferInfos[0].buffer = engine->_frames[i].objectBuffer._buffer;
+		bufferInfos[0].range = sizeof(RenderObject::RenderObjectUB) * MAX_OBJECTS;
+		bufferInfos[1].buffer = frame.drawObjectBuffer._buffer;
+		bufferInfos[1].range = sizeof(GPUDrawObject) * MAX_OBJECTS;
+		bufferInfos[2].buffer = frame.commandBuffer._buffer;
+		bufferInfos[2].range = sizeof(VkDrawIndexedIndirectCommand) * MAX_OBJECTS;
+		bufferInfos[3].buffer = frame.countBuffer._buffer;
+		bufferInfos[3].range = sizeof(uint32_t) * MAX_OBJECTS;
+
+		std::array<VkWriteDescriptorSet, 4> writes{};
+		for (uint32_t binding{ 0 }; binding < writes.size(); ++binding) {
+			bufferInfos[binding].offset = 0;
+			writes[binding] = vkinit::writeDescriptorBuffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, frame.cullDescriptor, &bufferInfos[binding], binding);
+		}
+
+		vkUpdateDescriptorSets(engine->_device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+	}
+
+	engine->_mainDeletionQueue.pushFunction([=]() {
+		for (FrameResources& frame : _frames) {
+			vmaUnmapMemory(_engine->_allocator, frame.drawObjectBuffer._allocation);
+			vmaDestroyBuffer(_engine->_allocator, frame.drawObjectBuffer._buffer, frame.drawObjectBuffer._allocation);
+			vmaDestroyBuffer(_engine->_allocator, frame.commandBuffer._buffer, frame.commandBuffer._allocation);
+			vmaDestroyBuffer(_engine->_allocator, frame.countBuffer._buffer, frame.countBuffer._allocation);
+		}
+		vkDestroyPipeline(_engine->_device, _cullPipeline, nullptr);
+		vkDestroyPipelineLayout(_engine->_device, _cullPipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(_engine->_device, _cullSetLayout, nullptr);
+	});
+}
+
+void IndirectDraw::prepare(const std::vector<RenderObject>& objects, const DrawList& drawList)
+{
+	ZoneScoped;
+	_batches.clear();
+	_drawCount = 0;
+
+	GPUDrawObject* drawObjects{ (GPUDrawObject*)currentFrame().drawObjectData };
+
+	for (uint32_t objectIndex : drawList.objectIndices()) {
+		const RenderObject& object{ objects[objectIndex] };
+
+		// the draw list is sorted by pipeline and material, so a batch ends when the material changes.
+		// Skinned meshes are drawn from ComputeSkinning's buffer, so they can't share a batch with static ones
+		bool newBatch{ _batches.empty()
+			|| _batches.back().material != object.material
+			|| _batches.back().mesh->vertexFormat != object.mesh->vertexFormat };
+
+		if (newBatch) {
+			IndirectBatch batch{};
+			batch.material = object.material;
+			batch.mesh = object.mesh;
+			batch.first = _drawCount;
+			batch.count = 0;
+			_batches.push_back(batch);
+		}
+
+		const MeshBounds& bounds{ object.mesh->bounds };
+
+		GPUDrawObject& drawObject{ drawObjects[_drawCount] };
+		drawObject.sphere = glm::vec4{ bounds.origin[0], bounds.origin[1], bounds.origin[2], bounds.radius };
+		drawObject.indexCount = object.mesh->indexCount;
+		drawObject.firstIndex = object.mesh->firstIndex;
+		drawObject.vertexOffset = object.vertexOffset();
+		drawObject.batch = static_cast<uint32_t>(_batches.size() - 1);
+		drawObject.commandBase = _batches.back().first;
+		drawObject.objectIndex = objectIndex;
+
+		++_batches.back().count;
+		++_drawCount;
+	}
+
+	vmaFlushAllocation(_engine->_allocator, currentFrame().drawObjectBuffer._allocation, 0, sizeof(GPUDrawObject) * _drawCount);
+}
+
+void IndirectDraw::cull(VkCommandBuffer cmd, const glm::mat4& viewProj)
+{
+	if (_drawCount == 0) {
+		return;
+	}
+
+	const FrameResources& frame{ currentFrame() };
+
+	// culled objects leave their command zeroed, which is a draw with no instances
+	vkCmdFillBuffer(cmd, frame.commandBuffer._buffer, 0, sizeof(VkDrawIndexedIndirectCommand) * _drawCount, 0);
+	vkCmdFillBuffer(cmd, frame.countBuffer._buffer, 0, sizeof(uint32_t) * _batches.size(), 0);
+
+	VkMemoryBarrier clearBarrier{};
+	clearBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	clearBarrier.pNext = nullptr;
+	clearBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	clearBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+	vkCmdPipelineBarrier(cmd,
+		VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		0,
+		1, &clearBarrier,
+		0, nullptr,
+		0, nullptr);
+
+	Frustum frustum{ extractFrustum(viewProj, true, true) };
+
+	CullPushConstants constants{};
+	for (uint32_t i{ 0 }; i < frustum.planeCount; ++i) {
+		constants.frustumPlanes[i] = frustum.planes[i];
+	}
+	constants.drawCount = _drawCount;
+
+	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, _cullPipeline);
+	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, _cullPipelineLayout, 0, 1, &frame.cullDescriptor, 0, nullptr);
+	vkCmdPushConstants(cmd, _cullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullPushConstants), &constants);
+	vkCmdDispatch(cmd, (_drawCount + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+}
+
+void IndirectDraw::drawBatch(VkCommandBuffer cmd, uint32_t batchIdx) const
+{
+	const FrameResources& frame{ currentFrame() };
+	const IndirectBatch& batch{ _batches[batchIdx] };
+
+	VkDeviceSize commandOffset{ sizeof(VkDrawIndexedIndirectCommand) * batch.first };
+	uint32_t stride{ sizeof(VkDrawIndexedIndirectCommand) };
+
+	if (_drawIndexedIndirectCount != nullptr) {
+		_drawIndexedIndirectCount(cmd, frame.commandBuffer._buffer, commandOffset, frame.countBuffer._buffer, sizeof(uint32_t) * batchIdx, batch.count, stride);
+	} else {
+		vkCmdDrawIndexedIndirect(cmd, frame.commandBuffer._buffer, commandOffset, batch.count, stride);
+	}
+}
+
+const std::vector<IndirectBatch>& IndirectDraw::batches() const
+{
+	return _batches;
+}
+
+VkBuffer IndirectDraw::drawCommandBuffer() const
+{
+	return currentFrame().commandBuffer._buffer;
+}
+
+VkBuffer IndirectDraw::drawCountBuffer() const
+{
+	return currentFrame().countBuffer._buffer;
+}
+
+IndirectDraw::FrameResources& IndirectDraw::currentFrame()
+{
+	return _frames[_engine->_frameNumber % FRAME_OVERLAP];
+}
+
+const IndirectDraw::FrameResources& IndirectDraw::currentFrame() const
+{
+	return _frames[_engine->_frameNumber % FRAME_OVERLAP];
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include "vk_types.h"
+#include "vk_mesh.h"
+#include "draw_list.h"
+#include "glm/glm.hpp"
+
+class VulkanEngine;
+
+// Consecutive draws that share a material and vertex buffer. Each batch is one indirect draw
+struct IndirectBatch {
+	Material* material;
+	// first mesh of the batch
+	Mesh* mesh;
+	// position of the batch's first draw in the draw list, also where the batch's commands start
+	uint32_t first;
+	uint32_t count;
+};
+
+// GPU driven drawing of the main pass. A compute shader frustum culls every object against its bounding sphere
+// and writes the visible ones as compacted VkDrawIndexedIndirectCommands per batch, so the CPU records
+// one draw per batch no matter how many objects there are
+class IndirectDraw {
+public:
+	void init(VulkanEngine* engine);
+
+	// builds the batches from the sorted draw list and writes the per draw cull data for the current frame.
+	// objects are indexed by the draw list and must be in the same order as the object SSBO
+	void prepare(const std::vector<RenderObject>& objects, const DrawList& drawList);
+
+	// records the culling dispatch, must be outside of a render pass. The barrier between the dispatch
+	// and the indirect draws is left to the render graph
+	void cull(VkCommandBuffer cmd, const glm::mat4& viewProj);
+
+	// records the indirect draw of a batch, pipeline, descriptors and vertex buffer must already be bound
+	void drawBatch(VkCommandBuffer cmd, uint32_t batchIdx) const;
+
+	const std::vector<IndirectBatch>& batches() const;
+
+	// the current frame's buffers written by cull and read by drawBatch
+	VkBuffer drawCommandBuffer() const;
+
+	VkBuffer drawCountBuffer() const;
+
+private:
+	// matches DrawObject in cull.comp
+	struct GPUDrawObject {
+		glm::vec4 sphere; // xyz is the center in model space, w is the radius
+		uint32_t indexCount;
+		uint32_t firstIndex;
+		int32_t vertexOffset;
+		uint32_t batch;
+		uint32_t commandBase;
+		// index into the object SSBO
+		uint32_t objectIndex;
+		uint32_t pad[2];
+	};
+
+	struct CullPushConstants {
+		// left, right, bottom, top, near. The far plane is at infinity
+		glm::vec4 frustumPlanes[5];
+		uint32_t drawCount;
+	};
+
+	struct FrameResources {
+		AllocatedBuffer drawObjectBuffer;
+		// persistently mapped
+		void* drawObjectData;
+		AllocatedBuffer commandBuffer;
+		// one draw count per batch
+		AllocatedBuffer countBuffer;
+		VkDescriptorSet cullDescriptor;
+	};
+
+	FrameResources& currentFrame();
+
+	const FrameResources& currentFrame() const;
+
+	VulkanEngine* _engine{ nullptr };
+
+	VkDescriptorSetLayout _cullSetLayout;
+	VkPipelineLayout _cullPipelineLayout;
+	VkPipeline _cullPipeline;
+
+	// vkCmdDrawIndexedIndirectCountKHR if VK_KHR_draw_indirect_count is enabled, otherwise every batch draws
+	// its full command range and culled objects are left as zero instance draws
+	PFN_vkCmdDrawIndexedIndirectCountKHR _drawIndexedIndirectCount{ nullptr };
+
+	std::vector<FrameResources> _frames;
+	std::vector<IndirectBatch> _batches;
+	uint32_t _drawCount{ 0 };
+};
@@ -0,0 +1,106 @@
+#include "job_system.h"
+
+void JobSystem::init(uint32_t workerCount)
+{
+	for (uint32_t i{ 0 }; i < workerCount; ++i) {
+		_workers.emplace_back(&JobSystem::workerLoop, this, i + 1);
+	}
+}
+
+void JobSystem::cleanup()
+{
+	{
+		std::lock_guard<std::mutex> lock{ _mutex };
+		_stop = true;
+	}
+	_wakeCondition.notify_all();
+
+	for (std::thread& worker : _workers) {
+		worker.join();
+	}
+	_workers.clear();
+}
+
+uint32_t JobSystem::threadCount() const
+{
+	return static_cast<uint32_t>(_workers.size()) + 1;
+}
+
+void JobSystem::parallelFor(uint32_t jobCount, const Job& job)
+{
+	if (jobCount == 0) {
+		return;
+	}
+
+	// not worth waking anyone for a single job
+	if (jobCount == 1 || _workers.empty()) {
+		for (uint32_t i{ 0 }; i < jobCount; ++i) {
+			job(i, 0);
+		}
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock{ _mutex };
+		_job = &job;
+		_jobCount = jobCount;
+		_nextJob = 0;
+		_remainingJobs = jobCount;
+		++_generation;
+	}
+	_wakeCondition.notify_all();
+
+	runJobs(job, jobCount, 0);
+
+	// workers that took a job may still be running it. Also wait for woken workers to leave, so none of
+	// them can pick up a job of the next parallelFor while still holding this one's function
+	std::unique_lock<std::mutex> lock{ _mutex };
+	_doneCondition.wait(lock, [this]() { return _remainingJobs == 0 && _activeWorkers == 0; });
+	_job = nullptr;
+	_jobCount = 0;
+}
+
+void JobSystem::workerLoop(uint32_t threadIndex)
+{
+	uint64_t seenGeneration{ 0 };
+
+	while (true) {
+		const Job* job;
+		uint32_t jobCount;
+		{
+			std::unique_lock<std::mutex> lock{ _mutex };
+			_wakeCondition.wait(lock, [&]() { return _stop || _generation != seenGeneration; });
+
+			if (_stop) {
+				return;
+			}
+
+			seenGeneration = _generation;
+			// woke up after the parallelFor already finished
+			if (_job == nullptr) {
+				continue;
+			}
+
+			job = _job;
+			jobCount = _jobCount;
+			++_activeWorkers;
+		}
+
+		runJobs(*job, jobCount, threadIndex);
+
+		{
+			std::lock_guard<std::mutex> lock{ _mutex };
+			--_activeWorkers;
+		}
+		_doneCondition.notify_one();
+	}
+}
+
+void JobSystem::runJobs(const Job& job, uint32_t jobCount, uint32_t threadIndex)
+{
+	uint32_t jobIndex;
+	while ((jobIndex = _nextJob.fetch_add(1)) < jobCount) {
+		job(jobIndex, threadIndex);
+		--_remainingJobs;
+	}
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+// Fixed pool of worker threads for splitting up per frame work like command recording.
+// parallelFor blocks until every job has run. The calling thread runs jobs too, as thread index 0,
+// and workers are 1 to threadCount() - 1, so the thread index can pick per thread resources
+class JobSystem {
+public:
+	using Job = std::function<void(uint32_t jobIndex, uint32_t threadIndex)>;
+
+	void init(uint32_t workerCount);
+
+	void cleanup();
+
+	// number of threads jobs can run on, including the calling thread
+	uint32_t threadCount() const;
+
+	// run job for every index in [0, jobCount) and wait for all of them. Only call from one thread at a time
+	void parallelFor(uint32_t jobCount, const Job& job);
+
+private:
+	void workerLoop(uint32_t threadIndex);
+
+	// take jobs until there are none left
+	void runJobs(const Job& job, uint32_t jobCount, uint32_t threadIndex);
+
+	std::vector<std::thread> _workers;
+	bool _stop{ false };
+
+	std::mutex _mutex;
+	std::condition_variable _wakeCondition;
+	std::condition_variable _doneCondition;
+
+	// the current parallelFor, guarded by _mutex
+	const Job* _job{ nullptr };
+	uint32_t _jobCount{ 0 };
+	uint64_t _generation{ 0 };
+	uint32_t _activeWorkers{ 0 };
+
+	std::atomic<uint32_t> _nextJob{ 0 };
+	std::atomic<uint32_t> _remainingJobs{ 0 };
+};
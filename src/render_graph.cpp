@@ -0,0 +1,574 @@
+#include "render_graph.h"
+
+#include <algorithm>
+
+#include "vk_engine.h"
+#include "vk_initializers.h"
+
+void RenderGraph::init(VulkanEngine* engine)
+{
+	_engine = engine;
+}
+
+void RenderGraph::cleanup()
+{
+	destroyTransientImages();
+}
+
+void RenderGraph::reset()
+{
+	_resources.clear();
+	_passes.clear();
+	_finalSrcStage = 0;
+	_finalBarriers.clear();
+}
+
+RenderGraphResource RenderGraph::importImage(const std::string& name, VkImage image, VkImageView view, VkImageAspectFlags aspect, VkImageLayout initialLayout, VkPipelineStageFlags initialStage,
+	uint32_t baseLayer, uint32_t layerCount)
+{
+	Resource resource{};
+	resource.name = name;
+	resource.isImage = true;
+	resource.transient = false;
+	resource.image = image;
+	resource.view = view;
+	resource.aspect = aspect;
+	resource.baseLayer = baseLayer;
+	resource.layerCount = layerCount;
+	resource.initialLayout = initialLayout;
+	resource.initialStage = initialStage;
+	resource.finalLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+	_resources.push_back(resource);
+	return static_cast<RenderGraphResource>(_resources.size() - 1);
+}
+
+RenderGraphResource RenderGraph::importBuffer(const std::string& name, VkBuffer buffer)
+{
+	Resource resource{};
+	resource.name = name;
+	resource.isImage = false;
+	resource.transient = false;
+	resource.buffer = buffer;
+	resource.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	resource.finalLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+	_resources.push_back(resource);
+	return static_cast<RenderGraphResource>(_resources.size() - 1);
+}
+
+RenderGraphResource RenderGraph::createImage(const std::string& name, const RenderGraphImageDesc& desc)
+{
+	Resource resource{};
+	resource.name = name;
+	resource.isImage = true;
+	resource.transient = true;
+	resource.desc = desc;
+	resource.aspect = desc.aspect;
+	resource.baseLayer = 0;
+	resource.layerCount = VK_REMAINING_ARRAY_LAYERS;
+	resource.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	resource.finalLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+	_resources.push_back(resource);
+	return static_cast<RenderGraphResource>(_resources.size() - 1);
+}
+
+void RenderGraph::setOutput(RenderGraphResource resource, VkImageLayout finalLayout)
+{
+	_resources[resource].output = true;
+	_resources[resource].finalLayout = finalLayout;
+}
+
+uint32_t RenderGraph::addPass(const std::string& name, bool graphics, Record record)
+{
+	Pass pass{};
+	pass.name = name;
+	pass.graphics = graphics;
+	pass.record = std::move(record);
+
+	_passes.push_back(std::move(pass));
+	return static_cast<uint32_t>(_passes.size() - 1);
+}
+
+uint32_t RenderGraph::addGraphicsPass(const std::string& name, VkRenderPass renderPass, VkExtent2D extent, const std::vector<VkClearValue>& clearValues, VkSubpassContents contents, Record record)
+{
+	uint32_t idx{ addPass(name, true, std::move(record)) };
+
+	Pass& pass{ _passes[idx] };
+	pass.renderPass = renderPass;
+	pass.extent = extent;
+	pass.clearValues = clearValues;
+	pass.contents = contents;
+	return idx;
+}
+
+uint32_t RenderGraph::addComputePass(const std::string& name, Record record)
+{
+	return addPass(name, false, std::move(record));
+}
+
+uint32_t RenderGraph::addTransferPass(const std::string& name, Record record)
+{
+	return addPass(name, false, std::move(record));
+}
+
+void RenderGraph::use(uint32_t pass, RenderGraphResource resource, RenderGraphUsage usage)
+{
+	_passes[pass].uses.push_back(Use{ resource, usage });
+
+	if (usageInfo(usage).attachment) {
+		_passes[pass].attachments.push_back(resource);
+	}
+}
+
+RenderGraph::UsageInfo RenderGraph::usageInfo(RenderGraphUsage usage)
+{
+	switch (usage) {
+	case RenderGraphUsage::COLOR_ATTACHMENT:
+		return { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, true, true };
+	case RenderGraphUsage::DEPTH_ATTACHMENT:
+		return { VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, true, true };
+	case RenderGraphUsage::RESOLVE_ATTACHMENT:
+		return { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, true, true };
+	case RenderGraphUsage::SAMPLED:
+		return { VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, false, false };
+	case RenderGraphUsage::DEPTH_SAMPLED:
+		return { VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, false, false };
+	case RenderGraphUsage::STORAGE_READ:
+		return { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, false, false };
+	case RenderGraphUsage::FRAGMENT_STORAGE_READ:
+		return { VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, false, false };
+	case RenderGraphUsage::STORAGE_WRITE:
+		return { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED, true, false };
+	case RenderGraphUsage::INDIRECT_READ:
+		return { VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, false, false };
+	case RenderGraphUsage::VERTEX_READ:
+		return { VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, false, false };
+	case RenderGraphUsage::TRANSFER_SRC:
+		return { VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, false, false };
+	case RenderGraphUsage::TRANSFER_DST:
+		return { VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, true, false };
+	}
+	return {};
+}
+
+void RenderGraph::compile()
+{
+	ZoneScoped;
+
+	cullPasses();
+
+	if (!transientImagesMatch()) {
+		// the images may still be in use by the frame in flight
+		vkDeviceWaitIdle(_engine->_device);
+		destroyTransientImages();
+		createTransientImages();
+	}
+
+	std::vector<RenderGraphResource> transients{ liveTransients() };
+	for (size_t i{ 0 }; i < transients.size(); ++i) {
+		Resource& resource{ _resources[transients[i]] };
+		resource.image = _transientImages[i].image;
+		resource.view = _transientImages[i].view;
+		resource.slot = _transientImages[i].slot;
+	}
+
+	computeBarriers();
+	createFramebuffers();
+}
+
+void RenderGraph::cullPasses()
+{
+	// walk backwards from the outputs. A pass is needed if it writes something a later needed pass reads
+	std::vector<bool> needed(_resources.size(), false);
+	for (size_t i{ 0 }; i < _resources.size(); ++i) {
+		needed[i] = _resources[i].output;
+	}
+
+	for (size_t p{ _passes.size() }; p-- > 0;) {
+		Pass& pass{ _passes[p] };
+
+		pass.culled = true;
+		for (const Use& use : pass.uses) {
+			if (usageInfo(use.usage).write && needed[use.resource]) {
+				pass.culled = false;
+			}
+		}
+
+		if (!pass.culled) {
+			for (const Use& use : pass.uses) {
+				needed[use.resource] = true;
+			}
+		}
+	}
+
+	for (Resource& resource : _resources) {
+		resource.firstPass = UINT32_MAX;
+		resource.lastPass = 0;
+	}
+
+	for (uint32_t p{ 0 }; p < _passes.size(); ++p) {
+		if (_passes[p].culled) {
+			continue;
+		}
+
+		for (const Use& use : _passes[p].uses) {
+			Resource& resource{ _resources[use.resource] };
+			resource.firstPass = std::min(resource.firstPass, p);
+			resource.lastPass = std::max(resource.lastPass, p);
+		}
+	}
+}
+
+std::vector<RenderGraphResource> RenderGraph::liveTransients() const
+{
+	std::vector<RenderGraphResource> transients;
+	for (RenderGraphResource i{ 0 }; i < _resources.size(); ++i) {
+		if (_resources[i].transient && _resources[i].firstPass != UINT32_MAX) {
+			transients.push_back(i);
+		}
+	}
+
+	std::stable_sort(transients.begin(), transients.end(), [this](RenderGraphResource a, RenderGraphResource b) {
+		return _resources[a].firstPass < _resources[b].firstPass;
+	});
+	return transients;
+}
+
+bool RenderGraph::transientImagesMatch() const
+{
+	std::vector<RenderGraphResource> transients{ liveTransients() };
+	if (transients.size() != _transientImages.size()) {
+		return false;
+	}
+
+	for (size_t i{ 0 }; i < transients.size(); ++i) {
+		const Resource& resource{ _resources[transients[i]] };
+		const TransientImage& image{ _transientImages[i] };
+
+		// lifetimes decide which images can alias, so they have to match too
+		bool match{ resource.desc.format == image.desc.format
+			&& resource.desc.extent.width == image.desc.extent.width
+			&& resource.desc.extent.height == image.desc.extent.height
+			&& resource.desc.samples == image.desc.samples
+			&& resource.desc.usage == image.desc.usage
+			&& resource.desc.aspect == image.desc.aspect
+			&& resource.firstPass == image.firstPass
+			&& resource.lastPass == image.lastPass };
+
+		if (!match) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void RenderGraph::createTransientImages()
+{
+	std::vector<RenderGraphResource> transients{ liveTransients() };
+
+	std::vector<VkMemoryRequirements> slotRequirements;
+	// last pass that uses each slot's memory
+	std::vector<uint32_t> slotEnd;
+
+	for (RenderGraphResource idx : transients) {
+		const Resource& resource{ _resources[idx] };
+
+		TransientImage transient{};
+		transient.desc = resource.desc;
+		transient.firstPass = resource.firstPass;
+		transient.lastPass = resource.lastPass;
+
+		VkExtent3D extent{ resource.desc.extent.width, resource.desc.extent.height, 1 };
+		VkImageCreateInfo imageInfo{ vkinit::imageCreateInfo(resource.desc.format, resource.desc.usage, extent, 1, resource.desc.samples) };
+		VK_CHECK(vkCreateImage(_engine->_device, &imageInfo, nullptr, &transient.image));
+
+		VkMemoryRequirements requirements;
+		vkGetImageMemoryRequirements(_engine->_device, transient.image, &requirements);
+
+		// images are sorted by first use, so the first free slot with a compatible memory type is taken greedily
+		uint32_t slot{ static_cast<uint32_t>(slotRequirements.size()) };
+		for (uint32_t s{ 0 }; s < slotRequirements.size(); ++s) {
+			if (slotEnd[s] < resource.firstPass && (slotRequirements[s].memoryTypeBits & requirements.memoryTypeBits) != 0) {
+				slot = s;
+				break;
+			}
+		}
+
+		if (slot == slotRequirements.size()) {
+			slotRequirements.push_back(requirements);
+			slotEnd.push_back(resource.lastPass);
+		} else {
+			VkMemoryRequirements& slotReq{ slotRequirements[slot] };
+			slotReq.size = std::max(slotReq.size, requirements.size);
+			slotReq.alignment = std::max(slotReq.alignment, requirements.alignment);
+			slotReq.memoryTypeBits &= requirements.memoryTypeBits;
+			slotEnd[slot] = resource.lastPass;
+		}
+
+		transient.slot = slot;
+		_transientImages.push_back(transient);
+	}
+
+	VmaAllocationCreateInfo allocInfo{};
+	allocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+	allocInfo.requiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+
+	_slots.resize(slotRequirements.size());
+	for (size_t s{ 0 }; s < slotRequirements.size(); ++s) {
+		VK_CHECK(vmaAllocateMemory(_engine->_allocator, &slotRequirements[s], &allocInfo, &_slots[s].allocation, nullptr));
+		// nothing to wait on before the first frame
+		_slots[s].stage = 0;
+		_slots[s].access = 0;
+	}
+
+	for (TransientImage& transient : _transientImages) {
+		VK_CHECK(vmaBindImageMemory(_engine->_allocator, _slots[transient.slot].allocation, transient.image));
+
+		VkImageViewCreateInfo viewInfo{ vkinit::imageviewCreateInfo(transient.desc.format, transient.image, transient.desc.aspect, 1) };
+		VK_CHECK(vkCreateImageView(_engine->_device, &viewInfo, nullptr, &transient.view));
+	}
+}
+
+void RenderGraph::destroyTransientImages()
+{
+	// framebuffers may reference the images
+	for (auto& [key, framebuffer] : _framebuffers) {
+		vkDestroyFramebuffer(_engine->_device, framebuffer, nullptr);
+	}
+	_framebuffers.clear();
+
+	for (TransientImage& transient : _transientImages) {
+		vkDestroyImageView(_engine->_device, transient.view, nullptr);
+		vkDestroyImage(_engine->_device, transient.image, nullptr);
+	}
+	_transientImages.clear();
+
+	for (MemorySlot& slot : _slots) {
+		vmaFreeMemory(_engine->_allocator, slot.allocation);
+	}
+	_slots.clear();
+}
+
+void RenderGraph::invalidate()
+{
+	destroyTransientImages();
+}
+
+void RenderGraph::computeBarriers()
+{
+	for (Resource& resource : _resources) {
+		resource.layout = resource.initialLayout;
+		// the first use of an imported resource waits on its initial stage
+		resource.writeStage = resource.initialStage;
+		resource.writeAccess = 0;
+		resource.readStages = 0;
+	}
+
+	for (uint32_t p{ 0 }; p < _passes.size(); ++p) {
+		Pass& pass{ _passes[p] };
+		pass.srcStage = 0;
+		pass.dstStage = 0;
+		pass.memoryBarrier = {};
+		pass.memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		pass.imageBarriers.clear();
+
+		if (pass.culled) {
+			continue;
+		}
+
+		for (const Use& use : pass.uses) {
+			UsageInfo info{ usageInfo(use.usage) };
+			Resource& resource{ _resources[use.resource] };
+
+			// an aliased image has to wait for the last use of its memory, by the previous image or the previous frame
+			if (resource.transient && resource.firstPass == p) {
+				resource.writeStage = _slots[resource.slot].stage;
+				resource.writeAccess = _slots[resource.slot].access;
+			}
+
+			bool layoutChange{ resource.isImage && resource.layout != info.layout };
+
+			VkPipelineStageFlags srcStage;
+			bool hazard;
+			if (info.write) {
+				// write after write and write after read
+				srcStage = resource.writeStage | resource.readStages;
+				hazard = srcStage != 0;
+			} else {
+				// read after write, each stage only has to wait once
+				srcStage = resource.writeStage;
+				hazard = srcStage != 0 && (resource.readStages & info.stage) != info.stage;
+			}
+
+			if (hazard || layoutChange) {
+				pass.srcStage |= srcStage != 0 ? srcStage : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+				pass.dstStage |= info.stage;
+
+				if (resource.isImage) {
+					VkImageMemoryBarrier barrier{};
+					barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+					barrier.pNext = nullptr;
+					barrier.srcAccessMask = resource.writeAccess;
+					barrier.dstAccessMask = info.access;
+					barrier.oldLayout = resource.layout;
+					barrier.newLayout = info.layout;
+					barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+					barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+					barrier.image = resource.image;
+					barrier.subresourceRange.aspectMask = resource.aspect;
+					barrier.subresourceRange.baseMipLevel = 0;
+					barrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+					barrier.subresourceRange.baseArrayLayer = resource.baseLayer;
+					barrier.subresourceRange.layerCount = resource.layerCount;
+					pass.imageBarriers.push_back(barrier);
+				} else {
+					pass.memoryBarrier.srcAccessMask |= resource.writeAccess;
+					pass.memoryBarrier.dstAccessMask |= info.access;
+				}
+			}
+
+			if (info.write) {
+				resource.writeStage = info.stage;
+				resource.writeAccess = info.access;
+				resource.readStages = 0;
+			} else if (layoutChange) {
+				// the transition is a write, later readers chain on the stage that waited for it
+				resource.writeStage = info.stage;
+				resource.writeAccess = 0;
+				resource.readStages = info.stage;
+			} else {
+				resource.readStages |= info.stage;
+			}
+
+			if (resource.isImage) {
+				resource.layout = info.layout;
+			}
+
+			if (resource.transient) {
+				_slots[resource.slot].stage = info.stage;
+				_slots[resource.slot].access = info.write ? info.access : 0;
+			}
+		}
+	}
+
+	for (Resource& resource : _resources) {
+		if (!resource.output || resource.finalLayout == VK_IMAGE_LAYOUT_UNDEFINED || resource.layout == resource.finalLayout) {
+			continue;
+		}
+
+		VkImageMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.pNext = nullptr;
+		barrier.srcAccessMask = resource.writeAccess;
+		barrier.dstAccessMask = 0;
+		barrier.oldLayout = resource.layout;
+		barrier.newLayout = resource.finalLayout;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = resource.image;
+		barrier.subresourceRange.aspectMask = resource.aspect;
+		barrier.subresourceRange.baseMipLevel = 0;
+		barrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+		barrier.subresourceRange.baseArrayLayer = resource.baseLayer;
+		barrier.subresourceRange.layerCount = resource.layerCount;
+		_finalBarriers.push_back(barrier);
+
+		VkPipelineStageFlags srcStage{ resource.writeStage | resource.readStages };
+		_finalSrcStage |= srcStage != 0 ? srcStage : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+	}
+}
+
+void RenderGraph::createFramebuffers()
+{
+	for (Pass& pass : _passes) {
+		pass.framebuffer = VK_NULL_HANDLE;
+		if (pass.culled || !pass.graphics) {
+			continue;
+		}
+
+		std::vector<VkImageView> views;
+		std::vector<uint64_t> key{ (uint64_t)pass.renderPass, pass.extent.width, pass.extent.height };
+		for (RenderGraphResource attachment : pass.attachments) {
+			views.push_back(_resources[attachment].view);
+			key.push_back((uint64_t)_resources[attachment].view);
+		}
+
+		auto it{ _framebuffers.find(key) };
+		if (it != _framebuffers.end()) {
+			pass.framebuffer = it->second;
+			continue;
+		}
+
+		VkFramebufferCreateInfo framebufferInfo{};
+		framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+		framebufferInfo.pNext = nullptr;
+		framebufferInfo.renderPass = pass.renderPass;
+		framebufferInfo.attachmentCount = static_cast<uint32_t>(views.size());
+		framebufferInfo.pAttachments = views.data();
+		framebufferInfo.width = pass.extent.width;
+		framebufferInfo.height = pass.extent.height;
+		framebufferInfo.layers = 1;
+
+		VK_CHECK(vkCreateFramebuffer(_engine->_device, &framebufferInfo, nullptr, &pass.framebuffer));
+		_framebuffers[key] = pass.framebuffer;
+	}
+}
+
+VkFramebuffer RenderGraph::framebuffer(uint32_t pass) const
+{
+	return _passes[pass].framebuffer;
+}
+
+void RenderGraph::execute(VkCommandBuffer cmd)
+{
+	ZoneScoped;
+	TracyVkCtx tracyContext{ _engine->_frames[_engine->_frameNumber % FRAME_OVERLAP].tracyContext };
+
+	for (Pass& pass : _passes) {
+		if (pass.culled) {
+			continue;
+		}
+
+		// timestamps can't be written inside a render pass that executes secondaries, so the zone wraps the whole pass
+		TracyVkZoneTransient(tracyContext, passZone, cmd, pass.name.c_str(), true);
+
+		if (pass.srcStage != 0) {
+			uint32_t memoryBarrierCount{ (pass.memoryBarrier.srcAccessMask | pass.memoryBarrier.dstAccessMask) != 0 ? 1u : 0u };
+			vkCmdPipelineBarrier(cmd,
+				pass.srcStage, pass.dstStage,
+				0,
+				memoryBarrierCount, &pass.memoryBarrier,
+				0, nullptr,
+				static_cast<uint32_t>(pass.imageBarriers.size()), pass.imageBarriers.data());
+		}
+
+		if (pass.graphics) {
+			VkRenderPassBeginInfo beginInfo{};
+			beginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+			beginInfo.pNext = nullptr;
+			beginInfo.renderPass = pass.renderPass;
+			beginInfo.framebuffer = pass.framebuffer;
+			beginInfo.renderArea.offset = { 0, 0 };
+			beginInfo.renderArea.extent = pass.extent;
+			beginInfo.clearValueCount = static_cast<uint32_t>(pass.clearValues.size());
+			beginInfo.pClearValues = pass.clearValues.data();
+
+			vkCmdBeginRenderPass(cmd, &beginInfo, pass.contents);
+			pass.record(cmd);
+			vkCmdEndRenderPass(cmd);
+		} else {
+			pass.record(cmd);
+		}
+	}
+
+	if (!_finalBarriers.empty()) {
+		vkCmdPipelineBarrier(cmd,
+			_finalSrcStage, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+			0,
+			0, nullptr,
+			0, nullptr,
+			static_cast<uint32_t>(_finalBarriers.size()), _finalBarriers.data());
+	}
+}
@@ -0,0 +1,222 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <map>
+#include <functional>
+#include <cstdint>
+
+#include "vk_types.h"
+#include "vk_mem_alloc.h"
+
+class VulkanEngine;
+
+// index of a resource declared in the current frame's graph
+using RenderGraphResource = uint32_t;
+
+// how a pass accesses a resource. Decides the stage, access mask and image layout the graph syncs to
+enum class RenderGraphUsage {
+	COLOR_ATTACHMENT,
+	DEPTH_ATTACHMENT,
+	// multisampled color is resolved into this attachment at the end of the subpass
+	RESOLVE_ATTACHMENT,
+	// sampled in a fragment shader
+	SAMPLED,
+	// depth image sampled in a fragment shader, like the shadow map
+	DEPTH_SAMPLED,
+	// storage buffer read by a compute shader
+	STORAGE_READ,
+	// storage buffer read by a fragment shader
+	FRAGMENT_STORAGE_READ,
+	// storage buffer written by a compute shader, or cleared with a transfer before the dispatch
+	STORAGE_WRITE,
+	// read by indirect draws
+	INDIRECT_READ,
+	// vertex buffer written by a compute shader earlier in the frame
+	VERTEX_READ,
+	// source of a copy
+	TRANSFER_SRC,
+	// destination of a copy
+	TRANSFER_DST,
+};
+
+struct RenderGraphImageDesc {
+	VkFormat format;
+	VkExtent2D extent;
+	VkSampleCountFlagBits samples{ VK_SAMPLE_COUNT_1_BIT };
+	VkImageUsageFlags usage;
+	VkImageAspectFlags aspect;
+};
+
+// Schedules the passes of a frame from the resources they declare. Passes are declared every frame in
+// execution order, with the resources they read and write. compile() then
+//   - culls passes that don't contribute to an output,
+//   - computes the barriers and layout transitions between passes, batched into one vkCmdPipelineBarrier per pass,
+//   - creates the transient images, aliasing the memory of images whose lifetimes don't overlap,
+//   - and creates the framebuffers of graphics passes.
+// Render passes are still made by whoever builds the pipelines, but they must keep every attachment in its
+// subpass layout (initialLayout == finalLayout) and have no external dependencies, the graph does that sync.
+// Transient images and framebuffers are kept between frames and only rebuilt when the declared images change
+class RenderGraph {
+public:
+	// records a pass. Graphics passes are recorded inside their render pass
+	using Record = std::function<void(VkCommandBuffer cmd)>;
+
+	void init(VulkanEngine* engine);
+
+	void cleanup();
+
+	// start declaring a new frame
+	void reset();
+
+	// an image the graph doesn't own. Its contents are kept if initialLayout isn't UNDEFINED, and the first
+	// pass using it waits on initialStage, e.g. the stage the swapchain acquire semaphore is waited at.
+	// Layers of one image can be imported as separate resources, so passes can render to them one at a time
+	RenderGraphResource importImage(const std::string& name, VkImage image, VkImageView view, VkImageAspectFlags aspect, VkImageLayout initialLayout, VkPipelineStageFlags initialStage,
+		uint32_t baseLayer = 0, uint32_t layerCount = VK_REMAINING_ARRAY_LAYERS);
+
+	// a buffer the graph doesn't own. Nothing from earlier frames is synced, per frame buffers are fenced
+	RenderGraphResource importBuffer(const std::string& name, VkBuffer buffer);
+
+	// an image owned by the graph that only lives during the frame. Its contents are undefined at its first use
+	RenderGraphResource createImage(const std::string& name, const RenderGraphImageDesc& desc);
+
+	// passes that don't lead to an output are culled. The image is transitioned to finalLayout after the last pass
+	void setOutput(RenderGraphResource resource, VkImageLayout finalLayout = VK_IMAGE_LAYOUT_UNDEFINED);
+
+	uint32_t addGraphicsPass(const std::string& name, VkRenderPass renderPass, VkExtent2D extent, const std::vector<VkClearValue>& clearValues, VkSubpassContents contents, Record record);
+
+	uint32_t addComputePass(const std::string& name, Record record);
+
+	uint32_t addTransferPass(const std::string& name, Record record);
+
+	// declare that pass accesses resource. Attachments are put in the framebuffer in the order they are used
+	void use(uint32_t pass, RenderGraphResource resource, RenderGraphUsage usage);
+
+	void compile();
+
+	// the framebuffer of a compiled graphics pass, VK_NULL_HANDLE if the pass was culled
+	VkFramebuffer framebuffer(uint32_t pass) const;
+
+	void execute(VkCommandBuffer cmd);
+
+	// destroy the transient images and framebuffers, for when the images they were made from go away
+	// (window resize). The GPU must be idle
+	void invalidate();
+
+private:
+	struct UsageInfo {
+		VkPipelineStageFlags stage;
+		VkAccessFlags access;
+		VkImageLayout layout;
+		bool write;
+		bool attachment;
+	};
+
+	struct Resource {
+		std::string name;
+		bool isImage;
+		bool transient;
+		RenderGraphImageDesc desc;
+		VkImage image;
+		VkImageView view;
+		VkImageAspectFlags aspect;
+		uint32_t baseLayer;
+		uint32_t layerCount;
+		VkBuffer buffer;
+		VkImageLayout initialLayout;
+		VkPipelineStageFlags initialStage;
+		bool output;
+		VkImageLayout finalLayout;
+
+		// passes of the compiled graph that first and last use the resource
+		uint32_t firstPass;
+		uint32_t lastPass;
+		// memory slot of transient images
+		uint32_t slot;
+
+		// sync state while the barriers are computed
+		VkImageLayout layout;
+		VkPipelineStageFlags writeStage;
+		VkAccessFlags writeAccess;
+		// stages that read since the last write, they already wait on it
+		VkPipelineStageFlags readStages;
+	};
+
+	struct Use {
+		RenderGraphResource resource;
+		RenderGraphUsage usage;
+	};
+
+	struct Pass {
+		std::string name;
+		bool graphics;
+		VkRenderPass renderPass;
+		VkExtent2D extent;
+		std::vector<VkClearValue> clearValues;
+		VkSubpassContents contents;
+		Record record;
+		std::vector<Use> uses;
+		std::vector<RenderGraphResource> attachments;
+
+		bool culled;
+		VkFramebuffer framebuffer;
+		VkPipelineStageFlags srcStage;
+		VkPipelineStageFlags dstStage;
+		VkMemoryBarrier memoryBarrier;
+		std::vector<VkImageMemoryBarrier> imageBarriers;
+	};
+
+	// transient images of one desc and lifetime, kept between frames
+	struct TransientImage {
+		RenderGraphImageDesc desc;
+		uint32_t firstPass;
+		uint32_t lastPass;
+		VkImage image;
+		VkImageView view;
+		uint32_t slot;
+	};
+
+	// memory shared by transient images that are never alive at the same time
+	struct MemorySlot {
+		VmaAllocation allocation;
+		// last access to the slot's memory, the next frame's first use waits on it
+		VkPipelineStageFlags stage;
+		VkAccessFlags access;
+	};
+
+	static UsageInfo usageInfo(RenderGraphUsage usage);
+
+	uint32_t addPass(const std::string& name, bool graphics, Record record);
+
+	// also finds the first and last pass of every resource
+	void cullPasses();
+
+	// transient images used by the compiled graph, ordered by their first pass
+	std::vector<RenderGraphResource> liveTransients() const;
+
+	// returns false if the images made last time don't match the declared ones
+	bool transientImagesMatch() const;
+
+	void createTransientImages();
+
+	void destroyTransientImages();
+
+	void computeBarriers();
+
+	void createFramebuffers();
+
+	VulkanEngine* _engine{ nullptr };
+
+	std::vector<Resource> _resources;
+	std::vector<Pass> _passes;
+
+	// barriers into the outputs' final layouts, after the last pass
+	VkPipelineStageFlags _finalSrcStage{ 0 };
+	std::vector<VkImageMemoryBarrier> _finalBarriers;
+
+	std::vector<TransientImage> _transientImages;
+	std::vector<MemorySlot> _slots;
+	// keyed by render pass, extent and attachment views
+	std::map<std::vector<uint64_t>, VkFramebuffer> _framebuffers;
+};
@@ -0,0 +1,130 @@
+#include "render_objects.h"
+
+bool RenderObjectHandle::valid() const
+{
+	return id != INVALID_ID;
+}
+
+void RenderObjectStore::init(uint32_t framesInFlight)
+{
+	_framesInFlight = framesInFlight;
+}
+
+RenderObjectHandle RenderObjectStore::create(const RenderObject& object)
+{
+	uint32_t id;
+	if (_freeIds.empty()) {
+		id = static_cast<uint32_t>(_slots.size());
+		_slots.push_back(Slot{ 0, 0 });
+	} else {
+		id = _freeIds.back();
+		_freeIds.pop_back();
+	}
+
+	if (object.isStatic) {
+		++_staticVersion;
+	}
+
+	_slots[id].dense = static_cast<uint32_t>(_objects.size());
+	_objects.push_back(object);
+	_denseToId.push_back(id);
+	_dirtyFrames.push_back(0);
+	markDirty(_slots[id].dense);
+
+	RenderObjectHandle handle{};
+	handle.id = id;
+	handle.generation = _slots[id].generation;
+	return handle;
+}
+
+void RenderObjectStore::destroy(RenderObjectHandle handle)
+{
+	if (get(handle) == nullptr) {
+		return;
+	}
+
+	// swap the last object into the hole so the store stays packed
+	uint32_t dense{ _slots[handle.id].dense };
+	uint32_t last{ static_cast<uint32_t>(_objects.size() - 1) };
+	if (_objects[dense].isStatic) {
+		++_staticVersion;
+	}
+	if (dense != last) {
+		_objects[dense] = _objects[last];
+		_denseToId[dense] = _denseToId[last];
+		_slots[_denseToId[dense]].dense = dense;
+		// its SSBO index changed
+		markDirty(dense);
+	}
+	_objects.pop_back();
+	_denseToId.pop_back();
+	_dirtyFrames.pop_back();
+
+	// old handles to this id no longer match
+	++_slots[handle.id].generation;
+	_freeIds.push_back(handle.id);
+}
+
+RenderObject* RenderObjectStore::get(RenderObjectHandle handle)
+{
+	if (!handle.valid() || handle.id >= _slots.size()) {
+		return nullptr;
+	}
+
+	const Slot& slot{ _slots[handle.id] };
+	if (slot.generation != handle.generation) {
+		return nullptr;
+	}
+	return &_objects[slot.dense];
+}
+
+void RenderObjectStore::setTransform(RenderObjectHandle handle, const glm::mat4& transform)
+{
+	RenderObject* object{ get(handle) };
+	if (object == nullptr) {
+		return;
+	}
+
+	object->uniformBlock.transformMatrix = transform;
+	markDirty(_slots[handle.id].dense);
+
+	if (object->isStatic) {
+		++_staticVersion;
+	}
+}
+
+void RenderObjectStore::collectDirty(std::vector<uint32_t>& outIndices)
+{
+	outIndices.clear();
+	for (uint32_t dense{ 0 }; dense < _dirtyFrames.size(); ++dense) {
+		if (_dirtyFrames[dense] > 0) {
+			outIndices.push_back(dense);
+			--_dirtyFrames[dense];
+		}
+	}
+}
+
+void RenderObjectStore::markDirty(uint32_t dense)
+{
+	_dirtyFrames[dense] = static_cast<uint8_t>(_framesInFlight);
+}
+
+std::vector<RenderObject>& RenderObjectStore::objects()
+{
+	return _objects;
+}
+
+const std::vector<RenderObject>& RenderObjectStore::objects() const
+{
+	return _objects;
+}
+
+uint32_t RenderObjectStore::size() const
+{
+	return static_cast<uint32_t>(_objects.size());
+}
+
+uint64_t RenderObjectStore::staticVersion() const
+{
+	return _staticVersion;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include "vk_mesh.h"
+
+// refers to a render object for as long as it lives, unlike a pointer or index into the store
+struct RenderObjectHandle {
+	static constexpr uint32_t INVALID_ID{ UINT32_MAX };
+
+	uint32_t id{ INVALID_ID };
+	uint32_t generation{ 0 };
+
+	bool valid() const;
+};
+
+// Render objects packed contiguously so they can be iterated without chasing pointers.
+// The dense index of an object is its index in the object SSBO. Destroying an object moves the last one
+// into its place, so dense indices are only stable until the next destroy, handles are always stable.
+// Objects are dirty tracked per frame in flight, so each frame's SSBO only gets the objects that changed
+class RenderObjectStore {
+public:
+	// framesInFlight is the number of object SSBOs a change has to reach
+	void init(uint32_t framesInFlight);
+
+	RenderObjectHandle create(const RenderObject& object);
+
+	// does nothing if the handle was already destroyed
+	void destroy(RenderObjectHandle handle);
+
+	// nullptr if the handle was destroyed. Use setTransform to move the object, so the change gets uploaded
+	RenderObject* get(RenderObjectHandle handle);
+
+	void setTransform(RenderObjectHandle handle, const glm::mat4& transform);
+
+	// dense indices, in ascending order, of the objects the current frame's SSBO doesn't have yet.
+	// Call once per frame, each call counts as those objects being written to one more frame's SSBO
+	void collectDirty(std::vector<uint32_t>& outIndices);
+
+	std::vector<RenderObject>& objects();
+
+	const std::vector<RenderObject>& objects() const;
+
+	uint32_t size() const;
+
+	// changes whenever a static object is created, destroyed or moved
+	uint64_t staticVersion() const;
+
+private:
+	struct Slot {
+		uint32_t dense;
+		uint32_t generation;
+	};
+
+	void markDirty(uint32_t dense);
+
+	std::vector<RenderObject> _objects;
+	// handle id of each dense object, to fix up its slot when it's moved
+	std::vector<uint32_t> _denseToId;
+	// number of frames in flight whose SSBO is still out of date, per dense object
+	std::vector<uint8_t> _dirtyFrames;
+	uint32_t _framesInFlight{ 1 };
+	std::vector<Slot> _slots;
+	std::vector<uint32_t> _freeIds;
+	uint64_t _staticVersion{ 0 };
+};
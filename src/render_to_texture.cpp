@@ -420,19 +420,20 @@ Texture renderToTexture(VulkanEngine& engine, VkDescriptorSet equirectangularSet
 
 // Shadow mapping -----------------------------------------------------------------------------
 
-void prepareShadowMapRenderpass(VulkanEngine& engine, VkRenderPass* renderpass)
+void prepareShadowMapRenderpass(VulkanEngine& engine, VkAttachmentLoadOp loadOp, VkRenderPass* renderpass)
 {
 	VkAttachmentDescription attachmentDescription{};
 	attachmentDescription.format = DEPTH_FORMAT;
 	attachmentDescription.samples = VK_SAMPLE_COUNT_1_BIT;
-	attachmentDescription.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	// Load keeps the cached static depth that was copied in
+	attachmentDescription.loadOp = loadOp;
 	// We will read from depth, so it's important to store the depth attachment results
 	attachmentDescription.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
 	attachmentDescription.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 	attachmentDescription.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-	attachmentDescription.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	// Attachment will be transitioned to shader read at render pass end
-	attachmentDescription.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+	// The render graph transitions the attachment into and out of its subpass layout
+	attachmentDescription.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+	attachmentDescription.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 
 	VkAttachmentReference depthReference{};
 	depthReference.attachment = 0;
@@ -444,23 +445,6 @@ void prepareShadowMapRenderpass(VulkanEngine& engine, VkRenderPass* renderpass)
 	subpass.colorAttachmentCount = 0;
 	subpass.pDepthStencilAttachment = &depthReference;
 
-	// Use subpass dependencies for layout transitions
-	std::array<VkSubpassDependency, 2> dependencies{};
-
-	dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
-	dependencies[0].dstSubpass = 0;
-	dependencies[0].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-	dependencies[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
-	dependencies[0].dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
-	dependencies[0].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
-
-	dependencies[1].srcSubpass = 0;
-	dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
-	dependencies[1].srcStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
-	dependencies[1].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-	dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-	dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
 	VkRenderPassCreateInfo renderPassCreateInfo{};
 	renderPassCreateInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
 	renderPassCreateInfo.pNext = nullptr;
@@ -468,8 +452,9 @@ void prepareShadowMapRenderpass(VulkanEngine& engine, VkRenderPass* renderpass)
 	renderPassCreateInfo.pAttachments = &attachmentDescription;
 	renderPassCreateInfo.subpassCount = 1;
 	renderPassCreateInfo.pSubpasses = &subpass;
-	renderPassCreateInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
-	renderPassCreateInfo.pDependencies = dependencies.data();
+	// Sampling the shadow map in the main pass is synced by the render graph
+	renderPassCreateInfo.dependencyCount = 0;
+	renderPassCreateInfo.pDependencies = nullptr;
 
 	VK_CHECK(vkCreateRenderPass(engine._device, &renderPassCreateInfo, nullptr, renderpass));
 	engine._mainDeletionQueue.pushFunction([=, &engine]() {
@@ -477,9 +462,8 @@ void prepareShadowMapRenderpass(VulkanEngine& engine, VkRenderPass* renderpass)
 	});
 }
 
-// Setup the offscreen framebuffer for rendering the scene from light's point-of-view to
-// The depth attachment of this framebuffer will then be used to sample from in the fragment shader of the shadowing pass
-void prepareShadowMapFramebuffer(VulkanEngine& engine, const ShadowGlobalResources& shadowGlobal, ShadowFrameResources* shadowFrame)
+// Layered depth image with a layer per cascade. image->imageView views every layer, layerViews one each
+void createShadowMapImage(VulkanEngine& engine, const ShadowGlobalResources& shadowGlobal, VkImageUsageFlags usage, Texture* image, std::array<VkImageView, SHADOW_CASCADES>* layerViews)
 {
 	// For shadow mapping we only need a depth attachment
 	VkImageCreateInfo imageInfo{};
@@ -491,40 +475,60 @@ void prepareShadowMapFramebuffer(VulkanEngine& engine, const ShadowGlobalResourc
 	imageInfo.extent.height = shadowGlobal.height;
 	imageInfo.extent.depth = 1;
 	imageInfo.mipLevels = 1;
-	imageInfo.arrayLayers = 1;
+	// One layer per cascade
+	imageInfo.arrayLayers = SHADOW_CASCADES;
 	imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
 	imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
 	// Depth stencil attachment
 	imageInfo.format = DEPTH_FORMAT;
-	// We will sample directly from the depth attachment for the shadow mapping
-	imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | usage;
 
 	VmaAllocationCreateInfo allocInfo{};
 	allocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
 	allocInfo.requiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
 
-	VK_CHECK(vmaCreateImage(engine._allocator, &imageInfo, &allocInfo, &shadowFrame->depth.image._image, &shadowFrame->depth.image._allocation, nullptr));
+	VK_CHECK(vmaCreateImage(engine._allocator, &imageInfo, &allocInfo, &image->image._image, &image->image._allocation, nullptr));
 	engine._mainDeletionQueue.pushFunction([=, &engine]() {
-		vmaDestroyImage(engine._allocator, shadowFrame->depth.image._image, shadowFrame->depth.image._allocation);
+		vmaDestroyImage(engine._allocator, image->image._image, image->image._allocation);
 	});
 
 	VkImageViewCreateInfo depthStencilView{};
 	depthStencilView.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
 	depthStencilView.pNext = nullptr;
-	depthStencilView.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	// Array view of every cascade, sampled in the main pass
+	depthStencilView.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
 	depthStencilView.format = DEPTH_FORMAT;
 	depthStencilView.subresourceRange = {};
 	depthStencilView.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
 	depthStencilView.subresourceRange.baseMipLevel = 0;
 	depthStencilView.subresourceRange.levelCount = 1;
 	depthStencilView.subresourceRange.baseArrayLayer = 0;
-	depthStencilView.subresourceRange.layerCount = 1;
-	depthStencilView.image = shadowFrame->depth.image._image;
-	VK_CHECK(vkCreateImageView(engine._device, &depthStencilView, nullptr, &shadowFrame->depth.imageView));
+	depthStencilView.subresourceRange.layerCount = SHADOW_CASCADES;
+	depthStencilView.image = image->image._image;
+	VK_CHECK(vkCreateImageView(engine._device, &depthStencilView, nullptr, &image->imageView));
 	engine._mainDeletionQueue.pushFunction([=, &engine]() {
-		vkDestroyImageView(engine._device, shadowFrame->depth.imageView, nullptr);
+		vkDestroyImageView(engine._device, image->imageView, nullptr);
 	});
 
+	// A view of each layer to render a cascade into
+	depthStencilView.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	depthStencilView.subresourceRange.layerCount = 1;
+	for (uint32_t c{ 0 }; c < SHADOW_CASCADES; ++c) {
+		depthStencilView.subresourceRange.baseArrayLayer = c;
+		VK_CHECK(vkCreateImageView(engine._device, &depthStencilView, nullptr, &(*layerViews)[c]));
+		engine._mainDeletionQueue.pushFunction([=, &engine]() {
+			vkDestroyImageView(engine._device, (*layerViews)[c], nullptr);
+		});
+	}
+}
+
+// Setup the offscreen depth image for rendering the scene from light's point-of-view to, the render graph makes the framebuffer
+// The depth image will then be used to sample from in the fragment shader of the shadowing pass
+void prepareShadowMapFramebuffer(VulkanEngine& engine, const ShadowGlobalResources& shadowGlobal, ShadowFrameResources* shadowFrame)
+{
+	// We will sample directly from the depth attachment for the shadow mapping, after copying the static cache into it
+	createShadowMapImage(engine, shadowGlobal, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, &shadowFrame->depth, &shadowFrame->cascadeViews);
+
 	// Create sampler to sample from to depth attachment
 	// Used to sample in the fragment shader for shadowed rendering
 	VkFilter shadowmap_filter{ VK_FILTER_LINEAR };
@@ -542,35 +546,38 @@ void prepareShadowMapFramebuffer(VulkanEngine& engine, const ShadowGlobalResourc
 	sampler.minLod = 0.0f;
 	sampler.maxLod = 1.0f;
 	sampler.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
-	VK_CHECK(vkCreateSampler(engine._device, &sampler, nullptr, &shadowFrame->depthSampler));
+	// Compares against the fragment's depth before filtering, so linear filtering is a 2x2 PCF
+	sampler.compareEnable = VK_TRUE;
+	sampler.compareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+	VK_CHECK(vkCreateSampler(engine._device, &sampler, nullptr, &shadowFrame->compareSampler));
 	engine._mainDeletionQueue.pushFunction([=, &engine]() {
-		vkDestroySampler(engine._device, shadowFrame->depthSampler, nullptr);
+		vkDestroySampler(engine._device, shadowFrame->compareSampler, nullptr);
 	});
 
-	// Create frame buffer
-	VkFramebufferCreateInfo fbufCreateInfo{};
-	fbufCreateInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-	fbufCreateInfo.pNext = nullptr;
-	fbufCreateInfo.renderPass = shadowGlobal.renderPass;
-	fbufCreateInfo.attachmentCount = 1;
-	fbufCreateInfo.pAttachments = &shadowFrame->depth.imageView;
-	fbufCreateInfo.width = shadowGlobal.width;
-	fbufCreateInfo.height = shadowGlobal.height;
-	fbufCreateInfo.layers = 1;
-
-	VK_CHECK(vkCreateFramebuffer(engine._device, &fbufCreateInfo, nullptr, &shadowFrame->frameBuffer));
+	// Raw depth for the PCSS blocker search, filtering depths together would make up blockers
+	sampler.magFilter = VK_FILTER_NEAREST;
+	sampler.minFilter = VK_FILTER_NEAREST;
+	sampler.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	sampler.compareEnable = VK_FALSE;
+	VK_CHECK(vkCreateSampler(engine._device, &sampler, nullptr, &shadowFrame->depthSampler));
 	engine._mainDeletionQueue.pushFunction([=, &engine]() {
-		vkDestroyFramebuffer(engine._device, shadowFrame->frameBuffer, nullptr);
+		vkDestroySampler(engine._device, shadowFrame->depthSampler, nullptr);
 	});
 }
 
-void setupShadowDescriptorSetLayoutsInternal(VulkanEngine& engine, std::vector<VkDescriptorSetLayout>& setLayoutsOut, VkPipelineLayout* pipelineLayout, bool isSkinned)
+// Depth of the static casters, copied into every frame's shadow map
+void prepareShadowCache(VulkanEngine& engine, ShadowGlobalResources* shadowGlobal)
+{
+	createShadowMapImage(engine, *shadowGlobal, VK_IMAGE_USAGE_TRANSFER_SRC_BIT, &shadowGlobal->staticCache, &shadowGlobal->staticCacheViews);
+}
+
+void setupShadowDescriptorSetLayouts(VulkanEngine& engine, std::vector<VkDescriptorSetLayout>& setLayoutsOut, VkPipelineLayout* pipelineLayout)
 {
 	// GLSL:
 	//layout(set = 0, binding = 0) uniform LightBuffer {
 	//	mat4 lightSpaceMatrix;
 	//} lightData;
-	VkDescriptorSetLayoutBinding lightBinding{ vkinit::descriptorsetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 0) };
+	VkDescriptorSetLayoutBinding lightBinding{ vkinit::descriptorsetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_VERTEX_BIT, 0) };
 
 	VkDescriptorSetLayoutCreateInfo lightSetInfo{};
 	lightSetInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
@@ -604,28 +611,6 @@ void setupShadowDescriptorSetLayoutsInternal(VulkanEngine& engine, std::vector<V
 		vkDestroyDescriptorSetLayout(engine._device, setLayoutsOut[1], nullptr);
 	});
 
-	if (isSkinned) {
-		// GLSL:
-		//layout(set = 2, binding = 0) uniform JointMatrices {
-		//	mat4 jointMatrices[MAX_NUM_JOINTS];
-		//	float jointCount;
-		//} skel;
-		VkDescriptorSetLayoutBinding skinBinding{ vkinit::descriptorsetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 0) };
-
-		VkDescriptorSetLayoutCreateInfo skinSetInfo{};
-		skinSetInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-		skinSetInfo.pNext = nullptr;
-		skinSetInfo.flags = 0;
-		skinSetInfo.bindingCount = 1;
-		skinSetInfo.pBindings = &skinBinding;
-
-		setLayoutsOut.emplace_back();
-		vkCreateDescriptorSetLayout(engine._device, &skinSetInfo, nullptr, &setLayoutsOut[2]);
-		engine._mainDeletionQueue.pushFunction([=, &engine]() {
-			vkDestroyDescriptorSetLayout(engine._device, setLayoutsOut[2], nullptr);
-		});
-	}
-
 	//VkPipelineLayoutCreateInfo pPipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
 	VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo{};
 	pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
@@ -640,39 +625,6 @@ void setupShadowDescriptorSetLayoutsInternal(VulkanEngine& engine, std::vector<V
 	});
 }
 
-void setupShadowDescriptorSetLayouts(VulkanEngine& engine, std::vector<VkDescriptorSetLayout>& setLayoutsOut, VkPipelineLayout* pipelineLayout)
-{
-	setupShadowDescriptorSetLayoutsInternal(engine, setLayoutsOut, pipelineLayout, false);
-}
-
-void setupShadowDescriptorSetLayoutsSkinned(VulkanEngine& engine, std::vector<VkDescriptorSetLayout>& setLayoutsOut, VkPipelineLayout* pipelineLayout)
-{
-	setupShadowDescriptorSetLayoutsInternal(engine, setLayoutsOut, pipelineLayout, true);
-}
-
-void setupShadowDescriptorSetsSkinned(VulkanEngine& engine, VkBuffer& skinBuffer, VkDescriptorSetLayout setLayout, VkDescriptorSet& descriptorSet)
-{
-	VkDescriptorSetAllocateInfo allocInfoSkin{};
-	allocInfoSkin.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-	allocInfoSkin.descriptorPool = engine._descriptorPool;
-	allocInfoSkin.descriptorSetCount = 1;
-	allocInfoSkin.pSetLayouts = &setLayout;
-
-	VK_CHECK(vkAllocateDescriptorSets(engine._device, &allocInfoSkin, &descriptorSet));
-
-	VkDescriptorBufferInfo skinInfo{};
-	skinInfo.offset = 0;
-	skinInfo.range = VK_WHOLE_SIZE;
-	skinInfo.buffer = skinBuffer;
-
-	std::vector<VkWriteDescriptorSet> writeDescriptorSets{
-		// Set 2, Binding 0 : Skin uniform buffer
-		vkinit::writeDescriptorBuffer(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, descriptorSet, &skinInfo, 0)
-	};
-
-	vkUpdateDescriptorSets(engine._device, writeDescriptorSets.size(), writeDescriptorSets.data(), 0, nullptr);
-}
-
 void setupShadowDescriptorSetsGlobal(VulkanEngine& engine, ShadowFrameResources& shadowFrame, VkBuffer& objectBuffer, std::vector<VkDescriptorSetLayout>& setLayouts)
 {
 	VkDescriptorSetAllocateInfo allocInfoLight{};
@@ -690,10 +642,11 @@ void setupShadowDescriptorSetsGlobal(VulkanEngine& engine, ShadowFrameResources&
 	VK_CHECK(vkAllocateDescriptorSets(engine._device, &allocInfoLight, &shadowFrame.shadowDescriptorSetLight));
 	VK_CHECK(vkAllocateDescriptorSets(engine._device, &allocInfoObjects, &shadowFrame.shadowDescriptorSetObjects));
 
+	// the light matrix is written to the frame allocator every frame and bound with a dynamic offset
 	VkDescriptorBufferInfo lightInfo{};
 	lightInfo.offset = 0;
-	lightInfo.range = VK_WHOLE_SIZE;
-	lightInfo.buffer = shadowFrame.shadowLightBuffer._buffer;
+	lightInfo.range = sizeof(glm::mat4);
+	lightInfo.buffer = engine._frameAllocator.buffer();
 
 	// notice we're reusing buffers here
 	VkDescriptorBufferInfo objectInfo{};
@@ -703,7 +656,7 @@ void setupShadowDescriptorSetsGlobal(VulkanEngine& engine, ShadowFrameResources&
 
 	std::vector<VkWriteDescriptorSet> writeDescriptorSets{
 		// Set 0, Binding 0 : Vertex shader uniform buffer (LightBuffer)
-		vkinit::writeDescriptorBuffer(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, shadowFrame.shadowDescriptorSetLight, &lightInfo, 0),
+		vkinit::writeDescriptorBuffer(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, shadowFrame.shadowDescriptorSetLight, &lightInfo, 0),
 		// Set 1, Binding 0 : Object SSBO
 		vkinit::writeDescriptorBuffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, shadowFrame.shadowDescriptorSetObjects, &objectInfo, 0),
 	};
@@ -712,7 +665,7 @@ void setupShadowDescriptorSetsGlobal(VulkanEngine& engine, ShadowFrameResources&
 }
 
 
-void initShadowPipelineInternal(VulkanEngine& engine, VkRenderPass& renderpass, VkPipelineLayout pipelineLayout, VkPipeline* pipeline, bool isSkinned)
+void initShadowPipeline(VulkanEngine& engine, VkRenderPass& renderpass, VkPipelineLayout pipelineLayout, VkPipeline* pipeline)
 {
 	VkPipelineInputAssemblyStateCreateInfo inputAssemblyStateCI{ vkinit::inputAssemblyCreateInfo(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST) };
 
@@ -747,7 +700,7 @@ void initShadowPipelineInternal(VulkanEngine& engine, VkRenderPass& renderpass,
 	std::vector<VkDynamicState> dynamicStateEnables = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR, VK_DYNAMIC_STATE_DEPTH_BIAS };
 
 	std::string prefix{ "../../shaders/spirv/" };
-	std::string vertPath{ prefix + (isSkinned ? "skinned_depth.vert.spv" : "depth.vert.spv") };
+	std::string vertPath{ prefix + "depth.vert.spv" };
 	VkShaderModule vertShader;
 	if (!engine.loadShaderModule(vertPath, &vertShader)) {
 		std::cout << "Error when building vertex shader module: " << vertPath << "\n";
@@ -757,14 +710,8 @@ void initShadowPipelineInternal(VulkanEngine& engine, VkRenderPass& renderpass,
 	// vertex input controls how to read vertices from vertex buffers
 	VkPipelineVertexInputStateCreateInfo vertexInputInfo{ vkinit::vertexInputStateCreateInfo() };
 
-	VertexInputDescription vertexDescription{};
-	if (isSkinned) {
-		uint32_t stride{ sizeof(VertexSkinned) };
-		vertexDescription = getVertexDescription(ATTR_POSITION | ATTR_JOINT_INDICES | ATTR_JOINT_WEIGHTS, stride);
-	} else {
-		uint32_t stride{ sizeof(Vertex) };
-		vertexDescription = getVertexDescription(ATTR_POSITION, stride);
-	}
+	uint32_t stride{ sizeof(Vertex) };
+	VertexInputDescription vertexDescription{ getVertexDescription(ATTR_POSITION, stride) };
 
 	vertexInputInfo.vertexAttributeDescriptionCount = vertexDescription.attributes.size();
 	vertexInputInfo.pVertexAttributeDescriptions = vertexDescription.attributes.data();
@@ -807,13 +754,3 @@ void initShadowPipelineInternal(VulkanEngine& engine, VkRenderPass& renderpass,
 
 	vkDestroyShaderModule(engine._device, vertShader, nullptr);
 }
-
-void initShadowPipeline(VulkanEngine& engine, VkRenderPass& renderpass, VkPipelineLayout pipelineLayout, VkPipeline* pipeline)
-{
-	initShadowPipelineInternal(engine, renderpass, pipelineLayout, pipeline, false);
-}
-
-void initShadowPipelineSkinned(VulkanEngine& engine, VkRenderPass& renderpass, VkPipelineLayout pipelineLayout, VkPipeline* pipeline)
-{
-	initShadowPipelineInternal(engine, renderpass, pipelineLayout, pipeline, true);
-}
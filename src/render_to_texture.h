@@ -8,16 +8,12 @@ Texture renderToTexture(VulkanEngine& engine, VkDescriptorSet equirectangularSet
 
 void prepareShadowMapFramebuffer(VulkanEngine& engine, const ShadowGlobalResources& shadowGlobal, ShadowFrameResources* shadowFrame);
 
-void prepareShadowMapRenderpass(VulkanEngine& engine, VkRenderPass* renderpass);
+void prepareShadowCache(VulkanEngine& engine, ShadowGlobalResources* shadowGlobal);
 
-void initShadowPipeline(VulkanEngine& engine, VkRenderPass& renderpass, VkPipelineLayout pipelineLayout, VkPipeline* pipeline);
+void prepareShadowMapRenderpass(VulkanEngine& engine, VkAttachmentLoadOp loadOp, VkRenderPass* renderpass);
 
-void initShadowPipelineSkinned(VulkanEngine& engine, VkRenderPass& renderpass, VkPipelineLayout pipelineLayout, VkPipeline* pipeline);
+void initShadowPipeline(VulkanEngine& engine, VkRenderPass& renderpass, VkPipelineLayout pipelineLayout, VkPipeline* pipeline);
 
 void setupShadowDescriptorSetLayouts(VulkanEngine& engine, std::vector<VkDescriptorSetLayout>& setLayoutsOut, VkPipelineLayout* pipelineLayout);
 
-void setupShadowDescriptorSetLayoutsSkinned(VulkanEngine& engine, std::vector<VkDescriptorSetLayout>& setLayoutsOut, VkPipelineLayout* pipelineLayout);
-
-void setupShadowDescriptorSetsSkinned(VulkanEngine& engine, VkBuffer& skinBuffer, VkDescriptorSetLayout setLayout, VkDescriptorSet& descriptorSet);
-
 void setupShadowDescriptorSetsGlobal(VulkanEngine& engine, ShadowFrameResources& shadowFrame, VkBuffer& objectBuffer, std::vector<VkDescriptorSetLayout>& setLayouts);
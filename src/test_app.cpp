@@ -15,9 +15,9 @@ void TestApp::init(VulkanEngine& engine)
 
 	_camera.pos = glm::vec3{ 0.0, 2.0, 2.0 };
 
-	_skinning.setRenderObject(engine.createRenderObject("skinning", "default_skinned"));
+	_skinning.setRenderObject(&engine, engine.createRenderObject("skinning", "default_skinned"));
 
-	_cubeObj.setRenderObject(engine.createRenderObject("cube", "default"));
+	_cubeObj.setRenderObject(&engine, engine.createRenderObject("cube", "default"));
 
 	//float halfExtent{ 1.0f };
 	//PxMaterial* material{ engine.create_physics_material(0.5, 0.5, 0.6) };
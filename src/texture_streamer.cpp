@@ -0,0 +1,615 @@
+#include "texture_streamer.h"
+
+#include <iostream>
+#include <algorithm>
+#include <iterator>
+#include <cstring>
+
+#include "vk_engine.h"
+#include "vk_initializers.h"
+#include "vk_textures.h"
+#include "asset_loader.h"
+#include "texture_asset.h"
+#include "json.hpp"
+
+void TextureStreamer::init(VulkanEngine* engine)
+{
+	_engine = engine;
+	_transferQueue = engine->_transferQueue;
+	_transferQueueFamily = engine->_transferQueueFamily;
+
+	_queueFamilies.push_back(engine->_graphicsQueueFamily);
+	if (_transferQueueFamily != engine->_graphicsQueueFamily) {
+		_queueFamilies.push_back(_transferQueueFamily);
+	}
+
+	VkSemaphoreTypeCreateInfoKHR timelineInfo{};
+	timelineInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR;
+	timelineInfo.pNext = nullptr;
+	timelineInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR;
+	timelineInfo.initialValue = 0;
+
+	VkSemaphoreCreateInfo semaphoreInfo{};
+	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	semaphoreInfo.pNext = &timelineInfo;
+	VK_CHECK(vkCreateSemaphore(engine->_device, &semaphoreInfo, nullptr, &_timeline));
+
+	// extension entry points aren't exported by the loader
+	_getSemaphoreCounterValue = (PFN_vkGetSemaphoreCounterValueKHR)vkGetDeviceProcAddr(engine->_device, "vkGetSemaphoreCounterValueKHR");
+
+	for (UploadBatch& batch : _batches) {
+		VkCommandPoolCreateInfo poolInfo{ vkinit::commandPoolCreateInfo(_transferQueueFamily, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT) };
+		VK_CHECK(vkCreateCommandPool(engine->_device, &poolInfo, nullptr, &batch.commandPool));
+
+		VkCommandBufferAllocateInfo cmdAllocInfo{ vkinit::commandBufferAllocateInfo(batch.commandPool, 1) };
+		VK_CHECK(vkAllocateCommandBuffers(engine->_device, &cmdAllocInfo, &batch.cmd));
+	}
+
+	_deferredWrites.resize(FRAME_OVERLAP);
+
+	createPlaceholder();
+
+	// decoding is mostly waiting on the disk and lz4, leave the rest of the cores for the frame loop
+	uint32_t numWorkers{ std::max(1u, std::min(4u, std::thread::hardware_concurrency() / 2)) };
+	for (uint32_t i{ 0 }; i < numWorkers; ++i) {
+		_workers.emplace_back(&TextureStreamer::workerLoop, this);
+	}
+}
+
+void TextureStreamer::cleanup()
+{
+	_stop = true;
+	_requestCondition.notify_all();
+	_stagingCondition.notify_all();
+
+	for (std::thread& worker : _workers) {
+		worker.join();
+	}
+	_workers.clear();
+
+	vkQueueWaitIdle(_transferQueue);
+
+	VmaAllocator allocator{ _engine->_allocator };
+
+	// textures that never became resident still own their image
+	for (DecodedTexture& texture : _decoded) {
+		vmaDestroyImage(allocator, texture.image._image, texture.image._allocation);
+		releaseStaging(texture.staging);
+	}
+	_decoded.clear();
+
+	for (UploadBatch& batch : _batches) {
+		for (DecodedTexture& texture : batch.textures) {
+			vmaDestroyImage(allocator, texture.image._image, texture.image._allocation);
+			releaseStaging(texture.staging);
+		}
+		batch.textures.clear();
+
+		vkDestroyCommandPool(_engine->_device, batch.commandPool, nullptr);
+	}
+
+	vkDestroySemaphore(_engine->_device, _timeline, nullptr);
+
+	for (StagingBuffer& staging : _freeStaging) {
+		vmaDestroyBuffer(allocator, staging.buffer._buffer, staging.buffer._allocation);
+	}
+	_freeStaging.clear();
+}
+
+void TextureStreamer::requestTexture(const std::string& key, const std::string& path, VkFormat format)
+{
+	_pending[key];
+
+	{
+		std::lock_guard<std::mutex> lock{ _requestMutex };
+		_requests.push_back({ key, path, format });
+	}
+	_requestCondition.notify_one();
+}
+
+void TextureStreamer::addDescriptorBinding(const std::string& key, const std::vector<VkDescriptorSet>& sets, uint32_t binding)
+{
+	auto it{ _pending.find(key) };
+	if (it != _pending.end()) {
+		it->second.push_back({ sets, binding });
+	}
+}
+
+bool TextureStreamer::isPending(const std::string& key) const
+{
+	return _pending.find(key) != _pending.end();
+}
+
+const Texture& TextureStreamer::placeholder() const
+{
+	return _placeholder;
+}
+
+void TextureStreamer::workerLoop()
+{
+	while (true) {
+		Request request;
+		{
+			std::unique_lock<std::mutex> lock{ _requestMutex };
+			_requestCondition.wait(lock, [this]() { return _stop || !_requests.empty(); });
+
+			if (_stop) {
+				return;
+			}
+
+			request = std::move(_requests.front());
+			_requests.pop_front();
+		}
+
+		DecodedTexture texture;
+		if (decodeTexture(request, texture)) {
+			std::lock_guard<std::mutex> lock{ _decodedMutex };
+			_decoded.push_back(std::move(texture));
+		} else {
+			std::cout << "Failed to load texture: " << request.path << "\n";
+		}
+	}
+}
+
+bool TextureStreamer::decodeTexture(const Request& request, DecodedTexture& outTexture)
+{
+	ZoneScopedN("stream_decode_texture");
+	assets::AssetView view;
+	nlohmann::json metadata;
+
+	if (!assets::mapBinaryFile(request.path.c_str(), view, metadata)) {
+		std::cout << "Error when loading image\n";
+		return false;
+	}
+
+	assets::TextureInfo texInfo{ assets::readTextureInfo(metadata) };
+
+	vkutil::TextureFormatInfo formatInfo;
+	if (!vkutil::getTextureFormatInfo(texInfo.textureFormat, formatInfo)) {
+		std::cout << "Error: unsupported texture format\n";
+		assets::unmapBinaryFile(view);
+		return false;
+	}
+
+	// same rule as vkutil::loadImageFromAsset, block compressed data keeps the format it was baked with
+	if (formatInfo.blockDim == 1) {
+		formatInfo.format = request.format;
+	}
+
+	if (!acquireStaging(texInfo.originalSize, outTexture.staging)) {
+		assets::unmapBinaryFile(view);
+		return false;
+	}
+
+	// other workers are decoding other textures, so one thread per blob is enough
+	bool unpacked{ assets::unpackBlob(view, texInfo.compressionMode, outTexture.staging.mapped, 1) };
+	assets::unmapBinaryFile(view);
+
+	if (!unpacked) {
+		std::cout << "Error when unpacking image\n";
+		releaseStaging(outTexture.staging);
+		return false;
+	}
+
+	VkExtent3D imageExtent{};
+	imageExtent.width = static_cast<uint32_t>(texInfo.width);
+	imageExtent.height = static_cast<uint32_t>(texInfo.height);
+	imageExtent.depth = 1;
+
+	VkImageCreateInfo dimg_info{ vkinit::imageCreateInfo(formatInfo.format, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, imageExtent, texInfo.miplevels) };
+	if (_queueFamilies.size() > 1) {
+		dimg_info.sharingMode = VK_SHARING_MODE_CONCURRENT;
+		dimg_info.queueFamilyIndexCount = static_cast<uint32_t>(_queueFamilies.size());
+		dimg_info.pQueueFamilyIndices = _queueFamilies.data();
+	}
+
+	VmaAllocationCreateInfo dimg_allocInfo{};
+	dimg_allocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+
+	// vma synchronizes allocations internally, so workers can create images directly
+	VkResult result{ vmaCreateImage(_engine->_allocator, &dimg_info, &dimg_allocInfo, &outTexture.image._image, &outTexture.image._allocation, nullptr) };
+	if (result != VK_SUCCESS) {
+		std::cout << "Error: failed to create streamed image " << result << "\n";
+		releaseStaging(outTexture.staging);
+		return false;
+	}
+
+	outTexture.key = request.key;
+	outTexture.viewFormat = formatInfo.format;
+	outTexture.components = formatInfo.components;
+	outTexture.mipLevels = static_cast<uint32_t>(texInfo.miplevels);
+	outTexture.copyRegions = vkutil::mipCopyRegions(imageExtent, outTexture.mipLevels, formatInfo, 0);
+
+	return true;
+}
+
+bool TextureStreamer::acquireStaging(VkDeviceSize size, StagingBuffer& outStaging)
+{
+	std::unique_lock<std::mutex> lock{ _stagingMutex };
+
+	// round up so buffers can be reused by textures of similar size
+	VkDeviceSize bufferSize{ 1024 * 1024 };
+	while (bufferSize < size) {
+		bufferSize *= 2;
+	}
+
+	while (!_stop) {
+		// take the smallest free buffer that fits
+		auto best{ _freeStaging.end() };
+		for (auto it{ _freeStaging.begin() }; it != _freeStaging.end(); ++it) {
+			if (it->size >= size && (best == _freeStaging.end() || it->size < best->size)) {
+				best = it;
+			}
+		}
+
+		if (best != _freeStaging.end()) {
+			outStaging = *best;
+			_freeStaging.erase(best);
+			_stagingInUse += outStaging.size;
+			return true;
+		}
+
+		// a texture bigger than the whole budget is still allowed through once nothing else is in flight
+		bool fitsBudget{ _stagingAllocated + bufferSize <= STREAMING_STAGING_BUDGET || _stagingInUse == 0 };
+
+		if (!fitsBudget && !_freeStaging.empty()) {
+			// none of the free buffers fit, give their memory back so a bigger one can be made
+			for (StagingBuffer& staging : _freeStaging) {
+				vmaDestroyBuffer(_engine->_allocator, staging.buffer._buffer, staging.buffer._allocation);
+				_stagingAllocated -= staging.size;
+			}
+			_freeStaging.clear();
+			continue;
+		}
+
+		if (fitsBudget) {
+			VkBufferCreateInfo bufferInfo{};
+			bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+			bufferInfo.pNext = nullptr;
+			bufferInfo.size = bufferSize;
+			bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+
+			// staging buffers stay mapped for their whole lifetime
+			VmaAllocationCreateInfo vmaAllocInfo{};
+			vmaAllocInfo.usage = VMA_MEMORY_USAGE_CPU_ONLY;
+			vmaAllocInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+			VmaAllocationInfo allocInfo{};
+			StagingBuffer staging{};
+			VkResult result{ vmaCreateBuffer(_engine->_allocator, &bufferInfo, &vmaAllocInfo, &staging.buffer._buffer, &staging.buffer._allocation, &allocInfo) };
+			if (result != VK_SUCCESS) {
+				std::cout << "Error: failed to allocate staging buffer " << result << "\n";
+				return false;
+			}
+
+			staging.mapped = allocInfo.pMappedData;
+			staging.size = bufferSize;
+			_stagingAllocated += bufferSize;
+			_stagingInUse += bufferSize;
+
+			outStaging = staging;
+			return true;
+		}
+
+		// wait for uploads to retire and hand their buffers back
+		_stagingCondition.wait(lock);
+	}
+
+	return false;
+}
+
+void TextureStreamer::releaseStaging(const StagingBuffer& staging)
+{
+	{
+		std::lock_guard<std::mutex> lock{ _stagingMutex };
+		_freeStaging.push_back(staging);
+		_stagingInUse -= staging.size;
+	}
+	_stagingCondition.notify_all();
+}
+
+void TextureStreamer::update(std::vector<VkSemaphore>& outWaitSemaphores, std::vector<uint64_t>& outWaitValues)
+{
+	ZoneScoped;
+	uint32_t frameIndex{ _engine->_frameNumber % FRAME_OVERLAP };
+
+	// this frame's fence was waited on, so its material sets are no longer in use. The textures they now point to
+	// were published at or below _publishedValue, which this frame's submit waits on
+	std::vector<DeferredWrite>& deferred{ _deferredWrites[frameIndex] };
+	for (DeferredWrite& write : deferred) {
+		VkWriteDescriptorSet textureWrite{ vkinit::writeDescriptorImage(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, write.set, &write.imageInfo, write.binding) };
+		vkUpdateDescriptorSets(_engine->_device, 1, &textureWrite, 0, nullptr);
+	}
+	deferred.clear();
+
+	uint64_t completedValue{ 0 };
+	VK_CHECK(_getSemaphoreCounterValue(_engine->_device, _timeline, &completedValue));
+
+	for (UploadBatch& batch : _batches) {
+		if (batch.submitted && batch.timelineValue <= completedValue) {
+			publishBatch(batch, frameIndex);
+			_publishedValue = std::max(_publishedValue, batch.timelineValue);
+			batch.submitted = false;
+		}
+	}
+
+	// the host only saw the value, the wait is what makes the copies visible to the graphics queue.
+	// a timeline wait can be repeated, so every frame waits on everything published so far
+	if (_publishedValue > 0) {
+		outWaitSemaphores.push_back(_timeline);
+		outWaitValues.push_back(_publishedValue);
+	}
+
+	// a published batch has reached its value, so its command buffer is done
+	UploadBatch* freeBatch{ nullptr };
+	for (UploadBatch& batch : _batches) {
+		if (!batch.submitted) {
+			freeBatch = &batch;
+			break;
+		}
+	}
+
+	if (freeBatch == nullptr) {
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock{ _decodedMutex };
+
+		VkDeviceSize batchBytes{ 0 };
+		size_t count{ 0 };
+		// always take at least one texture, even if it's bigger than the batch budget
+		while (count < _decoded.size() && (count == 0 || batchBytes + _decoded[count].staging.size <= STREAMING_BATCH_BYTES)) {
+			batchBytes += _decoded[count].staging.size;
+			++count;
+		}
+
+		std::move(_decoded.begin(), _decoded.begin() + count, std::back_inserter(freeBatch->textures));
+		_decoded.erase(_decoded.begin(), _decoded.begin() + count);
+	}
+
+	if (!freeBatch->textures.empty()) {
+		submitBatch(*freeBatch);
+	}
+}
+
+void TextureStreamer::submitBatch(UploadBatch& batch)
+{
+	ZoneScoped;
+	VK_CHECK(vkResetCommandPool(_engine->_device, batch.commandPool, 0));
+
+	VkCommandBufferBeginInfo cmdBeginInfo{};
+	cmdBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	cmdBeginInfo.pNext = nullptr;
+	cmdBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+	VK_CHECK(vkBeginCommandBuffer(batch.cmd, &cmdBeginInfo));
+
+	std::vector<VkImageMemoryBarrier> toTransfer;
+	std::vector<VkImageMemoryBarrier> toReadable;
+
+	for (const DecodedTexture& texture : batch.textures) {
+		VkImageSubresourceRange range{};
+		range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		range.baseMipLevel = 0;
+		range.levelCount = texture.mipLevels;
+		range.baseArrayLayer = 0;
+		range.layerCount = 1;
+
+		VkImageMemoryBarrier imageBarrierToTransfer{};
+		imageBarrierToTransfer.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		imageBarrierToTransfer.pNext = nullptr;
+		imageBarrierToTransfer.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageBarrierToTransfer.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		imageBarrierToTransfer.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		imageBarrierToTransfer.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		imageBarrierToTransfer.image = texture.image._image;
+		imageBarrierToTransfer.subresourceRange = range;
+		imageBarrierToTransfer.srcAccessMask = 0;
+		imageBarrierToTransfer.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		toTransfer.push_back(imageBarrierToTransfer);
+
+		// a transfer queue has no shader stages, the semaphore wait on the graphics queue covers the read side
+		VkImageMemoryBarrier imageBarrierToReadable{ imageBarrierToTransfer };
+		imageBarrierToReadable.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		imageBarrierToReadable.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		imageBarrierToReadable.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		imageBarrierToReadable.dstAccessMask = 0;
+		toReadable.push_back(imageBarrierToReadable);
+	}
+
+	vkCmdPipelineBarrier(batch.cmd,
+		VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+		0,
+		0, nullptr,
+		0, nullptr,
+		static_cast<uint32_t>(toTransfer.size()), toTransfer.data());
+
+	for (const DecodedTexture& texture : batch.textures) {
+		vkCmdCopyBufferToImage(batch.cmd, texture.staging.buffer._buffer, texture.image._image,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(texture.copyRegions.size()), texture.copyRegions.data());
+	}
+
+	vkCmdPipelineBarrier(batch.cmd,
+		VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+		0,
+		0, nullptr,
+		0, nullptr,
+		static_cast<uint32_t>(toReadable.size()), toReadable.data());
+
+	VK_CHECK(vkEndCommandBuffer(batch.cmd));
+
+	batch.timelineValue = ++_submittedValue;
+
+	VkTimelineSemaphoreSubmitInfoKHR timelineInfo{};
+	timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+	timelineInfo.pNext = nullptr;
+	timelineInfo.signalSemaphoreValueCount = 1;
+	timelineInfo.pSignalSemaphoreValues = &batch.timelineValue;
+
+	VkSubmitInfo submit{};
+	submit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submit.pNext = &timelineInfo;
+	submit.commandBufferCount = 1;
+	submit.pCommandBuffers = &batch.cmd;
+	submit.signalSemaphoreCount = 1;
+	submit.pSignalSemaphores = &_timeline;
+
+	VK_CHECK(vkQueueSubmit(_transferQueue, 1, &submit, VK_NULL_HANDLE));
+
+	batch.submitted = true;
+}
+
+void TextureStreamer::publishBatch(UploadBatch& batch, uint32_t frameIndex)
+{
+	ZoneScoped;
+	VulkanEngine* engine{ _engine };
+
+	for (DecodedTexture& decoded : batch.textures) {
+		Texture texture;
+		texture.image = decoded.image;
+		texture.mipLevels = decoded.mipLevels;
+
+		VkImageViewCreateInfo imageInfo{ vkinit::imageviewCreateInfo(decoded.viewFormat, texture.image._image, VK_IMAGE_ASPECT_COLOR_BIT, texture.mipLevels) };
+		imageInfo.components = decoded.components;
+		VK_CHECK(vkCreateImageView(engine->_device, &imageInfo, nullptr, &texture.imageView));
+
+		engine->_mainDeletionQueue.pushFunction([=]() {
+			vkDestroyImageView(engine->_device, texture.imageView, nullptr);
+			vmaDestroyImage(engine->_allocator, texture.image._image, texture.image._allocation);
+		});
+
+		engine->_loadedTextures[decoded.key] = texture;
+
+		// the placeholder's sampler only has one mip, so the bindings get a sampler for the real mip chain
+		VkSampler textureSampler{ sampler(texture.mipLevels) };
+		for (const DescriptorBinding& binding : _pending[decoded.key]) {
+			VkDescriptorImageInfo imageBufferInfo{};
+			imageBufferInfo.sampler = textureSampler;
+			imageBufferInfo.imageView = texture.imageView;
+			imageBufferInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+			VkWriteDescriptorSet textureWrite{ vkinit::writeDescriptorImage(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, binding.sets[frameIndex], &imageBufferInfo, binding.binding) };
+			vkUpdateDescriptorSets(engine->_device, 1, &textureWrite, 0, nullptr);
+
+			// the other frames may still be drawing with their sets
+			for (uint32_t i{ 0 }; i < binding.sets.size(); ++i) {
+				if (i != frameIndex) {
+					_deferredWrites[i].push_back({ binding.sets[i], binding.binding, imageBufferInfo });
+				}
+			}
+		}
+		_pending.erase(decoded.key);
+
+		releaseStaging(decoded.staging);
+	}
+
+	batch.textures.clear();
+}
+
+VkSampler TextureStreamer::sampler(uint32_t mipLevels)
+{
+	auto it{ _samplers.find(mipLevels) };
+	if (it != _samplers.end()) {
+		return it->second;
+	}
+
+	VulkanEngine* engine{ _engine };
+
+	VkSamplerCreateInfo samplerInfo{ vkinit::samplerCreateInfo(VK_FILTER_LINEAR, mipLevels, VK_SAMPLER_ADDRESS_MODE_REPEAT) };
+	VkSampler sampler;
+	VK_CHECK(vkCreateSampler(engine->_device, &samplerInfo, nullptr, &sampler));
+
+	engine->_mainDeletionQueue.pushFunction([=]() {
+		vkDestroySampler(engine->_device, sampler, nullptr);
+	});
+
+	_samplers[mipLevels] = sampler;
+	return sampler;
+}
+
+void TextureStreamer::createPlaceholder()
+{
+	VulkanEngine* engine{ _engine };
+
+	// mid grey reads as a neutral albedo, half roughness, and a flat normal once the shader rebuilds z from .rg
+	const uint8_t pixel[4]{ 128, 128, 128, 255 };
+
+	AllocatedBuffer stagingBuffer{ engine->createBuffer(sizeof(pixel), VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY) };
+
+	void* data;
+	vmaMapMemory(engine->_allocator, stagingBuffer._allocation, &data);
+	memcpy(data, pixel, sizeof(pixel));
+	vmaUnmapMemory(engine->_allocator, stagingBuffer._allocation);
+
+	VkExtent3D imageExtent{ 1, 1, 1 };
+	VkImageCreateInfo dimg_info{ vkinit::imageCreateInfo(VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, imageExtent, 1) };
+
+	VmaAllocationCreateInfo dimg_allocInfo{};
+	dimg_allocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+
+	AllocatedImage image;
+	VK_CHECK(vmaCreateImage(engine->_allocator, &dimg_info, &dimg_allocInfo, &image._image, &image._allocation, nullptr));
+
+	engine->immediateSubmit([=](VkCommandBuffer cmd) {
+		VkImageSubresourceRange range{};
+		range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		range.baseMipLevel = 0;
+		range.levelCount = 1;
+		range.baseArrayLayer = 0;
+		range.layerCount = 1;
+
+		VkImageMemoryBarrier imageBarrierToTransfer{};
+		imageBarrierToTransfer.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		imageBarrierToTransfer.pNext = nullptr;
+		imageBarrierToTransfer.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageBarrierToTransfer.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		imageBarrierToTransfer.image = image._image;
+		imageBarrierToTransfer.subresourceRange = range;
+		imageBarrierToTransfer.srcAccessMask = 0;
+		imageBarrierToTransfer.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+		vkCmdPipelineBarrier(cmd,
+			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+			0,
+			0, nullptr,
+			0, nullptr,
+			1, &imageBarrierToTransfer);
+
+		VkBufferImageCopy copyRegion{};
+		copyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		copyRegion.imageSubresource.mipLevel = 0;
+		copyRegion.imageSubresource.baseArrayLayer = 0;
+		copyRegion.imageSubresource.layerCount = 1;
+		copyRegion.imageExtent = imageExtent;
+
+		vkCmdCopyBufferToImage(cmd, stagingBuffer._buffer, image._image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copyRegion);
+
+		VkImageMemoryBarrier imageBarrierToReadable{ imageBarrierToTransfer };
+		imageBarrierToReadable.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		imageBarrierToReadable.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		imageBarrierToReadable.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		imageBarrierToReadable.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+		vkCmdPipelineBarrier(cmd,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+			0,
+			0, nullptr,
+			0, nullptr,
+			1, &imageBarrierToReadable);
+	});
+
+	vmaDestroyBuffer(engine->_allocator, stagingBuffer._buffer, stagingBuffer._allocation);
+
+	_placeholder.image = image;
+	_placeholder.mipLevels = 1;
+
+	VkImageViewCreateInfo imageInfo{ vkinit::imageviewCreateInfo(VK_FORMAT_R8G8B8A8_UNORM, image._image, VK_IMAGE_ASPECT_COLOR_BIT, 1) };
+	VK_CHECK(vkCreateImageView(engine->_device, &imageInfo, nullptr, &_placeholder.imageView));
+
+	Texture placeholder{ _placeholder };
+	engine->_mainDeletionQueue.pushFunction([=]() {
+		vkDestroyImageView(engine->_device, placeholder.imageView, nullptr);
+		vmaDestroyImage(engine->_allocator, placeholder.image._image, placeholder.image._allocation);
+	});
+}
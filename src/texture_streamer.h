@@ -0,0 +1,156 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+#include "vk_types.h"
+#include "vk_mesh.h"
+
+class VulkanEngine;
+
+// number of upload batches that can be in flight on the transfer queue at once
+constexpr uint32_t STREAMING_BATCHES{ 4 };
+// upper bound of staging memory decoded textures can occupy before workers wait for uploads to retire
+constexpr VkDeviceSize STREAMING_STAGING_BUDGET{ 256ull * 1024 * 1024 };
+// bytes copied per batch, so one big level load doesn't turn into a single huge submit
+constexpr VkDeviceSize STREAMING_BATCH_BYTES{ 64ull * 1024 * 1024 };
+
+// Loads texture assets in the background. Worker threads map and decode files into pooled staging
+// buffers, the main thread batches the copies onto the transfer queue once per frame, and materials
+// sample a placeholder until their textures are resident.
+class TextureStreamer {
+public:
+	void init(VulkanEngine* engine);
+
+	void cleanup();
+
+	// queue an asset texture for loading. key is the name materials refer to the texture by
+	void requestTexture(const std::string& key, const std::string& path, VkFormat format);
+
+	// remember that a material's descriptor sets sample the texture, so they can be rewritten once the texture is resident.
+	// sets has one set per frame in flight, indexed like the engine's frames
+	void addDescriptorBinding(const std::string& key, const std::vector<VkDescriptorSet>& sets, uint32_t binding);
+
+	bool isPending(const std::string& key) const;
+
+	const Texture& placeholder() const;
+
+	// Called once per frame after the frame's fence has been waited on, but before it is reset.
+	// Publishes textures whose uploads finished into the current frame's material sets, the other frames' sets
+	// are written once their fence has been waited on. Submits newly decoded textures. The upload timeline and the
+	// value the graphics submit must wait on before sampling the published textures are appended to the outputs
+	void update(std::vector<VkSemaphore>& outWaitSemaphores, std::vector<uint64_t>& outWaitValues);
+
+private:
+	struct StagingBuffer {
+		AllocatedBuffer buffer;
+		void* mapped;
+		VkDeviceSize size;
+	};
+
+	struct Request {
+		std::string key;
+		std::string path;
+		VkFormat format;
+	};
+
+	// decoded by a worker and waiting in staging memory to be copied
+	struct DecodedTexture {
+		std::string key;
+		StagingBuffer staging;
+		AllocatedImage image;
+		VkFormat viewFormat;
+		VkComponentMapping components;
+		uint32_t mipLevels;
+		std::vector<VkBufferImageCopy> copyRegions;
+	};
+
+	// a batch is done once the upload timeline reaches its value, which also means its command buffer can be reused
+	struct UploadBatch {
+		VkCommandPool commandPool;
+		VkCommandBuffer cmd;
+		std::vector<DecodedTexture> textures;
+		bool submitted{ false };
+		uint64_t timelineValue{ 0 };
+	};
+
+	struct DescriptorBinding {
+		std::vector<VkDescriptorSet> sets;
+		uint32_t binding;
+	};
+
+	// a write to a set that was still in use by a frame in flight when the texture was published
+	struct DeferredWrite {
+		VkDescriptorSet set;
+		uint32_t binding;
+		VkDescriptorImageInfo imageInfo;
+	};
+
+	void workerLoop();
+
+	bool decodeTexture(const Request& request, DecodedTexture& outTexture);
+
+	bool acquireStaging(VkDeviceSize size, StagingBuffer& outStaging);
+
+	void releaseStaging(const StagingBuffer& staging);
+
+	void submitBatch(UploadBatch& batch);
+
+	// writes the textures into the sets of frameIndex and defers the writes to the other frames' sets
+	void publishBatch(UploadBatch& batch, uint32_t frameIndex);
+
+	void createPlaceholder();
+
+	// samplers only differ by their mip count, so every texture with the same count shares one
+	VkSampler sampler(uint32_t mipLevels);
+
+	VulkanEngine* _engine{ nullptr };
+
+	VkQueue _transferQueue;
+	uint32_t _transferQueueFamily;
+	// images are shared concurrently when the transfer queue is from another family than graphics
+	std::vector<uint32_t> _queueFamilies;
+
+	Texture _placeholder;
+
+	std::vector<std::thread> _workers;
+	std::atomic<bool> _stop{ false };
+
+	// requests waiting for a worker
+	std::mutex _requestMutex;
+	std::condition_variable _requestCondition;
+	std::deque<Request> _requests;
+
+	// decoded textures waiting for the main thread to submit them
+	std::mutex _decodedMutex;
+	std::vector<DecodedTexture> _decoded;
+
+	std::mutex _stagingMutex;
+	std::condition_variable _stagingCondition;
+	std::vector<StagingBuffer> _freeStaging;
+	VkDeviceSize _stagingAllocated{ 0 };
+	VkDeviceSize _stagingInUse{ 0 };
+
+	UploadBatch _batches[STREAMING_BATCHES];
+
+	// VK_KHR_timeline_semaphore, signalled by the transfer queue with increasing values, one per batch
+	VkSemaphore _timeline{ VK_NULL_HANDLE };
+	PFN_vkGetSemaphoreCounterValueKHR _getSemaphoreCounterValue{ nullptr };
+	// value of the last submitted batch
+	uint64_t _submittedValue{ 0 };
+	// value of the last published batch, every graphics submit waits on it since any frame may sample those textures
+	uint64_t _publishedValue{ 0 };
+
+	// only touched by the main thread
+	std::unordered_map<std::string, std::vector<DescriptorBinding>> _pending;
+	// per frame in flight, applied when that frame comes around again
+	std::vector<std::vector<DeferredWrite>> _deferredWrites;
+	// keyed by mip count
+	std::unordered_map<uint32_t, VkSampler> _samplers;
+};
@@ -0,0 +1,287 @@
+#include "upload_batch.h"
+
+#include <iostream>
+#include <cstring>
+
+#include "vk_engine.h"
+#include "vk_initializers.h"
+
+void UploadBatch::init(VulkanEngine* engine)
+{
+	_engine = engine;
+
+	VkCommandPoolCreateInfo poolInfo{ vkinit::commandPoolCreateInfo(engine->_graphicsQueueFamily, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT) };
+	VK_CHECK(vkCreateCommandPool(engine->_device, &poolInfo, nullptr, &_commandPool));
+
+	VkBufferCreateInfo bufferInfo{};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.pNext = nullptr;
+	bufferInfo.size = UPLOAD_ARENA_SIZE;
+	bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+
+	VmaAllocationCreateInfo vmaAllocInfo{};
+	vmaAllocInfo.usage = VMA_MEMORY_USAGE_CPU_ONLY;
+	vmaAllocInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+	VmaAllocationInfo allocInfo{};
+	VK_CHECK(vmaCreateBuffer(engine->_allocator, &bufferInfo, &vmaAllocInfo, &_arena._buffer, &_arena._allocation, &allocInfo));
+	_arenaData = allocInfo.pMappedData;
+}
+
+void UploadBatch::cleanup()
+{
+	flush();
+
+	for (VkFence fence : _freeFences) {
+		vkDestroyFence(_engine->_device, fence, nullptr);
+	}
+	_freeFences.clear();
+
+	vmaDestroyBuffer(_engine->_allocator, _arena._buffer, _arena._allocation);
+	vkDestroyCommandPool(_engine->_device, _commandPool, nullptr);
+}
+
+VkCommandBuffer UploadBatch::commandBuffer()
+{
+	if (_recording.cmd != VK_NULL_HANDLE) {
+		return _recording.cmd;
+	}
+
+	VkCommandBufferAllocateInfo cmdAllocInfo{ vkinit::commandBufferAllocateInfo(_commandPool, 1) };
+	VK_CHECK(vkAllocateCommandBuffers(_engine->_device, &cmdAllocInfo, &_recording.cmd));
+
+	VkCommandBufferBeginInfo cmdBeginInfo{};
+	cmdBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	cmdBeginInfo.pNext = nullptr;
+	cmdBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+	VK_CHECK(vkBeginCommandBuffer(_recording.cmd, &cmdBeginInfo));
+
+	return _recording.cmd;
+}
+
+bool UploadBatch::overlaps(const std::vector<Range>& ranges, const Range& range) const
+{
+	for (const Range& other : ranges) {
+		if (range.begin < other.end && other.begin < range.end) {
+			return true;
+		}
+	}
+	return false;
+}
+
+UploadBatch::StagingAllocation UploadBatch::allocate(VkDeviceSize size, VkDeviceSize alignment)
+{
+	ZoneScoped;
+	retireFinished();
+
+	StagingAllocation allocation{};
+
+	if (size > UPLOAD_ARENA_SIZE) {
+		AllocatedBuffer buffer{ _engine->createBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY) };
+		VK_CHECK(vmaMapMemory(_engine->_allocator, buffer._allocation, &allocation.data));
+		// unmapped when the batch is submitted
+		_recording.dedicatedBuffers.push_back(buffer);
+
+		allocation.buffer = buffer._buffer;
+		allocation.offset = 0;
+		return allocation;
+	}
+
+	Range range{};
+	range.begin = (_head + alignment - 1) / alignment * alignment;
+	range.end = range.begin + size;
+
+	// wrap around to the start of the ring
+	if (range.end > UPLOAD_ARENA_SIZE) {
+		range.begin = 0;
+		range.end = size;
+	}
+
+	// the batch being recorded can't overwrite its own data, so it has to be submitted first
+	if (overlaps(_recording.ranges, range)) {
+		submit();
+	}
+
+	// submissions retire in order, so wait on the oldest until nothing in flight still reads from the range
+	while (true) {
+		bool blocked{ false };
+		for (const Submission& submission : _inFlight) {
+			blocked = blocked || overlaps(submission.ranges, range);
+		}
+		if (!blocked) {
+			break;
+		}
+		retireOldest();
+	}
+
+	_head = range.end;
+	_recording.ranges.push_back(range);
+
+	allocation.buffer = _arena._buffer;
+	allocation.offset = range.begin;
+	allocation.data = static_cast<char*>(_arenaData) + range.begin;
+	return allocation;
+}
+
+void UploadBatch::copyBuffer(const StagingAllocation& src, VkDeviceSize srcOffset, VkBuffer dst, VkDeviceSize dstOffset, VkDeviceSize size)
+{
+	if (size == 0) {
+		return;
+	}
+
+	VkBufferCopy copy{};
+	copy.srcOffset = src.offset + srcOffset;
+	copy.dstOffset = dstOffset;
+	copy.size = size;
+	vkCmdCopyBuffer(commandBuffer(), src.buffer, dst, 1, &copy);
+}
+
+void UploadBatch::uploadBuffer(const void* data, VkDeviceSize size, VkBuffer dst, VkDeviceSize dstOffset)
+{
+	if (size == 0) {
+		return;
+	}
+
+	StagingAllocation staging{ allocate(size) };
+	memcpy(staging.data, data, static_cast<size_t>(size));
+	copyBuffer(staging, 0, dst, dstOffset, size);
+}
+
+void UploadBatch::copyBufferToImage(const StagingAllocation& src, VkImage image, uint32_t mipLevels, std::vector<VkBufferImageCopy> regions)
+{
+	VkCommandBuffer cmd{ commandBuffer() };
+
+	VkImageSubresourceRange range{};
+	range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	range.baseMipLevel = 0;
+	range.levelCount = mipLevels;
+	range.baseArrayLayer = 0;
+	range.layerCount = 1;
+
+	VkImageMemoryBarrier imageBarrierToTransfer{};
+	imageBarrierToTransfer.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	imageBarrierToTransfer.pNext = nullptr;
+	imageBarrierToTransfer.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	imageBarrierToTransfer.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	imageBarrierToTransfer.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	imageBarrierToTransfer.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	imageBarrierToTransfer.image = image;
+	imageBarrierToTransfer.subresourceRange = range;
+	imageBarrierToTransfer.srcAccessMask = 0;
+	imageBarrierToTransfer.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+	vkCmdPipelineBarrier(cmd,
+		VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+		0,
+		0, nullptr,
+		0, nullptr,
+		1, &imageBarrierToTransfer);
+
+	for (VkBufferImageCopy& region : regions) {
+		region.bufferOffset += src.offset;
+	}
+
+	vkCmdCopyBufferToImage(cmd, src.buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(regions.size()), regions.data());
+
+	// all images are made readable together when the batch is submitted
+	VkImageMemoryBarrier imageBarrierToReadable{ imageBarrierToTransfer };
+	imageBarrierToReadable.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	imageBarrierToReadable.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	imageBarrierToReadable.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	imageBarrierToReadable.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	_imagesToReadable.push_back(imageBarrierToReadable);
+}
+
+void UploadBatch::submit()
+{
+	if (_recording.cmd == VK_NULL_HANDLE) {
+		return;
+	}
+	ZoneScoped;
+
+	// one barrier covers every buffer copy in the batch. Pipeline barriers order against everything later
+	// submitted to the same queue, so frames can draw with the new data right away
+	VkMemoryBarrier memoryBarrier{};
+	memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	memoryBarrier.pNext = nullptr;
+	memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	memoryBarrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT;
+
+	vkCmdPipelineBarrier(_recording.cmd,
+		VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		0,
+		1, &memoryBarrier,
+		0, nullptr,
+		static_cast<uint32_t>(_imagesToReadable.size()), _imagesToReadable.data());
+	_imagesToReadable.clear();
+
+	VK_CHECK(vkEndCommandBuffer(_recording.cmd));
+
+	// dedicated buffers were written through a mapping, unmap them before the gpu reads them
+	for (const AllocatedBuffer& buffer : _recording.dedicatedBuffers) {
+		vmaUnmapMemory(_engine->_allocator, buffer._allocation);
+	}
+
+	if (_freeFences.empty()) {
+		VkFenceCreateInfo fenceInfo{};
+		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		fenceInfo.pNext = nullptr;
+
+		VkFence fence;
+		VK_CHECK(vkCreateFence(_engine->_device, &fenceInfo, nullptr, &fence));
+		_freeFences.push_back(fence);
+	}
+	_recording.fence = _freeFences.back();
+	_freeFences.pop_back();
+
+	VkSubmitInfo submit{};
+	submit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submit.pNext = nullptr;
+	submit.commandBufferCount = 1;
+	submit.pCommandBuffers = &_recording.cmd;
+
+	VK_CHECK(vkQueueSubmit(_engine->_graphicsQueue, 1, &submit, _recording.fence));
+
+	_inFlight.push_back(std::move(_recording));
+	_recording = Submission{};
+}
+
+void UploadBatch::flush()
+{
+	ZoneScoped;
+	submit();
+
+	while (!_inFlight.empty()) {
+		retireOldest();
+	}
+}
+
+void UploadBatch::retireOldest()
+{
+	Submission& submission{ _inFlight.front() };
+	VK_CHECK(vkWaitForFences(_engine->_device, 1, &submission.fence, VK_TRUE, UINT64_MAX));
+
+	destroySubmission(submission);
+	_inFlight.pop_front();
+}
+
+void UploadBatch::retireFinished()
+{
+	while (!_inFlight.empty() && vkGetFenceStatus(_engine->_device, _inFlight.front().fence) == VK_SUCCESS) {
+		destroySubmission(_inFlight.front());
+		_inFlight.pop_front();
+	}
+}
+
+void UploadBatch::destroySubmission(Submission& submission)
+{
+	VK_CHECK(vkResetFences(_engine->_device, 1, &submission.fence));
+	_freeFences.push_back(submission.fence);
+
+	vkFreeCommandBuffers(_engine->_device, _commandPool, 1, &submission.cmd);
+
+	for (const AllocatedBuffer& buffer : submission.dedicatedBuffers) {
+		vmaDestroyBuffer(_engine->_allocator, buffer._buffer, buffer._allocation);
+	}
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <functional>
+
+#include "vk_types.h"
+
+class VulkanEngine;
+
+// size of the persistently mapped staging ring all batched uploads are written into
+constexpr VkDeviceSize UPLOAD_ARENA_SIZE{ 64ull * 1024 * 1024 };
+
+// Gathers buffer and image copies into one command buffer, with their source data in a shared
+// ring-allocated staging arena, and submits them together on the graphics queue.
+// Every submission ends in a barrier that makes the copies visible to vertex input and shaders, so
+// anything submitted to the graphics queue afterwards can use the uploaded data without waiting on the CPU.
+class UploadBatch {
+public:
+	struct StagingAllocation {
+		VkBuffer buffer;
+		// offset of the allocation in buffer
+		VkDeviceSize offset;
+		void* data;
+	};
+
+	void init(VulkanEngine* engine);
+
+	void cleanup();
+
+	// Reserve staging memory to write upload data into. If the ring is full this submits the recorded copies
+	// and waits for old ones to retire, so copies reading from an allocation must be recorded before the next allocate
+	StagingAllocation allocate(VkDeviceSize size, VkDeviceSize alignment = 16);
+
+	void copyBuffer(const StagingAllocation& src, VkDeviceSize srcOffset, VkBuffer dst, VkDeviceSize dstOffset, VkDeviceSize size);
+
+	// copies data into the arena and records the copy to dst
+	void uploadBuffer(const void* data, VkDeviceSize size, VkBuffer dst, VkDeviceSize dstOffset = 0);
+
+	// bufferOffsets in regions are relative to src. Transitions the whole image to TRANSFER_DST before the copy
+	// and to SHADER_READ_ONLY when the batch is submitted
+	void copyBufferToImage(const StagingAllocation& src, VkImage image, uint32_t mipLevels, std::vector<VkBufferImageCopy> regions);
+
+	// submit everything recorded so far without waiting for it
+	void submit();
+
+	// submit and block until every upload has finished
+	void flush();
+
+private:
+	struct Range {
+		VkDeviceSize begin;
+		VkDeviceSize end;
+	};
+
+	struct Submission {
+		VkCommandBuffer cmd;
+		VkFence fence;
+		std::vector<Range> ranges;
+		// allocations too big for the ring get their own buffer, freed when the submission retires
+		std::vector<AllocatedBuffer> dedicatedBuffers;
+	};
+
+	VkCommandBuffer commandBuffer();
+
+	bool overlaps(const std::vector<Range>& ranges, const Range& range) const;
+
+	// wait for the oldest submission and give its staging memory back to the ring
+	void retireOldest();
+
+	// retire every submission that already finished, without waiting
+	void retireFinished();
+
+	void destroySubmission(Submission& submission);
+
+	VulkanEngine* _engine{ nullptr };
+
+	VkCommandPool _commandPool;
+	std::vector<VkFence> _freeFences;
+
+	AllocatedBuffer _arena;
+	void* _arenaData{ nullptr };
+	VkDeviceSize _head{ 0 };
+
+	// being recorded, not submitted yet
+	Submission _recording{};
+	std::vector<VkImageMemoryBarrier> _imagesToReadable;
+
+	std::deque<Submission> _inFlight;
+};
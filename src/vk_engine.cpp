@@ -91,8 +91,9 @@ physx::PxTransform Transform::toPhysx()
 	return result;
 }
 
-void GameObject::setRenderObject(const RenderObject* ro)
+void GameObject::setRenderObject(VulkanEngine* engine, RenderObjectHandle ro)
 {
+	_engine = engine;
 	_renderObject = ro;
 }
 
@@ -108,7 +109,12 @@ void GameObject::setPhysicsObject(physx::PxRigidActor* body)
 
 void GameObject::updateRenderMatrix()
 {
-	_renderObject->uniformBlock.transformMatrix = getGlobalMat4();
+	if (_engine == nullptr) {
+		return;
+	}
+
+	// marks the object dirty so the new matrix reaches the object SSBO
+	_engine->_renderables.setTransform(_renderObject, getGlobalMat4());
 }
 
 Transform GameObject::getTransform()
@@ -252,19 +258,30 @@ void VulkanEngine::init(Application* app)
 	_app = app;
 	initVulkan();
 	initSwapchain(VK_NULL_HANDLE);
+	// the main thread records too, so leave one core for it
+	_jobSystem.init(std::max(1u, std::thread::hardware_concurrency()) - 1);
 	initCommands();
 	initTracy();
 	initDefaultRenderpass();
-	initFramebuffers(false);
+	_renderGraph.init(this);
 	initSyncStructures();
+	_renderables.init(FRAME_OVERLAP);
+	_uploadBatch.init(this);
+	_frameAllocator.init(this, FRAME_OVERLAP);
+	_geometryPool.init(this);
+	_textureStreamer.init(this);
 	initDescriptorPool();
 	initObjectBuffers();
 	initShadowPass();
+	_clusteredLighting.init(this);
 	initDescriptors(); // descriptors are needed at pipeline create, so before materials
+	_indirectDraw.init(this);
+	_computeSkinning.init(this);
+	loadCompressionDictionaries();
 	loadMeshes();
 	loadMaterials();
 	initScene();
-	initBoundingSphere();
+	initShadowCascades();
 	initImgui();
 	initGuiData();
 
@@ -296,16 +313,7 @@ void VulkanEngine::setCameraTransform(Transform transform)
 
 void VulkanEngine::setSceneLights(const std::vector<Light>& lights)
 {
-	uint32_t numLights = (uint32_t)lights.size();
-	if (numLights > MAX_NUM_TOTAL_LIGHTS) {
-		std::cout << "Error: numLights > MAX_NUM_TOTAL_LIGHTS\n";
-	}
-
-	_sceneParameters.numLights = numLights;
-
-	for (auto i{ 0 }; i < numLights; ++i) {
-		_sceneParameters.lights[i] = lights[i];
-	}
+	_clusteredLighting.setLights(lights);
 }
 
 void VulkanEngine::initTracy()
@@ -412,24 +420,49 @@ void VulkanEngine::initScene()
 	_app->init(*this);
 }
 
-const RenderObject* VulkanEngine::createRenderObject(const std::string& meshName, const std::string& matName, bool castShadow)
+RenderObjectHandle VulkanEngine::createRenderObject(const std::string& meshName, const std::string& matName, bool castShadow, bool isStatic)
 {
 	RenderObject object{};
 	object.mesh = getMesh(meshName);
 	object.material = getMaterial(matName);
 	object.castShadow = castShadow;
+	object.isStatic = isStatic;
 	object.uniformBlock.transformMatrix = glm::mat4(1.0f);
 
-	return &(*_renderables.insert(object));
+	if (object.mesh == nullptr || object.material == nullptr) {
+		std::cout << "Error: can't create render object with mesh " << meshName << " and material " << matName << "\n";
+		return RenderObjectHandle{};
+	}
+
+	// each object plays its own copy of the pose, the mesh's skeleton is shared
+	if (object.mesh->skel.nodeCount() > 0) {
+		object.initAnimation();
+	}
+
+	return _renderables.create(object);
 }
 
-const RenderObject* VulkanEngine::createRenderObject(const std::string& name)
+RenderObjectHandle VulkanEngine::createRenderObject(const std::string& name)
 {
 	return createRenderObject(name, name);
 }
 
+void VulkanEngine::destroyRenderObject(RenderObjectHandle handle)
+{
+	// frames in flight already copied the object into their SSBO and draw commands, so it can go right away
+	_renderables.destroy(handle);
+}
+
+RenderObject* VulkanEngine::getRenderObject(RenderObjectHandle handle)
+{
+	return _renderables.get(handle);
+}
+
 void VulkanEngine::immediateSubmit(std::function<void(VkCommandBuffer cmd)>&& function)
 {
+	// batched uploads recorded so far go first, so the immediate commands can use them
+	_uploadBatch.submit();
+
 	// allocate the default command buffer that we will use for the instant commands
 	VkCommandBufferAllocateInfo cmdAllocInfo{ vkinit::commandBufferAllocateInfo(_uploadContext._commandPool, 1) };
 
@@ -466,133 +499,163 @@ void VulkanEngine::immediateSubmit(std::function<void(VkCommandBuffer cmd)>&& fu
 	vkResetCommandPool(_device, _uploadContext._commandPool, 0);
 }
 
-void VulkanEngine::uploadMesh(Mesh* mesh)
-{
-	uploadBuffer(mesh->vertices, mesh->vertexBuffer, true);
-	uploadBuffer(mesh->indices, mesh->indexBuffer, false);
-}
-
-void VulkanEngine::uploadMeshSkinned(Mesh* mesh)
-{
-	uploadBuffer(mesh->verticesSkinned, mesh->vertexBuffer, true);
-	uploadBuffer(mesh->indices, mesh->indexBuffer, false);
-}
-
 void VulkanEngine::loadSkeletalAnimation(const std::string& name, const std::string& path)
 {
 	std::cout << "Loading skeletal animation...\n";
 
+	assets::AssetFile file;
+	nlohmann::json metadata;
+	if (!assets::loadBinaryFile(path.c_str(), file, metadata) || strncmp(file.type, "SKEL", 4) != 0) {
+		std::cout << "Error: failed to load skeleton " << path << "\n";
+		return;
+	}
+
 	assets::SkeletalAnimationDataAsset skelAsset;
 
 	{
-		std::ifstream ifs{ path, std::ios::binary };
-		cereal::BinaryInputArchive iarchive(ifs);
+		std::istringstream iss{ std::string{ file.binaryBlob.begin(), file.binaryBlob.end() }, std::ios::binary };
+		cereal::BinaryInputArchive iarchive(iss);
 
 		iarchive(skelAsset);
 	}
 
+	// the pose is propagated in one pass, which needs every parent before its children. An unsorted skeleton
+	// would pose with the wrong global transforms, so the mesh is left unanimated instead
+	for (int32_t i = 0; i < skelAsset.nodes.size(); ++i) {
+		if (skelAsset.nodes[i].parentIdx >= i) {
+			std::cout << "Error: nodes of " << path << " aren't sorted, rebake it\n";
+			return;
+		}
+	}
+
 	SkeletalAnimationData& skel{ _meshes[name]->skel };
-	skel.nodes.resize(skelAsset.nodes.size());
+	size_t nodeCount{ skelAsset.nodes.size() };
+	skel.parents.resize(nodeCount);
+	skel.matrices.resize(nodeCount);
+	skel.names.resize(nodeCount);
+	skel.restPose.translations.resize(nodeCount);
+	skel.restPose.rotations.resize(nodeCount);
+	skel.restPose.scales.resize(nodeCount);
 	skel.skins.resize(skelAsset.skins.size());
 	skel.animations.resize(skelAsset.animations.size());
 
 	// convert assets to real thing
 
 
-	for (int i = 0; i < skelAsset.nodes.size(); ++i) {
-		if (skelAsset.nodes[i].parentIdx > -1) {
-			skel.nodes[i].parent = &skel.nodes[skelAsset.nodes[i].parentIdx];
-		} else {
-			skel.nodes[i].parent = nullptr;
-		}
-
-		for (int32_t childIdx : skelAsset.nodes[i].children) {
-			skel.nodes[i].children.push_back(&skel.nodes[childIdx]);
-		}
-
-		skel.nodes[i].matrix = skelAsset.nodes[i].matrix;
-		skel.nodes[i].cachedMatrix = glm::mat4(1.0f);
-		skel.nodes[i].name = skelAsset.nodes[i].name;
-		skel.nodes[i].translation = skelAsset.nodes[i].translation;
-		skel.nodes[i].scale = skelAsset.nodes[i].scale;
-		skel.nodes[i].rotation = skelAsset.nodes[i].rotation;
+	for (int i = 0; i < nodeCount; ++i) {
+		skel.parents[i] = std::max(skelAsset.nodes[i].parentIdx, -1);
+		skel.matrices[i] = skelAsset.nodes[i].matrix;
+		skel.names[i] = skelAsset.nodes[i].name;
+		skel.restPose.translations[i] = skelAsset.nodes[i].translation;
+		skel.restPose.rotations[i] = skelAsset.nodes[i].rotation;
+		skel.restPose.scales[i] = skelAsset.nodes[i].scale;
 	}
 
 	for (int i = 0; i < skelAsset.skins.size(); ++i) {
 		skel.skins[i].name = skelAsset.skins[i].name;
-		skel.skins[i].skeletonRoot = &skel.nodes[skelAsset.skins[i].skeletonRootIdx];
+		skel.skins[i].skeletonRoot = static_cast<uint32_t>(skelAsset.skins[i].skeletonRootIdx);
 		skel.skins[i].inverseBindMatrices = skelAsset.skins[i].inverseBindMatrices;
 
 		for (int32_t idx : skelAsset.skins[i].joints) {
-			skel.skins[i].joints.push_back(&skel.nodes[idx]);
+			skel.skins[i].joints.push_back(static_cast<uint32_t>(idx));
 		}
 
-		skel.skins[i].uniformBlock.jointCount = (float)std::min((uint32_t)skel.skins[i].joints.size(), MAX_NUM_JOINTS);
-		skel.skins[i].allocator = &_allocator;
-
-		skel.skins[i].ubo = createBuffer(sizeof(Skin::UniformBlockSkinned), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT , VMA_MEMORY_USAGE_CPU_TO_GPU);
-
-		_mainDeletionQueue.pushFunction([=]() {
-			vmaDestroyBuffer(_allocator, skel.skins[i].ubo._buffer, skel.skins[i].ubo._allocation);
-		});
-
-		VkDescriptorSetAllocateInfo skinAllocInfo{};
-		skinAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-		skinAllocInfo.descriptorPool = _descriptorPool;
-		skinAllocInfo.descriptorSetCount = 1;
-		skinAllocInfo.pSetLayouts = &_skinSetLayout;
-
-		VK_CHECK(vkAllocateDescriptorSets(_device, &skinAllocInfo, &skel.skins[i].jointsDescriptorSet));
-
-		VkDescriptorBufferInfo bufferInfo{};
-		bufferInfo.buffer = skel.skins[i].ubo._buffer;
-		bufferInfo.offset = 0;
-		bufferInfo.range = sizeof(Skin::UniformBlockSkinned);
-
-		VkWriteDescriptorSet descriptorWrite{ vkinit::writeDescriptorBuffer(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, skel.skins[i].jointsDescriptorSet, &bufferInfo, 0) };
-
-		vkUpdateDescriptorSets(_device, 1, &descriptorWrite, 0, nullptr);
-
-		// allocate and write shadow descriptor set
-		setupShadowDescriptorSetsSkinned(*this, skel.skins[i].ubo._buffer, _shadowGlobal.shadowJointSetLayout, skel.skins[i].jointsShadowDescriptorSet);
+		// joint matrices are relative to the skeleton's root, not to whatever node it hangs from
+		skel.parents[skel.skins[i].skeletonRoot] = -1;
 	}
 
 	// skelAsset and skelPool both use same animation struct
 	skel.animations = skelAsset.animations;
+
+	for (Animation& animation : skel.animations) {
+		for (const AnimationChannel& channel : animation.channels) {
+			if (channel.path == AnimationChannel::ROTATION) {
+				animation.samplers[channel.samplerIndex].rotation = true;
+			}
+		}
+	}
 }
 
 
 // load mesh onto CPU then upload it to the GPU
 void VulkanEngine::loadMesh(const std::string& name, const std::string& path)
 {
-	assets::AssetFile assetFile;
+	ZoneScoped;
+	assets::AssetView view;
 	nlohmann::json metadata;
 
-	assets::loadBinaryFile(path.c_str(), assetFile, metadata);
+	if (!assets::mapBinaryFile(path.c_str(), view, metadata)) {
+		std::cout << "Error: failed to load mesh " << path << "\n";
+		return;
+	}
 	assets::MeshInfo info{ assets::readMeshInfo(metadata) };
 
+	if (info.vertexFormat != VertexFormat::DEFAULT && info.vertexFormat != VertexFormat::SKINNED) {
+		std::cout << "Error: unrecognized vertex format in VulkanEngine::loadMesh\n";
+		assets::unmapBinaryFile(view);
+		return;
+	}
+
+	// the copies below trust these sizes, so a stale or malformed asset mustn't read or write past the blob
+	if (info.vertexBufferSize + info.indexBufferSize != view.unpackedSize || info.indexSize <= 0) {
+		std::cout << "Error: buffer sizes of mesh " << path << " don't match its blob\n";
+		assets::unmapBinaryFile(view);
+		return;
+	}
+
 	Mesh* mesh{ new Mesh{} };
-	mesh->indices.resize(info.indexBufferSize / info.indexSize);
 	mesh->vertexFormat = info.vertexFormat;
+	// skinned meshes can animate outside their bind pose bounds, so they keep the default and are never culled
+	if (info.vertexFormat == VertexFormat::DEFAULT) {
+		mesh->bounds = info.bounds;
+	}
 
+	uint32_t vertexCount{ static_cast<uint32_t>(info.vertexBufferSize / GeometryPool::vertexStride(info.vertexFormat)) };
+	uint32_t indexCount{ static_cast<uint32_t>(info.indexBufferSize / info.indexSize) };
 
-	if (info.vertexFormat == VertexFormat::DEFAULT) {
+	if (!_geometryPool.allocate(mesh, vertexCount, indexCount)) {
+		std::cout << "Error: no room for mesh " << path << "\n";
+		assets::unmapBinaryFile(view);
+		delete mesh;
+		return;
+	}
 
-		mesh->vertices.resize(info.vertexBufferSize / sizeof(Vertex));
-		assets::unpackMesh(&info, assetFile.binaryBlob.data(), (char*)mesh->vertices.data(), (char*)mesh->indices.data());
-		uploadMesh(mesh);
+	// the blob is the vertex buffer followed by the index buffer, so we unpack it from the
+	// mapped file straight into the upload arena and copy each half into its place in the geometry pool
+	UploadBatch::StagingAllocation staging{ _uploadBatch.allocate(view.unpackedSize) };
+	bool unpacked{ assets::unpackBlob(view, info.compressionMode, staging.data) };
+	assets::unmapBinaryFile(view);
+
+	if (!unpacked) {
+		std::cout << "Error: failed to unpack mesh " << path << "\n";
+		_geometryPool.free(mesh);
+		delete mesh;
+		return;
+	}
 
-	} else if (info.vertexFormat == VertexFormat::SKINNED) {
+	// recorded now, submitted together with every other mesh instead of waiting on each one
+	_uploadBatch.copyBuffer(staging, 0, _geometryPool.vertexBuffer(mesh->vertexFormat), _geometryPool.vertexByteOffset(mesh), info.vertexBufferSize);
+	_uploadBatch.copyBuffer(staging, info.vertexBufferSize, _geometryPool.indexBuffer(), _geometryPool.indexByteOffset(mesh), info.indexBufferSize);
 
-		mesh->verticesSkinned.resize(info.vertexBufferSize / sizeof(VertexSkinned));
-		assets::unpackMesh(&info, assetFile.binaryBlob.data(), (char*)mesh->verticesSkinned.data(), (char*)mesh->indices.data());
-		uploadMeshSkinned(mesh);
+	mesh->sortId = static_cast<uint32_t>(_meshes.size());
+	_meshes[name] = mesh;
+}
 
-	} else {
-		std::cout << "Error: unrecognized vertex format in VulkanEngine::loadMesh\n";
+void VulkanEngine::loadCompressionDictionaries()
+{
+	namespace fs = std::filesystem;
+	std::string dictionariesPath{ "../../asset/assets_export/dictionaries/" };
+
+	// nothing was baked with a dictionary
+	if (!fs::is_directory(dictionariesPath)) {
+		return;
 	}
 
-	_meshes[name] = mesh;
+	for (const auto& file : fs::directory_iterator(dictionariesPath)) {
+		if (file.path().extension() == ".zdict") {
+			assets::loadCompressionDictionary(file.path().generic_string().c_str());
+		}
+	}
 }
 
 void VulkanEngine::loadMeshes()
@@ -633,6 +696,8 @@ void VulkanEngine::loadTexture(const std::string& path, VkFormat format)
 	Texture texture;
 	uint32_t mipLevels;
 	bool hdri{ format == VK_FORMAT_R32G32B32A32_SFLOAT };
+	VkFormat viewFormat{ format };
+	VkComponentMapping components{};
 
 	if (hdri) {
 		std::string prefix{ "../../asset/assets/models/" };
@@ -640,13 +705,15 @@ void VulkanEngine::loadTexture(const std::string& path, VkFormat format)
 			std::cout << "Failed to load texture: " << path << "\n";
 		}
 	} else {
+		// asset textures are decoded and uploaded in the background, until then materials sample a placeholder
 		std::string prefix{ "../../asset/assets_export/models/" };
-		if (!vkutil::loadImageFromAsset(*this, (prefix + path).c_str(), format, &mipLevels, texture.image)) {
-			std::cout << "Failed to load texture: " << path << "\n";
-		}
+		_textureStreamer.requestTexture(path, prefix + path, format);
+		_loadedTextures[path] = _textureStreamer.placeholder();
+		return;
 	}
 
-	VkImageViewCreateInfo imageInfo{ vkinit::imageviewCreateInfo(format, texture.image._image, VK_IMAGE_ASPECT_COLOR_BIT, mipLevels) };
+	VkImageViewCreateInfo imageInfo{ vkinit::imageviewCreateInfo(viewFormat, texture.image._image, VK_IMAGE_ASPECT_COLOR_BIT, mipLevels) };
+	imageInfo.components = components;
 	vkCreateImageView(_device, &imageInfo, nullptr, &texture.imageView);
 
 	_mainDeletionQueue.pushFunction([=]() {
@@ -778,6 +845,7 @@ void VulkanEngine::loadMaterials()
 		}
 		if (info.name != "") {
 			info.bindingTextures = texturesFromBindingPaths(bindingPaths);
+			info.bindingPaths = bindingPaths;
 			initPipeline(info, prefix);
 		}
 
@@ -789,7 +857,7 @@ void VulkanEngine::loadMaterials()
 			bool isCube{ isCubemap == "true" };
 
 			Material* cubemapMat{ getMaterial(cubemapMaterial) };
-			Texture cubemap{ renderToTexture(*this, cubemapMat->textureSet, textureRes, useMip, isCube, cubeVertPath, cubeFragPath) };
+			Texture cubemap{ renderToTexture(*this, cubemapMat->textureSets[0], textureRes, useMip, isCube, cubeVertPath, cubeFragPath) };
 
 			_loadedTextures[cubemapTexName] = cubemap;
 		}
@@ -847,10 +915,6 @@ void VulkanEngine::initPipeline(const MaterialCreateInfo& info, const std::strin
 	});
 
 	std::vector<VkDescriptorSetLayout> setLayouts{ _globalSetLayout, _objectSetLayout, materialSetLayout };
-	// if vertices have joint indices then they must be skinned. So we push back the skin set layout for this material
-	if (info.attributeFlags & ATTR_JOINT_INDICES) {
-		setLayouts.push_back(_skinSetLayout);
-	}
 
 	pipeline_layout_info.pushConstantRangeCount = 1;
 	pipeline_layout_info.pPushConstantRanges = &push_constant;
@@ -896,9 +960,22 @@ void VulkanEngine::initPipeline(const MaterialCreateInfo& info, const std::strin
 		vkinit::pipelineShaderStageCreateInfo(VK_SHADER_STAGE_VERTEX_BIT, vertShader)
 	);
 
-	pipelineBuilder._shaderStages.push_back(
-		vkinit::pipelineShaderStageCreateInfo(VK_SHADER_STAGE_FRAGMENT_BIT, fragShader)
-	);
+	// constant_id 0 picks the shadow filter. Shaders that don't declare it ignore it
+	int32_t shadowFilter{ static_cast<int32_t>(SHADOW_FILTER) };
+	VkSpecializationMapEntry shadowFilterEntry{};
+	shadowFilterEntry.constantID = 0;
+	shadowFilterEntry.offset = 0;
+	shadowFilterEntry.size = sizeof(shadowFilter);
+
+	VkSpecializationInfo specializationInfo{};
+	specializationInfo.mapEntryCount = 1;
+	specializationInfo.pMapEntries = &shadowFilterEntry;
+	specializationInfo.dataSize = sizeof(shadowFilter);
+	specializationInfo.pData = &shadowFilter;
+
+	VkPipelineShaderStageCreateInfo fragStage{ vkinit::pipelineShaderStageCreateInfo(VK_SHADER_STAGE_FRAGMENT_BIT, fragShader) };
+	fragStage.pSpecializationInfo = &specializationInfo;
+	pipelineBuilder._shaderStages.push_back(fragStage);
 
 	VkPipeline pipeline{ pipelineBuilder.buildPipeline(_device, _renderPass, true) };
 
@@ -927,8 +1004,8 @@ size_t VulkanEngine::padUniformBufferSize(size_t originalSize)
 void VulkanEngine::initDescriptorPool() {
 	std::vector<VkDescriptorPoolSize> sizes{
 	{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 10 },
-	{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 10 },
-	{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 10 },
+	{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 50 },
+	{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 40 },
 	{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 100 }
 	};
 
@@ -948,8 +1025,10 @@ void VulkanEngine::initDescriptorPool() {
 void VulkanEngine::initObjectBuffers() {
 	for (auto i{ 0 }; i < FRAME_OVERLAP; ++i) {
 		_frames[i].objectBuffer = createBuffer(sizeof(RenderObject::RenderObjectUB) * MAX_OBJECTS, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+		VK_CHECK(vmaMapMemory(_allocator, _frames[i].objectBuffer._allocation, &_frames[i].objectData));
 
 		_mainDeletionQueue.pushFunction([=]() {
+			vmaUnmapMemory(_allocator, _frames[i].objectBuffer._allocation);
 			vmaDestroyBuffer(_allocator, _frames[i].objectBuffer._buffer, _frames[i].objectBuffer._allocation);
 		});
 	}
@@ -958,11 +1037,16 @@ void VulkanEngine::initObjectBuffers() {
 void VulkanEngine::initDescriptors()
 {
 	// cameraBind needs to be accessed from fragment shader to get camPos
-	VkDescriptorSetLayoutBinding cameraBind{ vkinit::descriptorsetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 0) };
+	VkDescriptorSetLayoutBinding cameraBind{ vkinit::descriptorsetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_VERTEX_BIT, 0) };
 	VkDescriptorSetLayoutBinding sceneBind{ vkinit::descriptorsetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 1) };
 	VkDescriptorSetLayoutBinding shadowMapBind{ vkinit::descriptorsetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 2) };
+	VkDescriptorSetLayoutBinding shadowDepthBind{ vkinit::descriptorsetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 3) };
+	// clustered lights: every light, the light count of each cluster and the clusters' light indices
+	VkDescriptorSetLayoutBinding lightBind{ vkinit::descriptorsetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 4) };
+	VkDescriptorSetLayoutBinding lightGridBind{ vkinit::descriptorsetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 5) };
+	VkDescriptorSetLayoutBinding lightIndexBind{ vkinit::descriptorsetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 6) };
 
-	std::array<VkDescriptorSetLayoutBinding, 3> globalBindings{ cameraBind, sceneBind, shadowMapBind };
+	std::array<VkDescriptorSetLayoutBinding, 7> globalBindings{ cameraBind, sceneBind, shadowMapBind, shadowDepthBind, lightBind, lightGridBind, lightIndexBind };
 
 	VkDescriptorSetLayoutCreateInfo globalSetInfo{};
 	globalSetInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
@@ -980,41 +1064,15 @@ void VulkanEngine::initDescriptors()
 	objectSetInfo.bindingCount = 1;
 	objectSetInfo.pBindings = &objectBind;
 
-	VkDescriptorSetLayoutBinding skinBind{ vkinit::descriptorsetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 0) };
-
-	VkDescriptorSetLayoutCreateInfo skinSetInfo{};
-	skinSetInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-	skinSetInfo.pNext = nullptr;
-	skinSetInfo.flags = 0;
-	skinSetInfo.bindingCount = 1;
-	skinSetInfo.pBindings = &skinBind;
-
 	VK_CHECK(vkCreateDescriptorSetLayout(_device, &globalSetInfo, nullptr, &_globalSetLayout));
 	VK_CHECK(vkCreateDescriptorSetLayout(_device, &objectSetInfo, nullptr, &_objectSetLayout));
-	VK_CHECK(vkCreateDescriptorSetLayout(_device, &skinSetInfo, nullptr, &_skinSetLayout));
 
 	_mainDeletionQueue.pushFunction([=]() {
 		vkDestroyDescriptorSetLayout(_device, _globalSetLayout, nullptr);
 		vkDestroyDescriptorSetLayout(_device, _objectSetLayout, nullptr);
-		vkDestroyDescriptorSetLayout(_device, _skinSetLayout, nullptr);
 	});
 
-	const size_t sceneParamBufferSize{ FRAME_OVERLAP * padUniformBufferSize(sizeof(GPUSceneData)) };
-	_sceneParameterBuffer = createBuffer(sceneParamBufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
-	_mainDeletionQueue.pushFunction([=]() {
-		vmaDestroyBuffer(_allocator, _sceneParameterBuffer._buffer, _sceneParameterBuffer._allocation);
-	});
-
-	// skin descriptor set will be allocated upon loading skin
-
 	for (auto i{ 0 }; i < FRAME_OVERLAP; ++i) {
-
-		_frames[i].cameraBuffer = createBuffer(sizeof(GPUCameraData), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
-
-		_mainDeletionQueue.pushFunction([=]() {
-			vmaDestroyBuffer(_allocator, _frames[i].cameraBuffer._buffer, _frames[i].cameraBuffer._allocation);
-		});
-
 		// allocate one descriptor set for each frame
 		VkDescriptorSetAllocateInfo allocInfo{};
 		allocInfo.pNext = nullptr;
@@ -1034,15 +1092,14 @@ void VulkanEngine::initDescriptors()
 		VK_CHECK(vkAllocateDescriptorSets(_device, &allocInfo, &_frames[i].globalDescriptor));
 		VK_CHECK(vkAllocateDescriptorSets(_device, &objectSetAlloc, &_frames[i].objectDescriptor));
 
-		// information about the buffer we want to point at in the descriptor
+		// camera and scene data are written to the frame allocator every frame and bound with dynamic offsets
 		VkDescriptorBufferInfo cameraInfo{};
-		cameraInfo.buffer = _frames[i].cameraBuffer._buffer;
+		cameraInfo.buffer = _frameAllocator.buffer();
 		cameraInfo.offset = 0;
 		cameraInfo.range = sizeof(GPUCameraData);
 
 		VkDescriptorBufferInfo sceneInfo{};
-		sceneInfo.buffer = _sceneParameterBuffer._buffer;
-		// store scene data for all scenes in the same buffer. camera data is in separate buffer
+		sceneInfo.buffer = _frameAllocator.buffer();
 		sceneInfo.offset = 0;
 		sceneInfo.range = sizeof(GPUSceneData);
 
@@ -1050,18 +1107,31 @@ void VulkanEngine::initDescriptors()
 		// offscreen renderpass that generates shadow map transitions it to this layout once it's finished
 		shadowMapInfo.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
 		shadowMapInfo.imageView = _frames[i].shadow.depth.imageView;
-		shadowMapInfo.sampler = _frames[i].shadow.depthSampler;
+		shadowMapInfo.sampler = _frames[i].shadow.compareSampler;
+
+		// same image, without the comparison
+		VkDescriptorImageInfo shadowDepthInfo{ shadowMapInfo };
+		shadowDepthInfo.sampler = _frames[i].shadow.depthSampler;
 
 		VkDescriptorBufferInfo objectInfo{};
 		objectInfo.buffer = _frames[i].objectBuffer._buffer;
 		objectInfo.offset = 0;
 		objectInfo.range = sizeof(RenderObject::RenderObjectUB) * MAX_OBJECTS;
 
-		VkWriteDescriptorSet cameraWrite{ vkinit::writeDescriptorBuffer(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, _frames[i].globalDescriptor, &cameraInfo, 0) };
+		VkWriteDescriptorSet cameraWrite{ vkinit::writeDescriptorBuffer(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, _frames[i].globalDescriptor, &cameraInfo, 0) };
 		VkWriteDescriptorSet sceneWrite{ vkinit::writeDescriptorBuffer(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, _frames[i].globalDescriptor, &sceneInfo, 1) };
 		VkWriteDescriptorSet shadowMapWrite{ vkinit::writeDescriptorImage(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, _frames[i].globalDescriptor, &shadowMapInfo, 2) };
+		VkWriteDescriptorSet shadowDepthWrite{ vkinit::writeDescriptorImage(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, _frames[i].globalDescriptor, &shadowDepthInfo, 3) };
 		VkWriteDescriptorSet objectWrite{ vkinit::writeDescriptorBuffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, _frames[i].objectDescriptor, &objectInfo, 0) };
-		std::array<VkWriteDescriptorSet, 4> setWrites{ cameraWrite, sceneWrite, shadowMapWrite, objectWrite };
+
+		VkDescriptorBufferInfo lightInfo{ _clusteredLighting.lightBufferInfo(i) };
+		VkDescriptorBufferInfo lightGridInfo{ _clusteredLighting.lightGridInfo(i) };
+		VkDescriptorBufferInfo lightIndexInfo{ _clusteredLighting.lightIndexInfo(i) };
+		VkWriteDescriptorSet lightWrite{ vkinit::writeDescriptorBuffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, _frames[i].globalDescriptor, &lightInfo, 4) };
+		VkWriteDescriptorSet lightGridWrite{ vkinit::writeDescriptorBuffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, _frames[i].globalDescriptor, &lightGridInfo, 5) };
+		VkWriteDescriptorSet lightIndexWrite{ vkinit::writeDescriptorBuffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, _frames[i].globalDescriptor, &lightIndexInfo, 6) };
+
+		std::array<VkWriteDescriptorSet, 8> setWrites{ cameraWrite, sceneWrite, shadowMapWrite, shadowDepthWrite, objectWrite, lightWrite, lightGridWrite, lightIndexWrite };
 		vkUpdateDescriptorSets(_device, setWrites.size(), setWrites.data(), 0, nullptr);
 	}
 }
@@ -1122,8 +1192,8 @@ void VulkanEngine::initDefaultRenderpass()
 	// we don't care about stencil
 	color_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 	color_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-	// we don't know or care about the starting layout of the attachment
-	color_attachment.initialLayout - VK_IMAGE_LAYOUT_UNDEFINED;
+	// the render graph transitions every attachment into its subpass layout before the pass, and out of it after
+	color_attachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 	// This attachment won't be presented, it will be resolved to the swapchain image
 	color_attachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
@@ -1141,7 +1211,7 @@ void VulkanEngine::initDefaultRenderpass()
 	depth_attachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
 	depth_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
 	depth_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-	depth_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	depth_attachment.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 	depth_attachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 
 	VkAttachmentReference depth_attachment_ref{};
@@ -1156,8 +1226,9 @@ void VulkanEngine::initDefaultRenderpass()
 	color_attachment_resolve.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
 	color_attachment_resolve.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 	color_attachment_resolve.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-	color_attachment_resolve.initialLayout - VK_IMAGE_LAYOUT_UNDEFINED;
-	color_attachment_resolve.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	color_attachment_resolve.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	// the render graph transitions it to present after the pass
+	color_attachment_resolve.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
 	VkAttachmentReference color_attachment_resolve_ref{};
 	color_attachment_resolve_ref.attachment = 2;
@@ -1180,25 +1251,9 @@ void VulkanEngine::initDefaultRenderpass()
 	render_pass_info.subpassCount = 1;
 	render_pass_info.pSubpasses = &subpass;
 
-	// added for shadow map:
-	std::array<VkSubpassDependency, 2> dependencies{};
-
-	dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
-	dependencies[0].dstSubpass = 0;
-	dependencies[0].srcStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
-	dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-	dependencies[0].srcAccessMask = VK_ACCESS_MEMORY_READ_BIT;
-	dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-
-	dependencies[1].srcSubpass = 0;
-	dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
-	dependencies[1].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-	dependencies[1].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
-	dependencies[1].dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
-	dependencies[1].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
-
-	render_pass_info.dependencyCount = dependencies.size();
-	render_pass_info.pDependencies = dependencies.data();
+	// no external dependencies, the render graph puts barriers between the passes
+	render_pass_info.dependencyCount = 0;
+	render_pass_info.pDependencies = nullptr;
 
 	VK_CHECK(vkCreateRenderPass(_device, &render_pass_info, nullptr, &_renderPass));
 
@@ -1207,43 +1262,6 @@ void VulkanEngine::initDefaultRenderpass()
 	});
 }
 
-void VulkanEngine::initFramebuffers(bool windowResize)
-{
-	// the framebuffer will connect the renderpass to the images for rendering
-	VkFramebufferCreateInfo fb_info{};
-	fb_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-	fb_info.pNext = nullptr;
-	fb_info.renderPass = _renderPass;
-	fb_info.width = _windowExtent.width;
-	fb_info.height = _windowExtent.height;
-	fb_info.layers = 1;
-
-	// grab how many images we have in the swapchain
-	const uint32_t swapchain_imagecount{ (uint32_t)_swapchainImages.size() };
-	_framebuffers = std::vector<VkFramebuffer>(swapchain_imagecount);
-
-	// create framebuffers for each of the swapchain image views
-	for (auto i{ 0 }; i < swapchain_imagecount; ++i) {
-
-		std::array<VkImageView, 3> attachments{
-			_colorImageView,
-			_depthImageView,
-			_swapchainImageViews[i],
-		};
-
-		fb_info.attachmentCount = attachments.size();
-		fb_info.pAttachments = attachments.data();
-		VK_CHECK(vkCreateFramebuffer(_device, &fb_info, nullptr, &_framebuffers[i]));
-
-		if (!windowResize) {
-			_mainDeletionQueue.pushFunction([=]() {
-				vkDestroyFramebuffer(_device, _framebuffers[i], nullptr);
-				vkDestroyImageView(_device, _swapchainImageViews[i], nullptr);
-			});
-		}
-	}
-}
-
 void VulkanEngine::initCommands()
 {
 	// create a command pool for commands submitted to the graphics queue
@@ -1268,6 +1286,20 @@ void VulkanEngine::initCommands()
 		_mainDeletionQueue.pushFunction([=]() {
 			vkDestroyCommandPool(_device, _frames[i].commandPool, nullptr);
 		});
+
+		// secondary buffers are only reset all at once with their pool
+		VkCommandPoolCreateInfo workerPoolInfo{ vkinit::commandPoolCreateInfo(_graphicsQueueFamily, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT) };
+
+		_frames[i].workerCommandPools.resize(_jobSystem.threadCount());
+		for (SecondaryCommandPool& workerPool : _frames[i].workerCommandPools) {
+			VK_CHECK(vkCreateCommandPool(_device, &workerPoolInfo, nullptr, &workerPool.pool));
+			workerPool.used = 0;
+
+			VkCommandPool pool{ workerPool.pool };
+			_mainDeletionQueue.pushFunction([=]() {
+				vkDestroyCommandPool(_device, pool, nullptr);
+			});
+		}
 	}
 }
 
@@ -1294,51 +1326,17 @@ void VulkanEngine::initSwapchain(VkSwapchainKHR oldSwapChain)
 		_mainDeletionQueue.pushFunction([=]() {
 			vkDestroySwapchainKHR(_device, _swapchain, nullptr);
 		});
-	}
-
-	// depth image size will match the window
-	VkExtent3D depthImageExtent{
-		_windowExtent.width,
-		_windowExtent.height,
-		1
-	};
-
-	// hardcoding the depth format to the 32 bit float
-	_depthFormat = VK_FORMAT_D32_SFLOAT;
-
-	// the depth image will be an image with the format we selected and Depth Attachment usage flag
-	VkImageCreateInfo dimg_info{ vkinit::imageCreateInfo(_depthFormat, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, depthImageExtent, 1, _msaaSamples) };
-	VkImageCreateInfo color_img_info{ vkinit::imageCreateInfo(vkbSwapchain.image_format, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, depthImageExtent, 1, _msaaSamples) };
-
-
-	// for the depth image, we want to allocate it from GPU local memory
-	VmaAllocationCreateInfo dimg_allocinfo{};
-	dimg_allocinfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
-	dimg_allocinfo.requiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
-
-	VmaAllocationCreateInfo color_img_allocinfo{};
-	color_img_allocinfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
-	color_img_allocinfo.requiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
 
-	// allocate and create the image
-	vmaCreateImage(_allocator, &dimg_info, &dimg_allocinfo, &_depthImage._image, &_depthImage._allocation, nullptr);
-	vmaCreateImage(_allocator, &color_img_info, &color_img_allocinfo, &_colorImage._image, &_colorImage._allocation, nullptr);
-
-	// build an imageView for the depth image to use for rendering
-	VkImageViewCreateInfo dview_info{ vkinit::imageviewCreateInfo(_depthFormat, _depthImage._image, VK_IMAGE_ASPECT_DEPTH_BIT, 1) };
-	VkImageViewCreateInfo color_view_info{ vkinit::imageviewCreateInfo(vkbSwapchain.image_format, _colorImage._image, VK_IMAGE_ASPECT_COLOR_BIT, 1) };
-
-	VK_CHECK(vkCreateImageView(_device, &dview_info, nullptr, &_depthImageView));
-	VK_CHECK(vkCreateImageView(_device, &color_view_info, nullptr, &_colorImageView));
-
-	if (oldSwapChain == VK_NULL_HANDLE) {
 		_mainDeletionQueue.pushFunction([=]() {
-			vkDestroyImageView(_device, _colorImageView, nullptr);
-			vkDestroyImageView(_device, _depthImageView, nullptr);
-			vmaDestroyImage(_allocator, _colorImage._image, _colorImage._allocation);
-			vmaDestroyImage(_allocator, _depthImage._image, _depthImage._allocation);
+			for (VkImageView view : _swapchainImageViews) {
+				vkDestroyImageView(_device, view, nullptr);
+			}
 		});
 	}
+
+	// hardcoding the depth format to the 32 bit float. The depth and MSAA color images themselves are
+	// transient images of the render graph
+	_depthFormat = VK_FORMAT_D32_SFLOAT;
 }
 
 void VulkanEngine::initVulkan()
@@ -1363,6 +1361,11 @@ void VulkanEngine::initVulkan()
 
 	VkPhysicalDeviceFeatures features{};
 	features.sampleRateShading = VK_TRUE;
+	// baked textures are BC4/BC5/BC7
+	features.textureCompressionBC = VK_TRUE;
+	// main pass draws are issued from GPU written indirect commands, with the object index in firstInstance
+	features.multiDrawIndirect = VK_TRUE;
+	features.drawIndirectFirstInstance = VK_TRUE;
 
 	// use vkbootstrap to select a gpu.
 	// we want a gpu that can write to the SDL surface and supports Vulkan 1.1
@@ -1371,13 +1374,22 @@ void VulkanEngine::initVulkan()
 		.set_minimum_version(1, 1)
 		.set_surface(_surface)
 		.set_required_features(features)
+		.add_desired_extension(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME) // core in 1.2, so only an extension for us
+		.add_required_extension(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME) // texture streaming orders uploads by semaphore value, also core in 1.2
 		.select()
 		.value() };
 
+	VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timelineFeatures{};
+	timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+	timelineFeatures.pNext = nullptr;
+	timelineFeatures.timelineSemaphore = VK_TRUE;
 
 	// create the final Vulkan device
 	vkb::DeviceBuilder deviceBuilder{ physicalDevice };
-	vkb::Device vkbDevice{ deviceBuilder.build().value() };
+	vkb::Device vkbDevice{ deviceBuilder
+		.add_pNext(&timelineFeatures)
+		.build()
+		.value() };
 
 	// get the VKDevice handle used in the rest of a Vulkan application
 	_device = vkbDevice.device;
@@ -1390,6 +1402,16 @@ void VulkanEngine::initVulkan()
 	_graphicsQueue = vkbDevice.get_queue(vkb::QueueType::graphics).value();
 	_graphicsQueueFamily = vkbDevice.get_queue_index(vkb::QueueType::graphics).value();
 
+	// a transfer only queue family lets texture uploads run alongside rendering
+	auto transferQueue{ vkbDevice.get_dedicated_queue(vkb::QueueType::transfer) };
+	if (transferQueue.has_value()) {
+		_transferQueue = transferQueue.value();
+		_transferQueueFamily = vkbDevice.get_dedicated_queue_index(vkb::QueueType::transfer).value();
+	} else {
+		_transferQueue = _graphicsQueue;
+		_transferQueueFamily = _graphicsQueueFamily;
+	}
+
 	VmaAllocatorCreateInfo allocatorInfo{};
 	allocatorInfo.physicalDevice = _chosenGPU;
 	allocatorInfo.device = _device;
@@ -1460,6 +1482,12 @@ void VulkanEngine::cleanup()
 
 		vkQueueWaitIdle(_graphicsQueue);
 
+		_jobSystem.cleanup();
+		_textureStreamer.cleanup();
+		_uploadBatch.cleanup();
+		_geometryPool.cleanup();
+		_frameAllocator.cleanup();
+		_renderGraph.cleanup();
 		_mainDeletionQueue.flush();
 
 		vkDestroySurfaceKHR(_instance, _surface, nullptr);
@@ -1500,15 +1528,26 @@ Material* VulkanEngine::createMaterial(const MaterialCreateInfo& info, VkPipelin
 	Material mat{};
 	mat.pipeline = pipeline;
 	mat.pipelineLayout = layout;
+	mat.sortId = static_cast<uint32_t>(_materials.size());
+
+	// materials sharing a pipeline share its id, so they sort next to each other
+	auto pipelineId{ _pipelineSortIds.find(pipeline) };
+	if (pipelineId == _pipelineSortIds.end()) {
+		pipelineId = _pipelineSortIds.emplace(pipeline, static_cast<uint32_t>(_pipelineSortIds.size())).first;
+	}
+	mat.pipelineSortId = pipelineId->second;
+
+	std::vector<VkDescriptorSetLayout> setLayouts(FRAME_OVERLAP, materialSetLayout);
+	mat.textureSets.resize(FRAME_OVERLAP);
 
 	VkDescriptorSetAllocateInfo allocInfo{};
 	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
 	allocInfo.pNext = nullptr;
 	allocInfo.descriptorPool = _descriptorPool;
-	allocInfo.descriptorSetCount = 1;
-	allocInfo.pSetLayouts = &materialSetLayout;
+	allocInfo.descriptorSetCount = FRAME_OVERLAP;
+	allocInfo.pSetLayouts = setLayouts.data();
 
-	VK_CHECK(vkAllocateDescriptorSets(_device, &allocInfo, &mat.textureSet));
+	VK_CHECK(vkAllocateDescriptorSets(_device, &allocInfo, mat.textureSets.data()));
 
 	for (auto i{ 0 }; i < info.bindings.size(); ++i) {
 		const Texture& texture{ info.bindingTextures[i] };
@@ -1525,9 +1564,15 @@ Material* VulkanEngine::createMaterial(const MaterialCreateInfo& info, VkPipelin
 		imageBufferInfo.imageView = texture.imageView;
 		imageBufferInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
-		VkWriteDescriptorSet textureWrite{ vkinit::writeDescriptorImage(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, mat.textureSet, &imageBufferInfo, i) };
+		for (VkDescriptorSet textureSet : mat.textureSets) {
+			VkWriteDescriptorSet textureWrite{ vkinit::writeDescriptorImage(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, textureSet, &imageBufferInfo, i) };
 
-		vkUpdateDescriptorSets(_device, 1, &textureWrite, 0, nullptr);
+			vkUpdateDescriptorSets(_device, 1, &textureWrite, 0, nullptr);
+		}
+
+		if (i < info.bindingPaths.size()) {
+			_textureStreamer.addDescriptorBinding(info.bindingPaths[i], mat.textureSets, i);
+		}
 	}
 
 	_materials[info.name] = mat;
@@ -1578,75 +1623,146 @@ void VulkanEngine::initShadowPass()
 	_shadowGlobal.width = SHADOWMAP_DIM;
 	_shadowGlobal.height = SHADOWMAP_DIM;
 
-	prepareShadowMapRenderpass(*this, &_shadowGlobal.renderPass);
+	prepareShadowMapRenderpass(*this, VK_ATTACHMENT_LOAD_OP_CLEAR, &_shadowGlobal.renderPass);
+	prepareShadowMapRenderpass(*this, VK_ATTACHMENT_LOAD_OP_LOAD, &_shadowGlobal.loadRenderPass);
+	prepareShadowCache(*this, &_shadowGlobal);
 
 	std::vector<VkDescriptorSetLayout> setLayouts{};
-	std::vector<VkDescriptorSetLayout> setLayoutsSkinned{};
 	setupShadowDescriptorSetLayouts(*this, setLayouts, &_shadowGlobal.shadowPipelineLayout);
-	setupShadowDescriptorSetLayoutsSkinned(*this, setLayoutsSkinned, &_shadowGlobal.shadowPipelineLayoutSkinned);
-
-	_shadowGlobal.shadowJointSetLayout = setLayoutsSkinned[2];
 
+	// skinned meshes are already skinned by ComputeSkinning, so they use the same pipeline
 	initShadowPipeline(*this, _shadowGlobal.renderPass, _shadowGlobal.shadowPipelineLayout, &_shadowGlobal.shadowPipeline);
-	initShadowPipelineSkinned(*this, _shadowGlobal.renderPass, _shadowGlobal.shadowPipelineLayoutSkinned, &_shadowGlobal.shadowPipelineSkinned);
 
 	for (auto i{ 0 }; i < FRAME_OVERLAP; ++i) {
 		ShadowFrameResources& shadowFrame{ _frames[i % FRAME_OVERLAP].shadow };
 
 		prepareShadowMapFramebuffer(*this, _shadowGlobal, &shadowFrame);
 
-		shadowFrame.shadowLightBuffer = createBuffer(sizeof(glm::mat4), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
-		_mainDeletionQueue.pushFunction([=]() {
-			vmaDestroyBuffer(_allocator, shadowFrame.shadowLightBuffer._buffer, shadowFrame.shadowLightBuffer._allocation);
-		});
-
 		// Set up all global shadow descriptor sets common to all shadows.
-		// We set up the skinned descriptor set when we load the skin in loadSkeletalAnimation, since it's a per-skin descriptor set.
 		setupShadowDescriptorSetsGlobal(*this, shadowFrame, _frames[i].objectBuffer._buffer, setLayouts);
 	}
 }
 
-// Minimal bounding sphere of view frustum. Only needs to be called when window is resized
-// or at startup. From:
+// Split the view frustum up to FAR_PLANE_SHADOW into cascades and find each slice's minimal bounding sphere.
+// Only needs to be called when window is resized or at startup. Sphere from:
 // https://lxjk.github.io/2017/04/15/Calculate-Minimal-Bounding-Sphere-of-Frustum.html
-void VulkanEngine::initBoundingSphere() {
+void VulkanEngine::initShadowCascades() {
 	float widthHeightRatio{ _windowExtent.height / (float)_windowExtent.width };
 	float k{ std::sqrtf(1.0f + widthHeightRatio * widthHeightRatio) * std::tanf(glm::radians(FOV) / 2.0) };
 	float k2{ k * k };
-	float n{ NEAR_PLANE };
-	float f{ FAR_PLANE_SHADOW };
 
-	if (k2 >= (f - n) / (f + n)) {
-		_boundingSphereZ = -f;
-		_boundingSphereR = f * k;
-	} else {
-		_boundingSphereZ = -0.5f * (f + n) * (1 + k2);
-		_boundingSphereR = 0.5f * std::sqrtf((f - n) * (f - n) + 2 * (f * f + n * n) * k2 + (f + n) * (f + n) * k2 * k2);
+	float splitNear{ NEAR_PLANE };
+	for (uint32_t c{ 0 }; c < SHADOW_CASCADES; ++c) {
+		// practical split scheme, logarithmic splits keep the texel density even but leave the first cascade tiny
+		float p{ (c + 1) / (float)SHADOW_CASCADES };
+		float logSplit{ NEAR_PLANE * std::powf(FAR_PLANE_SHADOW / NEAR_PLANE, p) };
+		float uniformSplit{ NEAR_PLANE + (FAR_PLANE_SHADOW - NEAR_PLANE) * p };
+
+		ShadowCascade& cascade{ _shadowGlobal.cascades[c] };
+		// the sphere changes size with the window, so the region is placed again from scratch
+		cascade.regionValid = false;
+		cascade.splitNear = splitNear;
+		cascade.splitFar = CASCADE_SPLIT_LAMBDA * logSplit + (1.0f - CASCADE_SPLIT_LAMBDA) * uniformSplit;
+		splitNear = cascade.splitFar;
+
+		float n{ cascade.splitNear };
+		float f{ cascade.splitFar };
+
+		if (k2 >= (f - n) / (f + n)) {
+			cascade.sphereZ = -f;
+			cascade.sphereR = f * k;
+		} else {
+			cascade.sphereZ = -0.5f * (f + n) * (1 + k2);
+			cascade.sphereR = 0.5f * std::sqrtf((f - n) * (f - n) + 2 * (f * f + n * n) * k2 + (f + n) * (f + n) * k2 * k2);
+		}
 	}
 }
 
 // First render pass: Generate shadow map by rendering the scene from light's POV
-void VulkanEngine::shadowPass(VkCommandBuffer& cmd)
+void VulkanEngine::prepareShadowPass()
 {
-	VkClearValue clearValue{};
-	clearValue.color = { {1.00, 0.00, 0.00, 1.0} };
+	glm::vec3 dir{ glm::normalize(glm::vec3{ -4.0f, -8.0f, -2.0f }) };
+	glm::mat4 rotate{ glm::rotation(glm::vec3{ 0.0, 0.0, -1.0 }, dir) };
+	const std::vector<RenderObject>& objects{ _renderables.objects() };
+	uint64_t staticVersion{ _renderables.staticVersion() };
+
+	for (uint32_t c{ 0 }; c < SHADOW_CASCADES; ++c) {
+		ShadowCascade& cascade{ _shadowGlobal.cascades[c] };
+
+		// the cascade covers its slice's bounding sphere plus a margin on every side, in the light's plane and along it
+		float margin{ CASCADE_SCROLL_MARGIN * cascade.sphereR };
+		float scale{ cascade.sphereR + margin };
+
+		float near_plane{ 0.0f };
+		float far_plane{ 2.0f * scale };
+		glm::mat4 lightProjection{ vkutil::ortho(-scale, scale, -scale, scale, near_plane, far_plane) };
+
+		glm::vec3 center{ 0.0, 0.0, cascade.sphereZ };
+		center = _viewInv * glm::vec4{ center, 1.0f };
+
+		// The region only scrolls once the sphere is about to leave it, so while the camera moves or turns
+		// within the margin the light matrix doesn't change and the cached static depth is reused
+		glm::vec3 lightCenter{ glm::transpose(rotate) * glm::vec4{ center, 0.0f } };
+		glm::vec3 offset{ glm::abs(lightCenter - cascade.regionCenter) };
+		if (!cascade.regionValid || std::max({ offset.x, offset.y, offset.z }) > margin) {
+			// whole texels in every direction, so the shadow edges don't shimmer when it scrolls
+			float texelSize{ 2.0f * scale / _shadowGlobal.width };
+			cascade.regionCenter = glm::round(lightCenter / texelSize) * texelSize;
+			cascade.regionValid = true;
+		}
+		center = rotate * glm::vec4{ cascade.regionCenter, 0.0f };
 
-	VkClearValue depthClear{};
-	depthClear.depthStencil.depth = 1.0f;
+		float halfLength{ (far_plane - near_plane) / 2.0f };
+
+		glm::mat4 translate{ glm::translate(center - halfLength * dir) };
+		glm::mat4 lightView{ translate * rotate };
+		lightView = glm::inverse(lightView);
 
-	std::array<VkClearValue, 2> clearValues{ clearValue, depthClear };
+		cascade.lightSpaceMatrix = lightProjection * lightView;
 
-	VkRenderPassBeginInfo renderPassBeginInfo{};
-	renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-	renderPassBeginInfo.pNext = nullptr;
-	renderPassBeginInfo.renderPass = _shadowGlobal.renderPass;
-	renderPassBeginInfo.framebuffer = getCurrentFrame().shadow.frameBuffer;
-	renderPassBeginInfo.renderArea.extent.width = _shadowGlobal.width;
-	renderPassBeginInfo.renderArea.extent.height = _shadowGlobal.height;
-	renderPassBeginInfo.clearValueCount = 1;
-	renderPassBeginInfo.pClearValues = clearValues.data();
+		getCurrentFrame().shadow.lightOffsets[c] = _frameAllocator.push(cascade.lightSpaceMatrix);
 
-	vkCmdBeginRenderPass(cmd, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+		// the light projection is orthographic with a finite far plane. Casters between the light and the near
+		// plane are pancaked onto it by depth.vert and still cast shadows, so the near plane isn't tested
+		{
+			ZoneScopedN("cull_shadow_casters");
+			_worldBounds.cull(extractFrustum(cascade.lightSpaceMatrix, false, false), _shadowVisible);
+		}
+
+		// the cached static depth is only good for the light matrix and static objects it was drawn with,
+		// so it's redrawn when the region scrolls, the light moves or a static object changes
+		cascade.redrawCache = !cascade.cacheValid || cascade.cacheMatrix != cascade.lightSpaceMatrix || cascade.cacheStaticVersion != staticVersion;
+		cascade.cacheValid = true;
+		cascade.cacheMatrix = cascade.lightSpaceMatrix;
+		cascade.cacheStaticVersion = staticVersion;
+
+		DrawList& dynamicList{ _shadowDrawLists[c] };
+		DrawList& staticList{ _staticShadowDrawLists[c] };
+		dynamicList.clear();
+		staticList.clear();
+		for (uint32_t idx{ 0 }; idx < _worldBounds.size(); ++idx) {
+			if (!objects[idx].castShadow || !_shadowVisible[idx]) {
+				continue;
+			}
+
+			// depth doesn't matter for a depth only pass, only state changes
+			uint64_t key{ makeSortKey(DrawPass::SHADOW, objects[idx], 0.0f) };
+			// animated objects change shape even if they stay in place
+			if (!objects[idx].isStatic || objects[idx].animated()) {
+				dynamicList.add(key, idx);
+			} else if (cascade.redrawCache) {
+				staticList.add(key, idx);
+			}
+		}
+		dynamicList.sort();
+		staticList.sort();
+	}
+}
+
+// Runs on job system threads. cmd is a secondary command buffer, so none of the state is inherited
+void VulkanEngine::shadowPass(VkCommandBuffer cmd, uint32_t cascade, const DrawList& drawList, uint32_t first, uint32_t count)
+{
+	ZoneScoped;
 
 	VkViewport viewport{};
 	viewport.width = (float)_shadowGlobal.width;
@@ -1664,78 +1780,34 @@ void VulkanEngine::shadowPass(VkCommandBuffer& cmd)
 	scissor.offset.y = 0;
 	vkCmdSetScissor(cmd, 0, 1, &scissor);
 
-	float near_plane{ 0.0f };
-	float far_plane{ 2.0f * _boundingSphereR };
-
-	float scale{ _boundingSphereR };
-	glm::mat4 lightProjection{ vkutil::ortho(-scale, scale, -scale, scale, near_plane, far_plane) };
-
-	glm::vec3 center{ 0.0, 0.0, _boundingSphereZ };
-	center = _viewInv * glm::vec4{ center, 1.0f };
-	glm::vec3 dir{ glm::normalize(glm::vec3{ -4.0f, -8.0f, -2.0f }) };
-
-	float halfLength{ (far_plane - near_plane) / 2.0f };
-
-	glm::mat4 rotate{ glm::rotation(glm::vec3{ 0.0, 0.0, -1.0 }, dir) };
-	//glm::mat4 translate{ glm::translate(glm::vec3{ 4.0f, 8.0f, 2.0f }) };
-	glm::mat4 translate{ glm::translate(center - halfLength * dir) };
-	glm::mat4 lightView{ translate * rotate };
-	lightView = glm::inverse(lightView);
-
-	_shadowGlobal.lightSpaceMatrix = lightProjection * lightView;
-
-	void* data;
-	vmaMapMemory(_allocator, getCurrentFrame().shadow.shadowLightBuffer._allocation, &data);
-	std::memcpy(data, &_shadowGlobal.lightSpaceMatrix, sizeof(glm::mat4));
-	vmaUnmapMemory(_allocator, getCurrentFrame().shadow.shadowLightBuffer._allocation);
-
 	// Set depth bias (aka "Polygon offset")
 	// Required to avoid shadow mapping artifacts
 	vkCmdSetDepthBias(cmd, _shadowGlobal.depthBiasConstant, 0.0f, _shadowGlobal.depthBiasSlope);
 
 	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, _shadowGlobal.shadowPipeline);
-	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, _shadowGlobal.shadowPipelineLayout, 0, 1, &getCurrentFrame().shadow.shadowDescriptorSetLight, 0, nullptr);
+	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, _shadowGlobal.shadowPipelineLayout, 0, 1, &getCurrentFrame().shadow.shadowDescriptorSetLight, 1, &getCurrentFrame().shadow.lightOffsets[cascade]);
 	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, _shadowGlobal.shadowPipelineLayout, 1, 1, &getCurrentFrame().shadow.shadowDescriptorSetObjects, 0, nullptr);
 
-	Mesh* lastMesh{ nullptr };
-	bool lastSkinned{ false };
-
-	uint32_t idx{ 0 };
-	for (const RenderObject& object : _renderables) {
+	// every mesh lives in the geometry pool, so buffers only change with the vertex format
+	vkCmdBindIndexBuffer(cmd, _geometryPool.indexBuffer(), 0, VK_INDEX_TYPE_UINT16);
+	VertexFormat lastFormat{ VertexFormat::Unknown };
 
-		// DO NOT change this to continue if !object.castShadow, because we need to increment idx still
-		if (object.castShadow) {
-			bool isSkinned{ object.mesh->vertexFormat == VertexFormat::SKINNED };
+	const std::vector<uint32_t>& indices{ drawList.objectIndices() };
+	for (uint32_t i{ first }; i < first + count; ++i) {
+		uint32_t idx{ indices[i] };
+		const RenderObject& object{ _renderables.objects()[idx] };
 
-			if (lastSkinned != isSkinned) {
-				VkPipeline pipeline{ isSkinned ? _shadowGlobal.shadowPipelineSkinned : _shadowGlobal.shadowPipeline };
-				vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
-
-				lastSkinned = isSkinned;
-			}
-
-			if (isSkinned) {
-				vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, _shadowGlobal.shadowPipelineLayoutSkinned, 2, 1, &object.mesh->skel.skins[0].jointsShadowDescriptorSet, 0, nullptr);
-			}
-
-			// only bind the mesh if it's a different one from last bind
-			if (object.mesh != lastMesh) {
-				// bind the mesh vertex buffer with offset 0
-				VkDeviceSize offset{ 0 };
-				vkCmdBindVertexBuffers(cmd, 0, 1, &object.mesh->vertexBuffer._buffer, &offset);
-				vkCmdBindIndexBuffer(cmd, object.mesh->indexBuffer._buffer, 0, VK_INDEX_TYPE_UINT16);
-
-				lastMesh = object.mesh;
-			}
+		if (object.mesh->vertexFormat != lastFormat) {
+			VkBuffer vertexBuffer{ drawVertexBuffer(object.mesh->vertexFormat) };
+			VkDeviceSize offset{ 0 };
+			vkCmdBindVertexBuffers(cmd, 0, 1, &vertexBuffer, &offset);
 
-			//vkCmdDraw(cmd, object.mesh->_vertices.size(), 1, 0, idx);
-			vkCmdDrawIndexed(cmd, object.mesh->indices.size(), 1, 0, 0, idx);
+			lastFormat = object.mesh->vertexFormat;
 		}
 
-		++idx;
+		// firstInstance is the object's index in the SSBO
+		vkCmdDrawIndexed(cmd, object.mesh->indexCount, 1, object.mesh->firstIndex, object.vertexOffset(), idx);
 	}
-
-	vkCmdEndRenderPass(cmd);
 }
 
 void VulkanEngine::cameraTransformation()
@@ -1755,12 +1827,35 @@ void VulkanEngine::cameraTransformation()
 	camData.viewProjOrigin = projection * viewOrigin; // for skybox
 	camData.projection = projection;
 	camData.viewProj = projection * view;
+	_viewProj = camData.viewProj;
 
-	// copy camera data to camera buffer
-	void* data;
-	vmaMapMemory(_allocator, getCurrentFrame().cameraBuffer._allocation, &data);
-	std::memcpy(data, &camData, sizeof(GPUCameraData));
-	vmaUnmapMemory(_allocator, getCurrentFrame().cameraBuffer._allocation);
+	getCurrentFrame().cameraOffset = _frameAllocator.push(camData);
+}
+
+void VulkanEngine::updateAnimations(uint32_t objectCount)
+{
+	ZoneScoped;
+	std::vector<RenderObject>& objects{ _renderables.objects() };
+
+	_animatedObjects.clear();
+	for (uint32_t idx{ 0 }; idx < objectCount; ++idx) {
+		if (objects[idx].animated()) {
+			_animatedObjects.push_back(idx);
+		}
+	}
+
+	uint32_t animatedCount{ static_cast<uint32_t>(_animatedObjects.size()) };
+	uint32_t jobCount{ (animatedCount + ANIMATIONS_PER_JOB - 1) / ANIMATIONS_PER_JOB };
+
+	_jobSystem.parallelFor(jobCount, [&](uint32_t jobIndex, uint32_t threadIndex) {
+		ZoneScopedN("animation_job");
+		uint32_t first{ jobIndex * ANIMATIONS_PER_JOB };
+		uint32_t last{ std::min(first + ANIMATIONS_PER_JOB, animatedCount) };
+
+		for (uint32_t i{ first }; i < last; ++i) {
+			objects[_animatedObjects[i]].updateAnimation(_delta);
+		}
+	});
 }
 
 void VulkanEngine::draw()
@@ -1771,6 +1866,21 @@ void VulkanEngine::draw()
 
 	// wait until the gpu has finished rendering the last frame. Timeout of 1 second
 	VK_CHECK(vkWaitForFences(_device, 1, &getCurrentFrame().renderFence, true, 1'000'000'000));
+
+	// the GPU is done with this frame's transient uniforms
+	_frameAllocator.beginFrame(_frameNumber % FRAME_OVERLAP);
+
+	// publish streamed textures into this frame's material sets, the GPU is done with them
+	std::vector<VkSemaphore> waitSemaphores{ getCurrentFrame().presentSemaphore };
+	std::vector<VkPipelineStageFlags> waitStages{ VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
+	// binary semaphores ignore their wait value
+	std::vector<uint64_t> waitValues{ 0 };
+	_textureStreamer.update(waitSemaphores, waitValues);
+	waitStages.resize(waitSemaphores.size(), VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+
+	// uploads recorded since last frame are submitted ahead of the frame that draws with them
+	_uploadBatch.submit();
+
 	VK_CHECK(vkResetFences(_device, 1, &getCurrentFrame().renderFence));
 
 	// request image from the swapchain, one second timeout. This is also where vsync happens according to vkguide, but for me it happens at present
@@ -1779,6 +1889,10 @@ void VulkanEngine::draw()
 
 	// now that we are sure that the commands finished executing, we can safely reset the command buffer to begin recording again
 	VK_CHECK(vkResetCommandBuffer(getCurrentFrame().mainCommandBuffer, 0));
+	for (SecondaryCommandPool& workerPool : getCurrentFrame().workerCommandPools) {
+		VK_CHECK(vkResetCommandPool(_device, workerPool.pool, 0));
+		workerPool.used = 0;
+	}
 
 	// begin the command buffer recording. We will use this command buffer exactly once, so we want to let Vulkan know that
 	VkCommandBufferBeginInfo cmdBeginInfo{};
@@ -1790,83 +1904,84 @@ void VulkanEngine::draw()
 	// Assume _camTransform and _sceneParamters lights are updated here if they need to be
 	_app->update(*this, _delta);
 
-	// write all the objects' matrices into the SSBO (used in both shadow pass and draw objects)
-	void* objectData;
-	vmaMapMemory(_allocator, getCurrentFrame().objectBuffer._allocation, &objectData);
-	RenderObject::RenderObjectUB* objectSSBO{ (RenderObject::RenderObjectUB*)objectData };
-	uint32_t idx{ 0 };
-	for (const RenderObject& object : _renderables) {
-		if (object.animated()) {
-			object.updateAnimation(_delta);
-		}
-		objectSSBO[idx] = object.uniformBlock;
-		++idx;
-	}
-	vmaUnmapMemory(_allocator, getCurrentFrame().objectBuffer._allocation);
-	vmaFlushAllocation(_allocator, getCurrentFrame().objectBuffer._allocation, 0, VK_WHOLE_SIZE);
+	// write the objects' matrices that changed into the SSBO (used in both shadow pass and draw objects)
+	updateObjectBuffer();
 
-	VK_CHECK(vkBeginCommandBuffer(getCurrentFrame().mainCommandBuffer, &cmdBeginInfo));
+	// the SSBO index of an object is its dense index in _renderables
+	std::vector<RenderObject>& objects{ _renderables.objects() };
+	uint32_t objectCount{ std::min(_renderables.size(), MAX_OBJECTS) };
 
-	cameraTransformation();
-	shadowPass(getCurrentFrame().mainCommandBuffer);
+	updateAnimations(objectCount);
 
-	VkClearValue clearValue{};
-	clearValue.color = { {0.0, 0.0, 0.1, 1.0} };
+	_worldBounds.clear();
+	_mainDrawList.clear();
+	for (uint32_t idx{ 0 }; idx < objectCount; ++idx) {
+		RenderObject& object{ objects[idx] };
+		// joint matrices are transient, so every skin is written each frame even if it isn't animated
+		for (size_t s{ 0 }; s < object.animation.joints.size(); ++s) {
+			object.animation.jointOffsets[s] = _frameAllocator.push(object.animation.joints[s]);
+		}
+		_worldBounds.push(object.mesh->bounds, object.uniformBlock.transformMatrix);
 
-	VkClearValue depthClear{};
-	depthClear.depthStencil.depth = 1.0f;
+		float depth{ glm::length(glm::vec3{ object.uniformBlock.transformMatrix[3] } - _camTransform.pos) };
+		_mainDrawList.add(makeSortKey(DrawPass::MAIN, object, depth), idx);
+	}
 
-	std::array<VkClearValue, 2> clearValues{ clearValue, depthClear };
+	{
+		ZoneScopedN("sort_draw_list");
+		_mainDrawList.sort();
+	}
 
-	// start the main renderpass. we will use the clear color from above,
-	// and the framebuffer corresponding to the index the swapchain gave us
-	VkRenderPassBeginInfo rpInfo{};
-	rpInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-	rpInfo.pNext = nullptr;
-	rpInfo.renderPass = _renderPass;
-	rpInfo.renderArea.offset.x = 0;
-	rpInfo.renderArea.offset.y = 0;
-	rpInfo.renderArea.extent = _windowExtent;
-	rpInfo.framebuffer = _framebuffers[swapchainImageIndex];
-	rpInfo.clearValueCount = clearValues.size();
-	rpInfo.pClearValues = clearValues.data();
+	// the skinned vertex offsets are needed by the shadow draws and the indirect commands
+	_computeSkinning.prepare(objects, objectCount);
 
-	vkCmdBeginRenderPass(getCurrentFrame().mainCommandBuffer, &rpInfo, VK_SUBPASS_CONTENTS_INLINE);
+	cameraTransformation();
+	prepareShadowPass();
+	_indirectDraw.prepare(objects, _mainDrawList);
 
-	VkViewport viewport{};
-	viewport.width = (float)_windowExtent.width;
-	viewport.height = (float)_windowExtent.height;
-	viewport.minDepth = 0.0f;
-	viewport.maxDepth = 1.0f;
-	viewport.x = 0;
-	viewport.y = 0;
-	vkCmdSetViewport(getCurrentFrame().mainCommandBuffer, 0, 1, &viewport);
+	for (uint32_t c{ 0 }; c < SHADOW_CASCADES; ++c) {
+		_sceneParameters.cascadeMatrices[c] = _shadowGlobal.cascades[c].lightSpaceMatrix;
+		_sceneParameters.cascadeSplits[c] = _shadowGlobal.cascades[c].splitFar;
+	}
+	_sceneParameters.camPos = glm::vec4(_camTransform.pos, 1.0);
+	_sceneParameters.camForward = glm::vec4(-glm::normalize(glm::vec3{ _viewInv[2] }), 0.0f);
+	_clusteredLighting.prepare(glm::inverse(_viewInv), _windowExtent, glm::radians(FOV), NEAR_PLANE);
+	_sceneParameters.clusterGrid = _clusteredLighting.grid();
+	_sceneParameters.clusterParams = _clusteredLighting.sliceParams(_windowExtent);
+	getCurrentFrame().sceneOffset = _frameAllocator.push(_sceneParameters);
 
-	VkRect2D scissor{};
-	scissor.extent = _windowExtent;
-	scissor.offset = { 0, 0 };
-	vkCmdSetScissor(getCurrentFrame().mainCommandBuffer, 0, 1, &scissor);
+	buildRenderGraph(swapchainImageIndex);
+	_renderGraph.compile();
 
-	drawObjects(getCurrentFrame().mainCommandBuffer, _renderables);
+	// everything the passes read is ready, so the secondaries can be recorded on any thread
+	recordPasses();
 
-	ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), getCurrentFrame().mainCommandBuffer);
+	VkCommandBuffer cmd{ getCurrentFrame().mainCommandBuffer };
+	VK_CHECK(vkBeginCommandBuffer(cmd, &cmdBeginInfo));
+
+	_renderGraph.execute(cmd);
 
-	vkCmdEndRenderPass(getCurrentFrame().mainCommandBuffer);
 	TracyVkCollect(getCurrentFrame().tracyContext, getCurrentFrame().mainCommandBuffer);
 
+	_frameAllocator.flush();
+
 	VK_CHECK(vkEndCommandBuffer(getCurrentFrame().mainCommandBuffer));
 
 	// we want to wait on the _presentSemaphore, as that semaphore is signaled when the swapchain
-	// is ready. we will signal the _renderSemaphore, to signal that rendering has finished
+	// is ready, and on the texture uploads published so far. we will signal the _renderSemaphore, to signal that rendering has finished
 
-	VkPipelineStageFlags waitStage{ VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
+	VkTimelineSemaphoreSubmitInfoKHR timelineInfo{};
+	timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+	timelineInfo.pNext = nullptr;
+	timelineInfo.waitSemaphoreValueCount = static_cast<uint32_t>(waitValues.size());
+	timelineInfo.pWaitSemaphoreValues = waitValues.data();
 
 	VkSubmitInfo submit{};
 	submit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-	submit.pNext = nullptr;
-	submit.pWaitDstStageMask = &waitStage;
-	submit.waitSemaphoreCount = 1;
-	submit.pWaitSemaphores = &getCurrentFrame().presentSemaphore;
+	submit.pNext = &timelineInfo;
+	submit.pWaitDstStageMask = waitStages.data();
+	submit.waitSemaphoreCount = static_cast<uint32_t>(waitSemaphores.size());
+	submit.pWaitSemaphores = waitSemaphores.data();
 	submit.signalSemaphoreCount = 1;
 	submit.pSignalSemaphores = &_renderSemaphores[swapchainImageIndex];
 	submit.commandBufferCount = 1;
@@ -1898,82 +2013,356 @@ void VulkanEngine::draw()
 	++_frameNumber;
 }
 
-void VulkanEngine::drawObjects(VkCommandBuffer cmd, const std::multiset<RenderObject>& renderables)
+void VulkanEngine::updateObjectBuffer()
 {
-	TracyVkZone(getCurrentFrame().tracyContext, cmd, "Draw objects");
+	ZoneScoped;
+	_renderables.collectDirty(_dirtyObjects);
 
-	_sceneParameters.lightSpaceMatrix = _shadowGlobal.lightSpaceMatrix;
-	_sceneParameters.camPos = glm::vec4(_camTransform.pos, 1.0);
+	const std::vector<RenderObject>& objects{ _renderables.objects() };
+	RenderObject::RenderObjectUB* objectSSBO{ (RenderObject::RenderObjectUB*)getCurrentFrame().objectData };
+	const VkDeviceSize stride{ sizeof(RenderObject::RenderObjectUB) };
 
-	// copy scene data to scene buffer
-	char* sceneData;
-	vmaMapMemory(_allocator, _sceneParameterBuffer._allocation, (void**)&sceneData);
-	int frameIndex{ _frameNumber % FRAME_OVERLAP };
-	sceneData += padUniformBufferSize(sizeof(GPUSceneData)) * frameIndex;
-	std::memcpy(sceneData, &_sceneParameters, sizeof(GPUSceneData));
-	vmaUnmapMemory(_allocator, _sceneParameterBuffer._allocation);
+	// dirty indices are ascending, so neighbouring objects are flushed as one range
+	size_t i{ 0 };
+	while (i < _dirtyObjects.size() && _dirtyObjects[i] < MAX_OBJECTS) {
+		uint32_t first{ _dirtyObjects[i] };
+		uint32_t last{ first };
 
-	Mesh* lastMesh{ nullptr };
+		objectSSBO[first] = objects[first].uniformBlock;
+		++i;
+		while (i < _dirtyObjects.size() && _dirtyObjects[i] == last + 1 && _dirtyObjects[i] < MAX_OBJECTS) {
+			last = _dirtyObjects[i];
+			objectSSBO[last] = objects[last].uniformBlock;
+			++i;
+		}
+
+		vmaFlushAllocation(_allocator, getCurrentFrame().objectBuffer._allocation, first * stride, (last - first + 1) * stride);
+	}
+}
+
+void VulkanEngine::buildRenderGraph(uint32_t swapchainImageIndex)
+{
+	ZoneScoped;
+	_renderGraph.reset();
+
+	FrameData& frame{ getCurrentFrame() };
+
+	// the acquire semaphore is waited on at color attachment output, so the transition waits there too
+	RenderGraphResource swapchainImage{ _renderGraph.importImage("swapchain", _swapchainImages[swapchainImageIndex], _swapchainImageViews[swapchainImageIndex],
+		VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT) };
+	_renderGraph.setOutput(swapchainImage, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+
+	// a resource per cascade layer, so each cascade's pass only waits on its own layer. They are overwritten every
+	// frame, and the frame's fence was waited on so nothing still samples them
+	std::array<RenderGraphResource, SHADOW_CASCADES> shadowCascades;
+	std::array<RenderGraphResource, SHADOW_CASCADES> shadowCaches;
+	for (uint32_t c{ 0 }; c < SHADOW_CASCADES; ++c) {
+		shadowCascades[c] = _renderGraph.importImage("shadow_cascade_" + std::to_string(c), frame.shadow.depth.image._image, frame.shadow.cascadeViews[c],
+			VK_IMAGE_ASPECT_DEPTH_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, c, 1);
+
+		// the cache is left as a copy source by the frame before. A kept cache was already made visible to
+		// copies then, a redrawn one has to wait for the other frame's copy to finish reading it
+		bool redraw{ _shadowGlobal.cascades[c].redrawCache };
+		shadowCaches[c] = _renderGraph.importImage("shadow_cache_" + std::to_string(c), _shadowGlobal.staticCache.image._image, _shadowGlobal.staticCacheViews[c],
+			VK_IMAGE_ASPECT_DEPTH_BIT, redraw ? VK_IMAGE_LAYOUT_UNDEFINED : VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, redraw ? VK_PIPELINE_STAGE_TRANSFER_BIT : 0, c, 1);
+	}
+
+	RenderGraphResource drawCommands{ _renderGraph.importBuffer("draw_commands", _indirectDraw.drawCommandBuffer()) };
+	RenderGraphResource drawCounts{ _renderGraph.importBuffer("draw_counts", _indirectDraw.drawCountBuffer()) };
+	RenderGraphResource lightGrid{ _renderGraph.importBuffer("light_grid", _clusteredLighting.lightGridBuffer()) };
+	RenderGraphResource lightIndices{ _renderGraph.importBuffer("light_indices", _clusteredLighting.lightIndexBuffer()) };
+	RenderGraphResource skinnedVertices{ _renderGraph.importBuffer("skinned_vertices", _computeSkinning.vertexBuffer()) };
+
+	RenderGraphImageDesc colorDesc{};
+	colorDesc.format = _swapchainImageFormat;
+	colorDesc.extent = _windowExtent;
+	colorDesc.samples = _msaaSamples;
+	colorDesc.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+	colorDesc.aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+	RenderGraphResource colorTarget{ _renderGraph.createImage("msaa_color", colorDesc) };
+
+	RenderGraphImageDesc depthDesc{ colorDesc };
+	depthDesc.format = _depthFormat;
+	depthDesc.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+	depthDesc.aspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+	RenderGraphResource depthTarget{ _renderGraph.createImage("depth", depthDesc) };
+
+	// skinned once for the shadow and main passes
+	uint32_t skinPass{ _renderGraph.addComputePass("Skinning", [this](VkCommandBuffer cmd) {
+		_computeSkinning.skin(cmd);
+	}) };
+	_renderGraph.use(skinPass, skinnedVertices, RenderGraphUsage::STORAGE_WRITE);
+
+	// First render pass: Generate shadow map by rendering the scene from light's POV
+	VkClearValue shadowClear{};
+	shadowClear.depthStencil.depth = 1.0f;
+
+	VkExtent2D shadowExtent{ _shadowGlobal.width, _shadowGlobal.height };
+	for (uint32_t c{ 0 }; c < SHADOW_CASCADES; ++c) {
+		std::string cascade{ std::to_string(c) };
+
+		_staticShadowGraphPasses[c] = UINT32_MAX;
+		if (_shadowGlobal.cascades[c].redrawCache) {
+			_staticShadowGraphPasses[c] = _renderGraph.addGraphicsPass("Static shadow cascade " + cascade, _shadowGlobal.renderPass, shadowExtent,
+				{ shadowClear }, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS, [this, c](VkCommandBuffer cmd) {
+					vkCmdExecuteCommands(cmd, static_cast<uint32_t>(_staticShadowSecondaries[c].size()), _staticShadowSecondaries[c].data());
+				});
+			_renderGraph.use(_staticShadowGraphPasses[c], shadowCaches[c], RenderGraphUsage::DEPTH_ATTACHMENT);
+			_renderGraph.use(_staticShadowGraphPasses[c], skinnedVertices, RenderGraphUsage::VERTEX_READ);
+		}
+
+		uint32_t copyPass{ _renderGraph.addTransferPass("Copy shadow cache " + cascade, [this, c](VkCommandBuffer cmd) {
+			VkImageCopy region{};
+			region.srcSubresource = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, c, 1 };
+			region.dstSubresource = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, c, 1 };
+			region.extent = { _shadowGlobal.width, _shadowGlobal.height, 1 };
+			vkCmdCopyImage(cmd, _shadowGlobal.staticCache.image._image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+				getCurrentFrame().shadow.depth.image._image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+		}) };
+		_renderGraph.use(copyPass, shadowCaches[c], RenderGraphUsage::TRANSFER_SRC);
+		_renderGraph.use(copyPass, shadowCascades[c], RenderGraphUsage::TRANSFER_DST);
+
+		// dynamic casters on top of the static depth
+		_shadowGraphPasses[c] = _renderGraph.addGraphicsPass("Shadow cascade " + cascade, _shadowGlobal.loadRenderPass, shadowExtent,
+			{}, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS, [this, c](VkCommandBuffer cmd) {
+				vkCmdExecuteCommands(cmd, static_cast<uint32_t>(_shadowSecondaries[c].size()), _shadowSecondaries[c].data());
+			});
+		_renderGraph.use(_shadowGraphPasses[c], shadowCascades[c], RenderGraphUsage::DEPTH_ATTACHMENT);
+		_renderGraph.use(_shadowGraphPasses[c], skinnedVertices, RenderGraphUsage::VERTEX_READ);
+	}
+
+	// writes the main pass draw commands
+	uint32_t cullPass{ _renderGraph.addComputePass("Cull objects", [this](VkCommandBuffer cmd) {
+		_indirectDraw.cull(cmd, _viewProj);
+	}) };
+	_renderGraph.use(cullPass, drawCommands, RenderGraphUsage::STORAGE_WRITE);
+	_renderGraph.use(cullPass, drawCounts, RenderGraphUsage::STORAGE_WRITE);
+
+	// bins the lights into the clusters the main pass shades with
+	uint32_t lightPass{ _renderGraph.addComputePass("Cluster lights", [this](VkCommandBuffer cmd) {
+		_clusteredLighting.cull(cmd);
+	}) };
+	_renderGraph.use(lightPass, lightGrid, RenderGraphUsage::STORAGE_WRITE);
+	_renderGraph.use(lightPass, lightIndices, RenderGraphUsage::STORAGE_WRITE);
+
+	VkClearValue clearValue{};
+	clearValue.color = { {0.0, 0.0, 0.1, 1.0} };
+
+	VkClearValue depthClear{};
+	depthClear.depthStencil.depth = 1.0f;
+
+	// the last secondary is ImGui, so the UI still draws over the scene
+	_mainGraphPass = _renderGraph.addGraphicsPass("Draw objects", _renderPass, _windowExtent,
+		{ clearValue, depthClear }, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS, [this](VkCommandBuffer cmd) {
+			vkCmdExecuteCommands(cmd, static_cast<uint32_t>(_mainSecondaries.size()), _mainSecondaries.data());
+		});
+	// attachments in the order of _renderPass
+	_renderGraph.use(_mainGraphPass, colorTarget, RenderGraphUsage::COLOR_ATTACHMENT);
+	_renderGraph.use(_mainGraphPass, depthTarget, RenderGraphUsage::DEPTH_ATTACHMENT);
+	_renderGraph.use(_mainGraphPass, swapchainImage, RenderGraphUsage::RESOLVE_ATTACHMENT);
+	for (RenderGraphResource cascade : shadowCascades) {
+		_renderGraph.use(_mainGraphPass, cascade, RenderGraphUsage::DEPTH_SAMPLED);
+	}
+	_renderGraph.use(_mainGraphPass, drawCommands, RenderGraphUsage::INDIRECT_READ);
+	_renderGraph.use(_mainGraphPass, drawCounts, RenderGraphUsage::INDIRECT_READ);
+	_renderGraph.use(_mainGraphPass, lightGrid, RenderGraphUsage::FRAGMENT_STORAGE_READ);
+	_renderGraph.use(_mainGraphPass, lightIndices, RenderGraphUsage::FRAGMENT_STORAGE_READ);
+	_renderGraph.use(_mainGraphPass, skinnedVertices, RenderGraphUsage::VERTEX_READ);
+}
+
+VkCommandBuffer VulkanEngine::beginSecondaryCommandBuffer(uint32_t threadIndex, VkRenderPass renderPass, VkFramebuffer framebuffer)
+{
+	SecondaryCommandPool& workerPool{ getCurrentFrame().workerCommandPools[threadIndex] };
+
+	if (workerPool.used == workerPool.buffers.size()) {
+		VkCommandBufferAllocateInfo allocInfo{ vkinit::commandBufferAllocateInfo(workerPool.pool, 1, VK_COMMAND_BUFFER_LEVEL_SECONDARY) };
+		VkCommandBuffer buffer;
+		VK_CHECK(vkAllocateCommandBuffers(_device, &allocInfo, &buffer));
+		workerPool.buffers.push_back(buffer);
+	}
+
+	VkCommandBuffer cmd{ workerPool.buffers[workerPool.used] };
+	++workerPool.used;
+
+	VkCommandBufferInheritanceInfo inheritanceInfo{};
+	inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+	inheritanceInfo.pNext = nullptr;
+	inheritanceInfo.renderPass = renderPass;
+	inheritanceInfo.subpass = 0;
+	inheritanceInfo.framebuffer = framebuffer;
+
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.pNext = nullptr;
+	beginInfo.pInheritanceInfo = &inheritanceInfo;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+
+	VK_CHECK(vkBeginCommandBuffer(cmd, &beginInfo));
+	return cmd;
+}
+
+void VulkanEngine::recordPasses()
+{
+	ZoneScoped;
+
+	// a shadow pass to record: a cascade's static cache or its dynamic casters
+	struct ShadowRecording {
+		uint32_t cascade;
+		const DrawList* drawList;
+		VkRenderPass renderPass;
+		VkFramebuffer framebuffer;
+		std::vector<VkCommandBuffer>* secondaries;
+		uint32_t jobs;
+	};
+
+	// split each pass into at most one slice per thread, but don't bother splitting small passes
+	uint32_t threadCount{ _jobSystem.threadCount() };
+	std::vector<ShadowRecording> shadowRecordings;
+	for (uint32_t c{ 0 }; c < SHADOW_CASCADES; ++c) {
+		if (_shadowGlobal.cascades[c].redrawCache) {
+			shadowRecordings.push_back({ c, &_staticShadowDrawLists[c], _shadowGlobal.renderPass, _renderGraph.framebuffer(_staticShadowGraphPasses[c]), &_staticShadowSecondaries[c], 0 });
+		}
+		shadowRecordings.push_back({ c, &_shadowDrawLists[c], _shadowGlobal.loadRenderPass, _renderGraph.framebuffer(_shadowGraphPasses[c]), &_shadowSecondaries[c], 0 });
+	}
+
+	uint32_t shadowJobs{ 0 };
+	for (ShadowRecording& recording : shadowRecordings) {
+		uint32_t draws{ recording.drawList->size() };
+		recording.jobs = std::clamp((draws + SHADOW_DRAWS_PER_JOB - 1) / SHADOW_DRAWS_PER_JOB, 1u, threadCount);
+		recording.secondaries->resize(recording.jobs);
+		shadowJobs += recording.jobs;
+	}
+	uint32_t batchCount{ static_cast<uint32_t>(_indirectDraw.batches().size()) };
+	uint32_t mainJobs{ std::clamp((batchCount + MAIN_BATCHES_PER_JOB - 1) / MAIN_BATCHES_PER_JOB, 1u, threadCount) };
+
+	// plus one for ImGui
+	_mainSecondaries.resize(mainJobs + 1);
+
+	VkFramebuffer mainFramebuffer{ _renderGraph.framebuffer(_mainGraphPass) };
+
+	// shadow slices pass by pass, then main pass slices, then ImGui. Each job writes its own slot, so the
+	// secondaries execute in draw list order no matter which thread finished first
+	_jobSystem.parallelFor(shadowJobs + mainJobs + 1, [&](uint32_t jobIndex, uint32_t threadIndex) {
+		if (jobIndex < shadowJobs) {
+			uint32_t r{ 0 };
+			uint32_t slice{ jobIndex };
+			while (slice >= shadowRecordings[r].jobs) {
+				slice -= shadowRecordings[r].jobs;
+				++r;
+			}
+			const ShadowRecording& recording{ shadowRecordings[r] };
+
+			uint32_t draws{ recording.drawList->size() };
+			uint32_t first{ draws * slice / recording.jobs };
+			uint32_t last{ draws * (slice + 1) / recording.jobs };
+
+			VkCommandBuffer cmd{ beginSecondaryCommandBuffer(threadIndex, recording.renderPass, recording.framebuffer) };
+			shadowPass(cmd, recording.cascade, *recording.drawList, first, last - first);
+			VK_CHECK(vkEndCommandBuffer(cmd));
+			(*recording.secondaries)[slice] = cmd;
+		} else if (jobIndex < shadowJobs + mainJobs) {
+			uint32_t slice{ jobIndex - shadowJobs };
+			uint32_t first{ batchCount * slice / mainJobs };
+			uint32_t last{ batchCount * (slice + 1) / mainJobs };
+
+			VkCommandBuffer cmd{ beginSecondaryCommandBuffer(threadIndex, _renderPass, mainFramebuffer) };
+			drawObjects(cmd, first, last - first);
+			VK_CHECK(vkEndCommandBuffer(cmd));
+			_mainSecondaries[slice] = cmd;
+		} else {
+			ZoneScopedN("record_imgui");
+			VkCommandBuffer cmd{ beginSecondaryCommandBuffer(threadIndex, _renderPass, mainFramebuffer) };
+			ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), cmd);
+			VK_CHECK(vkEndCommandBuffer(cmd));
+			_mainSecondaries[mainJobs] = cmd;
+		}
+	});
+}
+
+// Runs on job system threads. cmd is a secondary command buffer, so none of the state is inherited
+void VulkanEngine::drawObjects(VkCommandBuffer cmd, uint32_t firstBatch, uint32_t batchCount)
+{
+	ZoneScoped;
+
+	VkViewport viewport{};
+	viewport.width = (float)_windowExtent.width;
+	viewport.height = (float)_windowExtent.height;
+	viewport.minDepth = 0.0f;
+	viewport.maxDepth = 1.0f;
+	viewport.x = 0;
+	viewport.y = 0;
+	vkCmdSetViewport(cmd, 0, 1, &viewport);
+
+	VkRect2D scissor{};
+	scissor.extent = _windowExtent;
+	scissor.offset = { 0, 0 };
+	vkCmdSetScissor(cmd, 0, 1, &scissor);
+
+	// global set dynamic offsets, in binding order
+	std::array<uint32_t, 2> globalOffsets{ getCurrentFrame().cameraOffset, getCurrentFrame().sceneOffset };
+
+	// every mesh lives in the geometry pool, so buffers only change with the vertex format
+	vkCmdBindIndexBuffer(cmd, _geometryPool.indexBuffer(), 0, VK_INDEX_TYPE_UINT16);
+	VertexFormat lastFormat{ VertexFormat::Unknown };
 	Material* lastMaterial{ nullptr };
 
 	uint32_t pipelineBinds{ 0 };
 	uint32_t vertexBufferBinds{ 0 };
 
-	uint32_t idx{ 0 };
-	for (const RenderObject& object : renderables) {
+	// renderables were culled and written as indirect commands by _indirectDraw, one draw per batch
+	const std::vector<IndirectBatch>& batches{ _indirectDraw.batches() };
+	for (uint32_t batchIdx{ firstBatch }; batchIdx < firstBatch + batchCount; ++batchIdx) {
+		const IndirectBatch& batch{ batches[batchIdx] };
+
 		// only bind the pipeline if it doesn't match with the already bound one
-		if (object.material != lastMaterial) {
+		if (batch.material != lastMaterial) {
 			// if this material has the same descriptor set layout then the pipelines might be the same and we don't have to rebind??
-			vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, object.material->pipeline);
-			lastMaterial = object.material;
+			vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, batch.material->pipeline);
+			lastMaterial = batch.material;
 
-			// camera data descriptor
-			uint32_t uniformOffset{ static_cast<uint32_t>(padUniformBufferSize(sizeof(GPUSceneData)) * frameIndex) };
+			// camera and scene data descriptor
 			// we probably bind descriptor set here since it depends on the pipelinelayout
-			vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, object.material->pipelineLayout, 0, 1, &getCurrentFrame().globalDescriptor, 1, &uniformOffset);
+			vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, batch.material->pipelineLayout, 0, 1, &getCurrentFrame().globalDescriptor, static_cast<uint32_t>(globalOffsets.size()), globalOffsets.data());
 
 			// object data descriptor
-			vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, object.material->pipelineLayout, 1, 1, &getCurrentFrame().objectDescriptor, 0, nullptr);
+			vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, batch.material->pipelineLayout, 1, 1, &getCurrentFrame().objectDescriptor, 0, nullptr);
 
-			if (object.material->textureSet != VK_NULL_HANDLE) {
-				vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, object.material->pipelineLayout, 2, 1, &object.material->textureSet, 0, nullptr);
+			if (!batch.material->textureSets.empty()) {
+				vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, batch.material->pipelineLayout, 2, 1, &batch.material->textureSets[_frameNumber % FRAME_OVERLAP], 0, nullptr);
 			}
 
-			if (!object.mesh->skel.skins.empty()) {
-				vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, object.material->pipelineLayout, 3, 1, &object.mesh->skel.skins[0].jointsDescriptorSet, 0, nullptr);
-			}
+			MeshPushConstants constants{};
+			constants.roughnessMultiplier = glm::vec4{ _guiData.roughness_mult };
+
+			vkCmdPushConstants(cmd, batch.material->pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(MeshPushConstants), &constants);
 
 			++pipelineBinds;
 		}
 
-		//glm::mat4 model{ object.transformMatrix };
-		//// final render matrix that we are calculating on the CPU
-		//glm::mat4 mesh_matrix{ projection * view * model };
-
-		MeshPushConstants constants{};
-		constants.roughnessMultiplier = glm::vec4{ _guiData.roughness_mult };
-
-		vkCmdPushConstants(cmd, object.material->pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(MeshPushConstants), &constants);
-
-		// only bind the mesh if it's a different one from last bind
-		if (object.mesh != lastMesh) {
-			// bind the mesh vertex buffer with offset 0
+		// only bind the vertex buffer if the format differs from the last bind
+		if (batch.mesh->vertexFormat != lastFormat) {
+			VkBuffer vertexBuffer{ drawVertexBuffer(batch.mesh->vertexFormat) };
 			VkDeviceSize offset{ 0 };
-			vkCmdBindVertexBuffers(cmd, 0, 1, &object.mesh->vertexBuffer._buffer, &offset);
-			vkCmdBindIndexBuffer(cmd, object.mesh->indexBuffer._buffer, 0, VK_INDEX_TYPE_UINT16);
+			vkCmdBindVertexBuffers(cmd, 0, 1, &vertexBuffer, &offset);
 
-			lastMesh = object.mesh;
+			lastFormat = batch.mesh->vertexFormat;
 			++vertexBufferBinds;
 		}
 
-		//vkCmdDraw(cmd, object.mesh->_vertices.size(), 1, 0, idx);
-		vkCmdDrawIndexed(cmd, object.mesh->indices.size(), 1, 0, 0, idx);
-		++idx;
+		_indirectDraw.drawBatch(cmd, batchIdx);
 	}
 
 	//std::cout << "pipeline binds: " << pipelineBinds << "\nvertex buffer binds: " << vertexBufferBinds << "\n\n";
 }
 
+VkBuffer VulkanEngine::drawVertexBuffer(VertexFormat format) const
+{
+	if (format == VertexFormat::SKINNED) {
+		return _computeSkinning.vertexBuffer();
+	}
+	return _geometryPool.vertexBuffer(format);
+}
+
 void VulkanEngine::showFPS() {
 	uint32_t currentTicks{ SDL_GetTicks() };
 	double currentTime{ currentTicks / 1000.0 };
@@ -2087,18 +2476,12 @@ void VulkanEngine::resizeWindow(int32_t width, int32_t height)
 {
 	vkDeviceWaitIdle(_device);
 
-	// destroy framebuffers
-	const uint32_t swapchain_imagecount{ (uint32_t)_swapchainImages.size() };
-	for (auto i{ 0 }; i < swapchain_imagecount; ++i) {
-		vkDestroyFramebuffer(_device, _framebuffers[i], nullptr);
-		vkDestroyImageView(_device, _swapchainImageViews[i], nullptr);
-	}
+	// the graph's framebuffers reference the swapchain views, and its color and depth images are window sized
+	_renderGraph.invalidate();
 
-	// destroy color and depth images
-	vkDestroyImageView(_device, _colorImageView, nullptr);
-	vkDestroyImageView(_device, _depthImageView, nullptr);
-	vmaDestroyImage(_allocator, _colorImage._image, _colorImage._allocation);
-	vmaDestroyImage(_allocator, _depthImage._image, _depthImage._allocation);
+	for (VkImageView view : _swapchainImageViews) {
+		vkDestroyImageView(_device, view, nullptr);
+	}
 
 	_windowExtent.width = width;
 	_windowExtent.height = height;
@@ -2106,12 +2489,11 @@ void VulkanEngine::resizeWindow(int32_t width, int32_t height)
 	VkSwapchainKHR oldSwapchain{ _swapchain };
 
 	initSwapchain(_swapchain);
-	initFramebuffers(true);
 
 	// destroy old swapchain after we use it to initialize the new one
 	vkDestroySwapchainKHR(_device, oldSwapchain, nullptr);
 
-	initBoundingSphere();
+	initShadowCascades();
 }
 
 bool VulkanEngine::input() {
@@ -11,6 +11,7 @@
 #include <unordered_map>
 #include <string>
 #include <set>
+#include <array>
 #include <chrono>
 #include <type_traits>
 
@@ -24,6 +25,18 @@
 #include "application.h"
 #include "physics.h"
 #include "asset_loader.h"
+#include "texture_streamer.h"
+#include "upload_batch.h"
+#include "geometry_pool.h"
+#include "indirect_draw.h"
+#include "frustum_culling.h"
+#include "render_objects.h"
+#include "draw_list.h"
+#include "frame_allocator.h"
+#include "job_system.h"
+#include "render_graph.h"
+#include "clustered_lighting.h"
+#include "compute_skinning.h"
 
 #define VK_CHECK(x)\
 	do\
@@ -37,30 +50,50 @@
 
 // number of frames to overlap when rendering
 constexpr uint32_t FRAME_OVERLAP{ 2 };
-constexpr size_t MAX_NUM_TOTAL_LIGHTS{ 10 }; // this must match glsl shader!
-constexpr uint32_t SHADOWMAP_DIM{ 4096 };
+constexpr uint32_t SHADOWMAP_DIM{ 2048 }; // of each cascade
+constexpr uint32_t SHADOW_CASCADES{ 4 }; // this must match glsl shader!
 constexpr uint32_t MAX_OBJECTS{ 10000 };
 constexpr float FOV{ 70.0f }; // degrees
 constexpr float NEAR_PLANE{ 0.05f };
-constexpr float FAR_PLANE_SHADOW{ 25.0f }; // Rendering has an inf far plane, this is only used for shadow maps
+constexpr float FAR_PLANE_SHADOW{ 60.0f }; // Rendering has an inf far plane, this is only used for shadow maps
+// blend between logarithmic (1) and uniform (0) cascade splits
+constexpr float CASCADE_SPLIT_LAMBDA{ 0.75f };
+// how far, as a fraction of its bounding sphere's radius, a cascade's slice can move before the cascade scrolls.
+// Larger scrolls less often, which keeps the static shadow cache longer, but spreads the texels over more area
+constexpr float CASCADE_SCROLL_MARGIN{ 0.25f };
+
+// how pbr.frag filters the shadow map, given to it as a specialization constant. This must match glsl shader!
+enum class ShadowFilter : int32_t {
+	// one bilinear comparison tap
+	HARDWARE_PCF,
+	// 16 taps on a rotated Poisson disk
+	POISSON_PCF,
+	// blocker search, then Poisson PCF with a kernel as wide as the penumbra
+	PCSS,
+};
+constexpr ShadowFilter SHADOW_FILTER{ ShadowFilter::POISSON_PCF };
+// smallest slice of the shadow draw list recorded as its own secondary command buffer
+constexpr uint32_t SHADOW_DRAWS_PER_JOB{ 256 };
+// same for the main pass, which is recorded per indirect batch
+constexpr uint32_t MAIN_BATCHES_PER_JOB{ 32 };
+// animated objects sampled, posed and skinned by one job
+constexpr uint32_t ANIMATIONS_PER_JOB{ 4 };
 
 struct VulkanEngine;
 
-struct Light {
-	glm::vec4 position; // w is unused
-	glm::vec4 color;    // w is for intensity
-};
-
 struct DirectionLight {
 	Light light;
 	glm::vec4 direction;
 };
 
 struct GPUSceneData {
-	glm::mat4 lightSpaceMatrix;
+	glm::mat4 cascadeMatrices[SHADOW_CASCADES];
+	glm::vec4 cascadeSplits; // view depth where each cascade ends
 	glm::vec4 camPos; // w is unused
-	Light lights[MAX_NUM_TOTAL_LIGHTS];
-	uint32_t numLights;
+	glm::vec4 camForward; // w is unused, for the view depth that picks the cascade and light cluster
+	// the lights themselves are in storage buffers, see ClusteredLighting
+	glm::uvec4 clusterGrid;
+	glm::vec4 clusterParams;
 };
 
 struct GPUCameraData {
@@ -69,33 +102,72 @@ struct GPUCameraData {
 	glm::mat4 viewProj;
 };
 
+// one slice of the view frustum with its own light matrix and layer of the shadow map
+struct ShadowCascade {
+	float splitNear;
+	float splitFar;
+	// bounding sphere of the slice in view space. The radius doesn't change as the camera
+	// rotates, so neither does the texel size of the cascade
+	float sphereZ;
+	float sphereR;
+	glm::mat4 lightSpaceMatrix;
+	// center of the light space region the cascade covers. It stays put while the slice moves within the
+	// margin, so the light matrix only depends on the camera when the region scrolls
+	bool regionValid{ false };
+	glm::vec3 regionCenter{ 0.0f };
+
+	// static casters are drawn into a cache layer only when the region scrolled or a static object moved,
+	// every frame copies the cache and draws the dynamic casters over it
+	bool cacheValid{ false };
+	bool redrawCache;
+	glm::mat4 cacheMatrix;
+	uint64_t cacheStaticVersion;
+};
+
 struct ShadowGlobalResources {
 	uint32_t width;
 	uint32_t height;
+	// clears the depth, for the static cache
 	VkRenderPass renderPass;
+	// keeps the copied static depth, for the dynamic casters
+	VkRenderPass loadRenderPass;
 	// Depth bias (and slope) are used to avoid shadowing artifacts
 	// Constant depth bias factor (always applied)
 	float depthBiasConstant{ 1.25f };
 	// Slope depth bias factor, applied depending on polygon's slope
 	float depthBiasSlope{ 1.75f };
 	VkPipeline shadowPipeline;
-	VkPipeline shadowPipelineSkinned;
 	VkPipelineLayout shadowPipelineLayout;
-	VkPipelineLayout shadowPipelineLayoutSkinned;
-	VkDescriptorSetLayout shadowJointSetLayout;
-	glm::mat4 lightSpaceMatrix;
+	std::array<ShadowCascade, SHADOW_CASCADES> cascades;
+	// static caster depth, a layer per cascade. Shared by the frames in flight since it rarely changes
+	Texture staticCache;
+	std::array<VkImageView, SHADOW_CASCADES> staticCacheViews;
 };
 
 struct ShadowFrameResources {
-	VkFramebuffer frameBuffer;
+	// layer per cascade, imageView views all of them as an array for sampling
 	Texture depth;
+	// views of a single layer, for the framebuffers
+	std::array<VkImageView, SHADOW_CASCADES> cascadeViews;
+	// hardware PCF
+	VkSampler compareSampler;
+	// unfiltered depth
 	VkSampler depthSampler;
 	VkDescriptorImageInfo descriptor;
 	VkPipelineLayout shadowPipelineLayout;
 	// Notice that there is not a descriptor set for skin here. That is in Skin struct.
 	VkDescriptorSet shadowDescriptorSetLight;
 	VkDescriptorSet shadowDescriptorSetObjects;
-	AllocatedBuffer shadowLightBuffer;
+	// dynamic offsets of this frame's cascade light matrices in the frame allocator
+	std::array<uint32_t, SHADOW_CASCADES> lightOffsets;
+};
+
+// command pool owned by one recording thread, so threads never share a pool
+struct SecondaryCommandPool {
+	VkCommandPool pool;
+	// allocated on demand and reused every frame once the pool is reset
+	std::vector<VkCommandBuffer> buffers;
+	uint32_t used;
 };
 
 struct FrameData {
@@ -109,15 +181,20 @@ struct FrameData {
 	// command buffer belongs to frame since we for the next frame
 	// while the other frame's command buffer is submitted
 	VkCommandBuffer mainCommandBuffer;
+	// one per job system thread, for the secondary command buffers of the shadow and main passes
+	std::vector<SecondaryCommandPool> workerCommandPools;
 
-	// buffer that holds a single GPUCameraData to use when rendering
-	AllocatedBuffer cameraBuffer;
+	// dynamic offsets of this frame's GPUCameraData and GPUSceneData in the frame allocator
+	uint32_t cameraOffset;
+	uint32_t sceneOffset;
 	// descriptor that has frame lifetime
 	VkDescriptorSet globalDescriptor;
 
 	// Object matrices for all objects in scenes. This belongs to the frame since it's
 	// dynamic and changing every frame (static scenes would need only one objectBuffer)
 	AllocatedBuffer objectBuffer;
+	// persistently mapped, only objects that changed are written
+	void* objectData;
 	VkDescriptorSet objectDescriptor;
 
 	TracyVkCtx tracyContext;
@@ -138,21 +215,23 @@ struct Transform {
 
 class GameObject {
 public:
-	GameObject(const RenderObject* ro)
-		: _renderObject{ ro }
+	GameObject(VulkanEngine* engine, RenderObjectHandle ro)
+		: _engine{ engine }
+		, _renderObject{ ro }
 		, _transform{}
 		, parent{ nullptr }
 		, _physicsObject{}
 	{}
 
 	GameObject()
-		: _renderObject{ nullptr }
+		: _engine{ nullptr }
+		, _renderObject{}
 		, _transform{}
 		, parent{ nullptr }
 		, _physicsObject{}
 	{}
 
-	void setRenderObject(const RenderObject* ro);
+	void setRenderObject(VulkanEngine* engine, RenderObjectHandle ro);
 
 	physx::PxRigidActor* getPhysicsObject();
 
@@ -194,7 +273,8 @@ private:
 	void updateRenderMatrix();
 
 	Transform _transform;
-	const RenderObject* _renderObject;
+	VulkanEngine* _engine;
+	RenderObjectHandle _renderObject;
 	physx::PxRigidActor* _physicsObject;
 };
 
@@ -202,7 +282,7 @@ struct GuiData {
 	Light light0;
 	Light light1;
 	float bedAngle;
-	const RenderObject* bed;
+	RenderObjectHandle bed;
 	float roughness_mult;
 };
 
@@ -262,19 +342,30 @@ public:
 	VkQueue _graphicsQueue;
 	uint32_t _graphicsQueueFamily;
 
+	// dedicated transfer queue for streaming uploads, same as the graphics queue if the gpu doesn't have one
+	VkQueue _transferQueue;
+	uint32_t _transferQueueFamily;
+
 	VkRenderPass _renderPass;
-	std::vector<VkFramebuffer> _framebuffers;
 
 	DeletionQueue _mainDeletionQueue;
 
 	VmaAllocator _allocator;
 
-	VkImageView _depthImageView;
-	AllocatedImage _depthImage;
 	VkFormat _depthFormat;
 
-	std::multiset<RenderObject> _renderables;
+	RenderObjectStore _renderables;
+	std::vector<uint32_t> _dirtyObjects;
+	// dense indices of the objects updateAnimations runs this frame
+	std::vector<uint32_t> _animatedObjects;
+	// rebuilt and sorted every frame
+	DrawList _mainDrawList;
+	// dynamic casters of each cascade
+	std::array<DrawList, SHADOW_CASCADES> _shadowDrawLists;
+	// only built for the cascades whose cache is redrawn
+	std::array<DrawList, SHADOW_CASCADES> _staticShadowDrawLists;
 	std::unordered_map<std::string, Material> _materials;
+	std::unordered_map<VkPipeline, uint32_t> _pipelineSortIds;
 	std::unordered_map<std::string, Mesh*> _meshes;
 
 	Transform _camTransform{};
@@ -285,29 +376,51 @@ public:
 	VkPhysicalDeviceProperties _gpuProperties;
 
 	GPUSceneData _sceneParameters;
-	AllocatedBuffer _sceneParameterBuffer;
 
 	VkDescriptorSetLayout _objectSetLayout;
-	VkDescriptorSetLayout _skinSetLayout;
 
 	UploadContext _uploadContext;
+	UploadBatch _uploadBatch;
+	// transient uniform data: camera, scene, light and joint matrices
+	FrameAllocator _frameAllocator;
+	GeometryPool _geometryPool;
+	IndirectDraw _indirectDraw;
+	// bins the scene's point lights into view space clusters every frame
+	ClusteredLighting _clusteredLighting;
+	// skins the skinned render objects once per frame, for both the shadow and main passes
+	ComputeSkinning _computeSkinning;
+	// world space bounds of _renderables in SSBO order, rebuilt every frame
+	BoundingSpheres _worldBounds;
+	std::vector<uint8_t> _shadowVisible;
 
 	//texture hashmap
 	std::unordered_map<std::string, Texture> _loadedTextures;
 
+	TextureStreamer _textureStreamer;
+
+	// records the passes' secondary command buffers in parallel
+	JobSystem _jobSystem;
+	// recorded this frame, in execution order
+	std::array<std::vector<VkCommandBuffer>, SHADOW_CASCADES> _shadowSecondaries;
+	std::array<std::vector<VkCommandBuffer>, SHADOW_CASCADES> _staticShadowSecondaries;
+	std::vector<VkCommandBuffer> _mainSecondaries;
+
+	// passes, barriers and the MSAA color and depth targets of the frame
+	RenderGraph _renderGraph;
+	std::array<uint32_t, SHADOW_CASCADES> _shadowGraphPasses;
+	std::array<uint32_t, SHADOW_CASCADES> _staticShadowGraphPasses;
+	uint32_t _mainGraphPass;
+
 	GuiData _guiData;
 
 	// frame storage
 	FrameData _frames[FRAME_OVERLAP];
 
 	ShadowGlobalResources _shadowGlobal;
-	float _boundingSphereZ;
-	float _boundingSphereR;
 	glm::mat4 _viewInv;
+	glm::mat4 _viewProj; // for culling the main pass
 
 	VkSampleCountFlagBits _msaaSamples;
-	AllocatedImage _colorImage;
-	VkImageView _colorImageView;
 
 	std::vector<GameObject*> _physicsObjects;
 
@@ -356,9 +469,15 @@ public:
 	// returns nullptr if it can't be found
 	Mesh* getMesh(const std::string& name);
 
-	const RenderObject* createRenderObject(const std::string& meshName, const std::string& matName, bool castShadow=true);
+	// static objects aren't animated and rarely move, their shadows are cached
+	RenderObjectHandle createRenderObject(const std::string& meshName, const std::string& matName, bool castShadow=true, bool isStatic=false);
 
-	const RenderObject* createRenderObject(const std::string& name);
+	RenderObjectHandle createRenderObject(const std::string& name);
+
+	void destroyRenderObject(RenderObjectHandle handle);
+
+	// returns nullptr if the render object was destroyed. Move it with _renderables.setTransform so the change is uploaded
+	RenderObject* getRenderObject(RenderObjectHandle handle);
 
 	void setCameraTransform(Transform transform);
 
@@ -395,12 +514,13 @@ private:
 
 	void initDefaultRenderpass();
 
-	void initFramebuffers(bool windowResize);
-
 	void initSyncStructures();
 
 	void initPipeline(const MaterialCreateInfo& info, const std::string& prefix);
 
+	// zstd dictionaries the baker trained, needed to unpack the assets compressed with them
+	void loadCompressionDictionaries();
+
 	void loadMeshes();
 
 	void loadMaterials();
@@ -415,12 +535,28 @@ private:
 	// returns nullptr if it can't be found
 	Material* getMaterial(const std::string& name);
 
-	void drawObjects(VkCommandBuffer cmd, const std::multiset<RenderObject>& renderables);
+	// record the main pass draws of batches [firstBatch, firstBatch + batchCount)
+	void drawObjects(VkCommandBuffer cmd, uint32_t firstBatch, uint32_t batchCount);
+
+	// the buffer meshes of format are drawn from, skinned meshes are drawn from this frame's skinned vertices
+	VkBuffer drawVertexBuffer(VertexFormat format) const;
+
+	// begin a secondary command buffer from threadIndex's pool that continues renderPass
+	VkCommandBuffer beginSecondaryCommandBuffer(uint32_t threadIndex, VkRenderPass renderPass, VkFramebuffer framebuffer);
+
+	// declare this frame's passes and the resources they use
+	void buildRenderGraph(uint32_t swapchainImageIndex);
+
+	// record the shadow cascades, main pass and ImGui into secondary command buffers across the job system
+	void recordPasses();
 
 	void initDescriptors();
 
 	void initObjectBuffers();
 
+	// copy the render objects that changed into the current frame's SSBO
+	void updateObjectBuffer();
+
 	void initDescriptorPool();
 
 	size_t padUniformBufferSize(size_t originalSize);
@@ -435,7 +571,11 @@ private:
 
 	void initTracy();
 
-	void shadowPass(VkCommandBuffer& cmd);
+	// compute the cascades' light matrices, decide which static caches to redraw and build the draw lists
+	void prepareShadowPass();
+
+	// record the draws [first, first + count) of one of the cascade's sorted draw lists
+	void shadowPass(VkCommandBuffer cmd, uint32_t cascade, const DrawList& drawList, uint32_t first, uint32_t count);
 
 	void initShadowPass();
 
@@ -443,76 +583,18 @@ private:
 
 	bool input();
 
-	void initBoundingSphere();
+	// split distances and bounding spheres of the cascades, they depend on the aspect ratio
+	void initShadowCascades();
 
 	void cameraTransformation();
 
+	// advance every animated object's clip and rebuild its pose and joint matrices on the job system.
+	// Each object only writes its own AnimationState, the meshes' skeletons are read only
+	void updateAnimations(uint32_t objectCount);
+
 	void loadMesh(const std::string& name, const std::string& path);
 
 	void loadSkeletalAnimation(const std::string& name, const std::string& path);
-
-	void uploadMesh(Mesh* mesh);
-
-	void uploadMeshSkinned(Mesh* mesh);
-
-	// For use with vertex buffers or index buffers. If !isVertexBuffer, then index buffer is assumed
-	template <typename T>
-	void uploadBuffer(const std::vector<T>& vec, AllocatedBuffer& buffer, bool isVertexBuffer)
-	{
-		const size_t bufferSize{ vec.size() * sizeof(T) };
-		// allocate staging buffer
-		VkBufferCreateInfo stagingBufferInfo{};
-		stagingBufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-		stagingBufferInfo.pNext = nullptr;
-		stagingBufferInfo.size = bufferSize;
-		stagingBufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-
-		// let the VMA library know that this data should be on CPU RAM
-		VmaAllocationCreateInfo vmaAllocInfo{};
-		vmaAllocInfo.usage = VMA_MEMORY_USAGE_CPU_ONLY;
-
-		AllocatedBuffer stagingBuffer{};
-		VK_CHECK(vmaCreateBuffer(_allocator, &stagingBufferInfo, &vmaAllocInfo,
-			&stagingBuffer._buffer,
-			&stagingBuffer._allocation,
-			nullptr));
-
-		// copy data
-		void* data;
-		vmaMapMemory(_allocator, stagingBuffer._allocation, &data);
-		std::memcpy(data, vec.data(), vec.size() * sizeof(T));
-		vmaUnmapMemory(_allocator, stagingBuffer._allocation);
-
-		VkBufferUsageFlags bufferUsage = isVertexBuffer ? VK_BUFFER_USAGE_VERTEX_BUFFER_BIT : VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
-
-		// now we need the GPU-side buffer since we've populated the staging buffer
-		VkBufferCreateInfo bufferInfo{};
-		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-		bufferInfo.pNext = nullptr;
-		bufferInfo.size = bufferSize;
-		bufferInfo.usage = bufferUsage | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
-
-		// let the VMA library know that this data should be GPU native
-		vmaAllocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
-
-		VK_CHECK(vmaCreateBuffer(_allocator, &bufferInfo, &vmaAllocInfo,
-			&buffer._buffer,
-			&buffer._allocation,
-			nullptr));
-
-		immediateSubmit([=](VkCommandBuffer cmd) {
-			VkBufferCopy copy;
-			copy.dstOffset = 0;
-			copy.srcOffset = 0;
-			copy.size = bufferSize;
-			vkCmdCopyBuffer(cmd, stagingBuffer._buffer, buffer._buffer, 1, &copy);
-		});
-
-		_mainDeletionQueue.pushFunction([=]() {
-			vmaDestroyBuffer(_allocator, buffer._buffer, buffer._allocation);
-		});
-		vmaDestroyBuffer(_allocator, stagingBuffer._buffer, stagingBuffer._allocation);
-	}
 };
 
 class PipelineBuilder {
@@ -5,22 +5,6 @@
 #include <algorithm>
 
 
-bool RenderObject::operator<(const RenderObject& other) const
-{
-	if (material->pipeline == other.material->pipeline) {
-		return mesh->vertexBuffer._buffer < other.mesh->vertexBuffer._buffer;
-	} else {
-		return material->pipeline < other.material->pipeline;
-	}
-}
-
-void RenderObject::updateSkin() const
-{
-	for (Skin skin : mesh->skel.skins) {
-		skin.update(uniformBlock.transformMatrix);
-	}
-}
-
 VertexInputDescription getVertexDescription(uint32_t attrFlags, uint32_t stride)
 {
 	VertexInputDescription description;
@@ -79,80 +63,86 @@ VertexInputDescription getVertexDescription(uint32_t attrFlags, uint32_t stride)
 	return description;
 }
 
-void updateJointMatrices(Node* root, const glm::mat4& mat)
+void RenderObject::initAnimation()
 {
-	root->cachedMatrix = root->localMatrix() * mat;
+	const SkeletalAnimationData& skel{ mesh->skel };
+
+	animation = AnimationState{};
+	animation.pose = skel.restPose;
+	animation.nodeMatrices.resize(skel.nodeCount(), glm::mat4{ 1.0f });
+	animation.joints.resize(skel.skins.size());
+	animation.jointOffsets.resize(skel.skins.size(), 0);
 
-	for (Node* child : root->children) {
-		updateJointMatrices(child, root->cachedMatrix);
+	for (size_t i{ 0 }; i < skel.skins.size(); ++i) {
+		animation.joints[i].jointCount = (float)std::min((uint32_t)skel.skins[i].joints.size(), MAX_NUM_JOINTS);
 	}
+
+	if (animated()) {
+		size_t samplerCount{ skel.animations[activeAnimation].samplers.size() };
+		animation.cursors.resize(samplerCount, 0);
+		animation.samplerValues.resize(samplerCount);
+	}
+
+	updateSkin();
 }
 
-// m is the renderObject's transform.
-// Updates skin's joint matrices, as well as each bone's transform.
-// Also updates Skin's descriptor
-void Skin::update(const glm::mat4& m)
+// Updates the skins' joint matrices from the pose, as well as each node's transform.
+// The engine copies the joint matrices into the frame allocator when it draws
+void RenderObject::updateSkin()
 {
-	//glm::mat4 inverseTransform = glm::inverse(m);
-	size_t numJoints = (size_t)uniformBlock.jointCount;
+	const SkeletalAnimationData& skel{ mesh->skel };
 
-	updateJointMatrices(skeletonRoot, glm::mat4(1.0f));
+	skel.propagatePose(animation.pose, animation.nodeMatrices);
 
-	for (size_t i = 0; i < numJoints; ++i) {
-		glm::mat4 jointMat = joints[i]->getCachedMatrix() * inverseBindMatrices[i];
-		//jointMat = inverseTransform * jointMat;
-		uniformBlock.jointMatrices[i] = jointMat;
-	}
+	for (size_t s{ 0 }; s < skel.skins.size(); ++s) {
+		const Skin& skin{ skel.skins[s] };
+		Skin::UniformBlockSkinned& joints{ animation.joints[s] };
+		size_t numJoints = (size_t)joints.jointCount;
 
-	void* data;
-	vmaMapMemory(*allocator, ubo._allocation, &data);
-	memcpy(data, &uniformBlock, sizeof(UniformBlockSkinned));
-	vmaUnmapMemory(*allocator, ubo._allocation);
-	vmaFlushAllocation(*allocator, ubo._allocation, 0, VK_WHOLE_SIZE);
+		for (size_t i = 0; i < numJoints; ++i) {
+			joints.jointMatrices[i] = animation.nodeMatrices[skin.joints[i]] * skin.inverseBindMatrices[i];
+		}
+	}
 }
 
-void RenderObject::updateAnimation(float deltaTime) const
+void RenderObject::updateAnimation(float deltaTime)
 {
-	Animation& animation = mesh->skel.animations[activeAnimation];
-	animation.currentTime += deltaTime;
-	if (animation.currentTime > animation.end) {
-		animation.currentTime -= animation.end;
+	const Animation& clip = mesh->skel.animations[activeAnimation];
+	// activeAnimation may have changed since the last update
+	if (animation.cursors.size() != clip.samplers.size()) {
+		animation.cursors.assign(clip.samplers.size(), 0);
+		animation.samplerValues.resize(clip.samplers.size());
+	}
+
+	animation.time += deltaTime;
+	if (animation.time > clip.end) {
+		animation.time -= clip.end;
 	}
 
-	for (AnimationChannel& channel : animation.channels) {
-
-		AnimationSampler& sampler = animation.samplers[channel.samplerIndex];
-		Node& node = mesh->skel.nodes[channel.nodeIdx];
-
-		for (size_t i = 0; i < sampler.inputs.size() - 1; ++i) {
-			// Get the input keyframe values for the current time stamp
-			if ((animation.currentTime >= sampler.inputs[i]) && (animation.currentTime <= sampler.inputs[i + 1])) {
-				// Calculate interpolation value based on timestamp
-				// at input1, a = 0, at input2 a=1, with linear interpolation
-				float a = (animation.currentTime - sampler.inputs[i]) / (sampler.inputs[i + 1] - sampler.inputs[i]);
-
-				if (channel.path == AnimationChannel::TRANSLATION) {
-					node.translation = glm::mix(sampler.outputsVec4[i], sampler.outputsVec4[i + 1], a);
-				}
-				else if (channel.path == AnimationChannel::ROTATION) {
-					glm::quat q1;
-					q1.x = sampler.outputsVec4[i].x;
-					q1.y = sampler.outputsVec4[i].y;
-					q1.z = sampler.outputsVec4[i].z;
-					q1.w = sampler.outputsVec4[i].w;
-
-					glm::quat q2;
-					q2.x = sampler.outputsVec4[i + 1].x;
-					q2.y = sampler.outputsVec4[i + 1].y;
-					q2.z = sampler.outputsVec4[i + 1].z;
-					q2.w = sampler.outputsVec4[i + 1].w;
-
-					node.rotation = glm::normalize(glm::slerp(q1, q2, a));
-				}
-				else if (channel.path == AnimationChannel::SCALE) {
-					node.scale = glm::mix(sampler.outputsVec4[i], sampler.outputsVec4[i + 1], a);
-				}
-			}
+	// every sampler is used by at least one channel, evaluating them up front does each only once
+	for (size_t i{ 0 }; i < clip.samplers.size(); ++i) {
+		if (!clip.samplers[i].inputs.empty()) {
+			animation.samplerValues[i] = clip.samplers[i].evaluate(animation.time, animation.cursors[i]);
+		}
+	}
+
+	for (const AnimationChannel& channel : clip.channels) {
+
+		if (clip.samplers[channel.samplerIndex].inputs.empty()) {
+			continue;
+		}
+
+		const glm::vec4& value{ animation.samplerValues[channel.samplerIndex] };
+		uint32_t node{ channel.nodeIdx };
+
+		if (channel.path == AnimationChannel::TRANSLATION) {
+			animation.pose.translations[node] = value;
+		}
+		else if (channel.path == AnimationChannel::ROTATION) {
+			animation.pose.rotations[node] = glm::quat{ value.w, value.x, value.y, value.z };
+		}
+		else if (channel.path == AnimationChannel::SCALE) {
+			animation.pose.scales[node] = value;
 		}
 	}
 
@@ -164,38 +154,95 @@ bool RenderObject::animated() const
 	return !mesh->skel.animations.empty();
 }
 
-// Node
-
-glm::mat4 Node::localMatrix()
+int32_t RenderObject::vertexOffset() const
 {
-	return glm::translate(glm::mat4(1.0f), translation) * glm::mat4(rotation) * glm::scale(glm::mat4(1.0f), scale) * matrix;
+	if (mesh->vertexFormat == VertexFormat::SKINNED) {
+		return animation.skinnedVertexOffset;
+	}
+	return mesh->vertexOffset;
 }
 
-// potentially expensive... try to avoid calling. instead call skin::update to update cached matrices, and access that
-glm::mat4 Node::getMatrix()
+// SkeletalAnimationData
+
+uint32_t SkeletalAnimationData::nodeCount() const
 {
-	std::cout << "Node::getMatrix() called. Consider calling skin::update instead, then call Node:getCachedMatrix()\n";
+	return static_cast<uint32_t>(parents.size());
+}
 
-	glm::mat4 m = localMatrix();
-	Node* p{ parent };
-	while (p) {
-		m = p->localMatrix() * m;
-		p = p->parent;
+void SkeletalAnimationData::propagatePose(const Pose& pose, std::vector<glm::mat4>& outMatrices) const
+{
+	uint32_t count{ nodeCount() };
+
+	for (uint32_t i{ 0 }; i < count; ++i) {
+		// translation * rotation * scale, with the scale folded into the rotation's columns
+		glm::mat3 rotation{ glm::mat3_cast(pose.rotations[i]) };
+		const glm::vec3& scale{ pose.scales[i] };
+		glm::mat4 local{
+			glm::vec4{ rotation[0] * scale.x, 0.0f },
+			glm::vec4{ rotation[1] * scale.y, 0.0f },
+			glm::vec4{ rotation[2] * scale.z, 0.0f },
+			glm::vec4{ pose.translations[i], 1.0f }
+		};
+		local = local * matrices[i];
+
+		// parents are sorted before their children, so the parent's matrix is already done
+		int32_t parent{ parents[i] };
+		outMatrices[i] = parent < 0 ? local : local * outMatrices[parent];
 	}
-	return m;
 }
 
-glm::mat4 Node::getCachedMatrix()
+// AnimationSampler
+
+uint32_t AnimationSampler::findKey(float time, uint32_t& cursor) const
 {
-	return cachedMatrix;
+	uint32_t last{ static_cast<uint32_t>(inputs.size()) - 1 };
+
+	if (last == 0 || time <= inputs[0]) {
+		cursor = 0;
+		return cursor;
+	}
+	if (time >= inputs[last]) {
+		cursor = last - 1;
+		return cursor;
+	}
+
+	// playback moves forward in small steps, so the key is almost always the cursor or the next one
+	if (cursor < last && time >= inputs[cursor]) {
+		if (time < inputs[cursor + 1]) {
+			return cursor;
+		}
+		if (cursor + 1 < last && time < inputs[cursor + 2]) {
+			return ++cursor;
+		}
+	}
+
+	// looped or skipped ahead, first key after time is the end of the interval
+	auto next{ std::upper_bound(inputs.begin(), inputs.end(), time) };
+	cursor = static_cast<uint32_t>(next - inputs.begin()) - 1;
+	return cursor;
 }
 
-Node::~Node()
+glm::vec4 AnimationSampler::evaluate(float time, uint32_t& cursor) const
 {
-	//if (renderObject) {
-	//	delete renderObject;
-	//}
-	//for (auto& child : children) {
-	//	delete child;
-	//}
+	uint32_t i{ findKey(time, cursor) };
+
+	// hold the first and last key outside of the sampler's range
+	if (inputs.size() == 1 || time <= inputs[0]) {
+		return outputsVec4[0];
+	}
+	if (time >= inputs.back()) {
+		return outputsVec4.back();
+	}
+
+	// at input1, a = 0, at input2 a=1, with linear interpolation
+	float a{ (time - inputs[i]) / (inputs[i + 1] - inputs[i]) };
+
+	if (rotation) {
+		glm::quat q1{ outputsVec4[i].w, outputsVec4[i].x, outputsVec4[i].y, outputsVec4[i].z };
+		glm::quat q2{ outputsVec4[i + 1].w, outputsVec4[i + 1].x, outputsVec4[i + 1].y, outputsVec4[i + 1].z };
+		glm::quat q{ glm::normalize(glm::slerp(q1, q2, a)) };
+		return glm::vec4{ q.x, q.y, q.z, q.w };
+	}
+
+	return glm::mix(outputsVec4[i], outputsVec4[i + 1], a);
 }
@@ -13,7 +13,7 @@
 #include "asset_loader.h"
 #include "json.hpp"
 
-// Changing this value here also requires changing it in the vertex shader
+// Changing this value here also requires changing it in skinning.comp
 constexpr uint32_t MAX_NUM_JOINTS{ 128 };
 
 // ------------------------------------------------------------------------------------------ //
@@ -65,25 +65,18 @@ VertexInputDescription getVertexDescription(uint32_t attrFlags, uint32_t stride)
 //                                         Skeleton                                           //
 // ------------------------------------------------------------------------------------------ //
 
-struct Node;
-
 struct Skin {
 	std::string name;
-	Node* skeletonRoot{}; // node which is root of skeleton
+	uint32_t skeletonRoot{}; // index of node which is root of skeleton
 	//Node* meshNode{}; // node which has a pointer to the mesh
 	std::vector<glm::mat4> inverseBindMatrices;
-	std::vector<Node*> joints;
-	AllocatedBuffer ubo; // pass actual joint matrices for current animation frame using ubo
-	VkDescriptorSet jointsDescriptorSet;
-	VkDescriptorSet jointsShadowDescriptorSet;
-	VmaAllocator* allocator;
+	// indices of the joints' nodes
+	std::vector<uint32_t> joints;
 
 	struct UniformBlockSkinned {
 		glm::mat4 jointMatrices[MAX_NUM_JOINTS]{};
 		float jointCount{ 0 };
-	} uniformBlock;
-
-	void update(const glm::mat4& m);
+	};
 };
 
 enum class Interpolation {
@@ -117,6 +110,15 @@ struct AnimationSampler {
 	InterpolationType interpolation;
 	std::vector<float> inputs;
 	std::vector<glm::vec4> outputsVec4;
+	// set on load from the channels using the sampler, rotations are slerped instead of lerped
+	bool rotation{ false };
+
+	// index i of the key with inputs[i] <= time < inputs[i + 1], clamped to the first and last key.
+	// cursor is the key of the last lookup, playback usually stays in it or moves to the next one,
+	// so those are checked before falling back to a binary search
+	uint32_t findKey(float time, uint32_t& cursor) const;
+
+	glm::vec4 evaluate(float time, uint32_t& cursor) const;
 
 	template<class Archive>
 	void serialize(Archive& archive)
@@ -131,7 +133,6 @@ struct Animation {
 	std::vector<AnimationChannel> channels;
 	float start = std::numeric_limits<float>::max();
 	float end = std::numeric_limits<float>::min();
-	float currentTime{ 0.0f };
 
 	template<class Archive>
 	void serialize(Archive& archive)
@@ -143,55 +144,82 @@ struct Animation {
 struct Mesh;
 struct RenderObject;
 
-struct Node {
-	Node* parent;
-	std::vector<Node*> children;
-	glm::mat4 matrix;
-	glm::mat4 cachedMatrix;
-	std::string name;
-	glm::vec3 translation{};
-	glm::vec3 scale{ 1.0f };
-	glm::quat rotation{};
-	//BoundingBox bvh;
-	//BoundingBox aabb;
-
-	glm::mat4 localMatrix();
-	glm::mat4 getMatrix();
-	glm::mat4 getCachedMatrix();
-	~Node();
+// local transforms of a skeleton's nodes. Structure of arrays, so sampling and the pose pass each
+// stream through only the components they touch
+struct Pose {
+	std::vector<glm::vec3> translations;
+	std::vector<glm::quat> rotations;
+	std::vector<glm::vec3> scales;
 };
 
+// read only after load, so any number of render objects can play the mesh's animations.
+// The nodes are flattened into arrays the baker sorted so every parent comes before its children
 struct SkeletalAnimationData {
-	std::vector<Node> nodes;
-	//std::vector<Node*> linearNodes;
+	// -1 for root nodes and for the skeleton root of each skin, since joint matrices are relative to it
+	std::vector<int32_t> parents;
+	// matrix of the glTF node, applied before its translation, rotation and scale
+	std::vector<glm::mat4> matrices;
+	std::vector<std::string> names;
+	Pose restPose;
 	std::vector<Animation> animations;
 	std::vector<Skin> skins;
+
+	uint32_t nodeCount() const;
+
+	// model space transforms of every node from their local pose, in one pass over the sorted nodes
+	void propagatePose(const Pose& pose, std::vector<glm::mat4>& outMatrices) const;
+};
+
+// playback state and pose of one render object
+struct AnimationState {
+	float time{ 0.0f };
+	// key of the last lookup of each of the active animation's samplers
+	std::vector<uint32_t> cursors;
+	// value of each sampler at time, so samplers shared between channels are evaluated once
+	std::vector<glm::vec4> samplerValues;
+	// local transform of each node
+	Pose pose;
+	// transform of each node relative to its skeleton's root
+	std::vector<glm::mat4> nodeMatrices;
+	// joint matrices of each skin, pushed to the frame allocator every frame
+	std::vector<Skin::UniformBlockSkinned> joints;
+	// dynamic offset of this frame's copy of joints[i] in the engine's FrameAllocator
+	std::vector<uint32_t> jointOffsets;
+	// first vertex of this frame's skinned copy of the mesh in ComputeSkinning's vertex buffer
+	int32_t skinnedVertexOffset{ 0 };
 };
 
 // ------------------------------------------------------------------------------------------ //
 //                                         Mesh                                               //
 // ------------------------------------------------------------------------------------------ //
 
+struct MeshBounds {
+
+	float origin[3];
+	float radius;
+	float extents[3];
+};
+
 struct Mesh {
 	VertexFormat vertexFormat;
 	// vertex data on CPU
 	std::vector<Vertex> vertices;
 	std::vector<VertexSkinned> verticesSkinned;
 	std::vector<uint16_t> indices;
-	// vertex data on GPU
-	AllocatedBuffer vertexBuffer;
-	AllocatedBuffer indexBuffer;
+	// location of the vertex data in the engine's GeometryPool. vertexOffset is in vertices of vertexFormat
+	int32_t vertexOffset;
+	uint32_t vertexCount;
+	uint32_t firstIndex;
+	// meshes loaded from assets skip the CPU copy, so we can't rely on indices.size()
+	uint32_t indexCount;
+	// bounding sphere used for GPU culling, a negative radius means the mesh is never culled
+	MeshBounds bounds{ { 0.0f, 0.0f, 0.0f }, -1.0f, { 0.0f, 0.0f, 0.0f } };
+	// small id for packing into draw sort keys
+	uint32_t sortId;
 
 	SkeletalAnimationData skel;
 };
 
-struct MeshBounds {
-
-	float origin[3];
-	float radius;
-	float extents[3];
-};
-
 // ------------------------------------------------------------------------------------------ //
 //                                         Material                                           //
 // ------------------------------------------------------------------------------------------ //
@@ -206,10 +234,14 @@ struct Texture {
 // They are 64 bit handles to internal driver structures anyway so storing
 // a pointer to them isn't very useful
 struct Material {
-	// analogous to instance of descriptor set layout, which is why it's per material
-	VkDescriptorSet textureSet;
+	// analogous to instance of descriptor set layout, which is why it's per material. One per frame in flight,
+	// so streamed textures can be written into the current frame's set while the other frame still uses its own
+	std::vector<VkDescriptorSet> textureSets;
 	VkPipeline pipeline;
 	VkPipelineLayout pipelineLayout;
+	// small ids for packing into draw sort keys
+	uint32_t sortId;
+	uint32_t pipelineSortId;
 };
 
 struct MaterialCreateInfo {
@@ -219,20 +251,29 @@ struct MaterialCreateInfo {
 	uint32_t attributeFlags;
 	std::vector<VkDescriptorSetLayoutBinding> bindings;
 	std::vector<Texture> bindingTextures;
+	// names of bindingTextures, so bindings to streamed textures can be updated once they're resident
+	std::vector<std::string> bindingPaths;
 };
 
 struct RenderObject {
 	Mesh* mesh;
 	Material* material;
 	bool castShadow;
+	// never moves, so its shadow is cached instead of drawn every frame. Moving it anyway redraws the cache
+	bool isStatic;
 	int32_t activeAnimation;
+	// empty unless the mesh has a skeleton
+	AnimationState animation;
 
 	struct RenderObjectUB {
 		mutable glm::mat4 transformMatrix;
 	} uniformBlock;
 
-	bool operator<(const RenderObject& other) const;
-	void updateSkin() const;
-	void updateAnimation(float deltaTime) const;
+	// size the pose for the mesh's skeleton and put it in the rest pose
+	void initAnimation();
+	void updateSkin();
+	void updateAnimation(float deltaTime);
 	bool animated() const;
+	// first vertex to draw from, skinned meshes are drawn from their skinned copy
+	int32_t vertexOffset() const;
 };
@@ -2,6 +2,7 @@
 
 #include <iostream>
 #include <cmath>
+#include <algorithm>
 
 #include "vk_initializers.h"
 #include "asset_loader.h"
@@ -92,14 +93,78 @@ void vkutil::generateMipmaps(VkCommandBuffer cmd, VkImage image, int32_t texWidt
 		1, &barrier);
 }
 
-void uploadImage(VulkanEngine& engine, assets::TextureInfo info, VkFormat format, const AllocatedBuffer& stagingBuffer, AllocatedImage& outImage) {
+bool vkutil::getTextureFormatInfo(assets::TextureFormat textureFormat, TextureFormatInfo& outInfo)
+{
+	const VkComponentMapping identity{ VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY };
+	// BC4 only has a red channel, so broadcast it to let shaders read it from whichever channel they expect
+	const VkComponentMapping broadcastRed{ VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_ONE };
+
+	switch (textureFormat) {
+	case assets::TextureFormat::RGBA8:
+		outInfo = { VK_FORMAT_R8G8B8A8_UNORM, 1, 4, identity };
+		break;
+	case assets::TextureFormat::SRGBA8:
+		outInfo = { VK_FORMAT_R8G8B8A8_SRGB, 1, 4, identity };
+		break;
+	case assets::TextureFormat::BC4:
+		outInfo = { VK_FORMAT_BC4_UNORM_BLOCK, 4, 8, broadcastRed };
+		break;
+	case assets::TextureFormat::BC5:
+		outInfo = { VK_FORMAT_BC5_UNORM_BLOCK, 4, 16, identity };
+		break;
+	case assets::TextureFormat::BC7:
+		outInfo = { VK_FORMAT_BC7_UNORM_BLOCK, 4, 16, identity };
+		break;
+	case assets::TextureFormat::BC7_SRGB:
+		outInfo = { VK_FORMAT_BC7_SRGB_BLOCK, 4, 16, identity };
+		break;
+	default:
+		return false;
+	}
+
+	return true;
+}
+
+std::vector<VkBufferImageCopy> vkutil::mipCopyRegions(VkExtent3D extent, uint32_t mipLevels, const TextureFormatInfo& formatInfo, VkDeviceSize bufferOffset)
+{
+	VkDeviceSize offset{ bufferOffset };
+	std::vector<VkBufferImageCopy> copyRegions;
+	copyRegions.reserve(mipLevels);
+
+	for (uint32_t i{ 0 }; i < mipLevels; ++i) {
+		VkBufferImageCopy copyRegion{};
+		copyRegion.bufferOffset = offset;
+		copyRegion.bufferRowLength = 0;
+		copyRegion.bufferImageHeight = 0;
+		copyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		copyRegion.imageSubresource.mipLevel = i;
+		copyRegion.imageSubresource.baseArrayLayer = 0;
+		copyRegion.imageSubresource.layerCount = 1;
+		copyRegion.imageExtent = extent;
+
+		copyRegions.push_back(copyRegion);
+
+		// mips are tightly packed, block compressed mips are padded to whole blocks
+		VkDeviceSize blocksX{ (extent.width + formatInfo.blockDim - 1) / formatInfo.blockDim };
+		VkDeviceSize blocksY{ (extent.height + formatInfo.blockDim - 1) / formatInfo.blockDim };
+		offset += blocksX * blocksY * formatInfo.blockBytes;
+
+		// halve dimensions of image for each mipmap level
+		extent.width = std::max(extent.width >> 1, 1u);
+		extent.height = std::max(extent.height >> 1, 1u);
+	}
+
+	return copyRegions;
+}
+
+void uploadImage(VulkanEngine& engine, assets::TextureInfo info, const vkutil::TextureFormatInfo& formatInfo, const UploadBatch::StagingAllocation& staging, AllocatedImage& outImage) {
 	ZoneScoped;
 	VkExtent3D imageExtent{};
 	imageExtent.width = static_cast<uint32_t>(info.width);
 	imageExtent.height = static_cast<uint32_t>(info.height);
 	imageExtent.depth = 1;
 
-	VkImageCreateInfo dimg_info{ vkinit::imageCreateInfo(format, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, imageExtent, info.miplevels) };
+	VkImageCreateInfo dimg_info{ vkinit::imageCreateInfo(formatInfo.format, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, imageExtent, info.miplevels) };
 
 	AllocatedImage newImage;
 
@@ -112,95 +177,27 @@ void uploadImage(VulkanEngine& engine, assets::TextureInfo info, VkFormat format
 		&newImage._allocation,
 		nullptr);
 
-	// we must transfer the image to transfer dst layout before copying the buffer to the image
-	engine.immediateSubmit([=](VkCommandBuffer cmd) {
-		VkImageSubresourceRange range{};
-		range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		range.baseMipLevel = 0;
-		range.levelCount = info.miplevels;
-		range.baseArrayLayer = 0;
-		range.layerCount = 1;
-
-		VkImageMemoryBarrier imageBarrierToTransfer{};
-		imageBarrierToTransfer.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-		imageBarrierToTransfer.pNext = nullptr;
-		imageBarrierToTransfer.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		imageBarrierToTransfer.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-		imageBarrierToTransfer.image = newImage._image;
-		imageBarrierToTransfer.subresourceRange = range;
-		imageBarrierToTransfer.srcAccessMask = 0;
-		imageBarrierToTransfer.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-
-		vkCmdPipelineBarrier(cmd,
-			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
-			0,
-			0, nullptr,
-			0, nullptr,
-			1, &imageBarrierToTransfer);
-
-		VkExtent3D extent{ imageExtent };
-		VkDeviceSize offset{ 0 };
-		std::vector<VkBufferImageCopy> copyRegions;
-
-		for (int i{ 0 }; i < info.miplevels; ++i) {
-			VkBufferImageCopy copyRegion{};
-			copyRegion.bufferOffset = offset * 4; // multiply by 4 since texel is 4 bytes
-			copyRegion.bufferRowLength = 0;
-			copyRegion.bufferImageHeight = 0;
-			copyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			copyRegion.imageSubresource.mipLevel = i;
-			copyRegion.imageSubresource.baseArrayLayer = 0;
-			copyRegion.imageSubresource.layerCount = 1;
-			copyRegion.imageExtent = extent;
-
-			copyRegions.push_back(copyRegion);
-
-			// halve dimensions of image for each mipmap level
-			offset += (VkDeviceSize)extent.width * extent.height;
-			extent.width >>= 1;
-			extent.height >>= 1;
-		}
-
-		// copy the buffer into the image
-		vkCmdCopyBufferToImage(cmd, stagingBuffer._buffer, newImage._image,
-			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, copyRegions.size(), copyRegions.data());
-
-		// now that we've copied the buffer into the image, we change the
-		// image layout once more to make it readable from shaders
-		VkImageMemoryBarrier imageBarrierToReadable{ imageBarrierToTransfer };
-		imageBarrierToReadable.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-		imageBarrierToReadable.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-		imageBarrierToReadable.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-		imageBarrierToReadable.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-		vkCmdPipelineBarrier(cmd,
-			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-			0,
-			0, nullptr,
-			0, nullptr,
-			1, &imageBarrierToReadable);
-	});
+	// the batch transitions the image to transfer dst, copies every mip and makes it shader readable when it's submitted
+	engine._uploadBatch.copyBufferToImage(staging, newImage._image, info.miplevels, vkutil::mipCopyRegions(imageExtent, info.miplevels, formatInfo, 0));
 
 	engine._mainDeletionQueue.pushFunction([=, &engine]() {
 		vmaDestroyImage(engine._allocator, newImage._image, newImage._allocation);
 	});
 
-	// caller responsible for destroying staging buffer
-
 	outImage = newImage;
 }
 
-bool vkutil::loadImageFromAsset(VulkanEngine& engine, const char* path, VkFormat format, uint32_t* outMipLevels, AllocatedImage& outImage)
+bool vkutil::loadImageFromAsset(VulkanEngine& engine, const char* path, VkFormat format, uint32_t* outMipLevels, AllocatedImage& outImage, VkFormat* outFormat, VkComponentMapping* outComponents)
 {
 	ZoneScoped;
-	assets::AssetFile file;
+	assets::AssetView view;
 	nlohmann::json metadata;
 
 	{
-		ZoneScopedN("load_binaryfile");
-		bool loaded{ assets::loadBinaryFile(path, file, metadata) };
+		ZoneScopedN("map_binaryfile");
+		bool mapped{ assets::mapBinaryFile(path, view, metadata) };
 
-		if (!loaded) {
+		if (!mapped) {
 			std::cout << "Error when loading image\n";
 			return false;
 		}
@@ -214,40 +211,39 @@ bool vkutil::loadImageFromAsset(VulkanEngine& engine, const char* path, VkFormat
 
 	*outMipLevels = (uint32_t)texInfo.miplevels;
 
-	VkFormat image_format;
-	switch (texInfo.textureFormat) {
-
-	case assets::TextureFormat::RGBA8:
-		image_format = VK_FORMAT_R8G8B8A8_UNORM;
-		break;
-	case assets::TextureFormat::SRGBA8:
-		image_format = VK_FORMAT_R8G8B8A8_SRGB;
-		break;
-	default:
+	vkutil::TextureFormatInfo formatInfo;
+	if (!vkutil::getTextureFormatInfo(texInfo.textureFormat, formatInfo)) {
+		std::cout << "Error: unsupported texture format\n";
+		assets::unmapBinaryFile(view);
 		return false;
 	}
 
-	AllocatedBuffer stagingBuffer{ engine.createBuffer(texInfo.originalSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY) };
+	// uncompressed textures keep the format requested by the material, so it can decide whether they're srgb.
+	// Block compressed data can only be viewed in the format it was encoded as
+	if (formatInfo.blockDim == 1) {
+		formatInfo.format = format;
+	}
+	*outFormat = formatInfo.format;
+	*outComponents = formatInfo.components;
 
-	void* data;
-	vmaMapMemory(engine._allocator, stagingBuffer._allocation, &data);
+	UploadBatch::StagingAllocation staging{ engine._uploadBatch.allocate(texInfo.originalSize) };
 
+	bool unpacked;
 	{
+		// pixels go straight from the mapped file into the upload arena
 		ZoneScopedN("unpack_texture");
-		//assets::unpackTexture(file.binaryBlob.data(), (char*)data, texInfo.compressedSize, texInfo.originalSize);
-		assets::unpackTexture(file.binaryBlob.data(), file.binaryBlob.size(), data);
+		unpacked = assets::unpackBlob(view, texInfo.compressionMode, staging.data);
 	}
 
-	vmaUnmapMemory(engine._allocator, stagingBuffer._allocation);
+	assets::unmapBinaryFile(view);
 
+	if (!unpacked) {
+		std::cout << "Error when unpacking image\n";
+		return false;
+	}
 
-	//outImage = upload_image(textureInfo.pixelsize[0], textureInfo.pixelsize[1], image_format, engine, stagingBuffer);
-	uploadImage(engine, texInfo, format, stagingBuffer, outImage);
+	uploadImage(engine, texInfo, formatInfo, staging, outImage);
 
-	{
-		ZoneScopedN("destroy_buffer");
-		vmaDestroyBuffer(engine._allocator, stagingBuffer._buffer, stagingBuffer._allocation);
-	}
 	//{
 	//	ZoneScopedN("print");
 	//	std::cout << "Texture loaded successfully " << path << '\n';
@@ -2,10 +2,29 @@
 
 #include "vk_types.h"
 #include "vk_engine.h"
+#include "texture_asset.h"
 
 namespace vkutil {
 
-	bool loadImageFromAsset(VulkanEngine& engine, const char* filename, VkFormat format, uint32_t* outMipLevels, AllocatedImage& outImage);
+	// How a texture format from the baker is laid out in the staging buffer and how it should be viewed
+	struct TextureFormatInfo {
+		VkFormat format;
+		// width and height of a block in texels, 1 for uncompressed formats
+		uint32_t blockDim;
+		uint32_t blockBytes;
+		VkComponentMapping components;
+	};
+
+	// returns false for formats we can't upload
+	bool getTextureFormatInfo(assets::TextureFormat textureFormat, TextureFormatInfo& outInfo);
+
+	// one copy per mip, for a full mip chain tightly packed in a buffer starting at bufferOffset
+	std::vector<VkBufferImageCopy> mipCopyRegions(VkExtent3D extent, uint32_t mipLevels, const TextureFormatInfo& formatInfo, VkDeviceSize bufferOffset);
+
+	// format is used for uncompressed textures, block compressed textures use the format they were baked with.
+	// The format and swizzle the image should be viewed with are written to outFormat and outComponents.
+	// The copy is recorded into engine._uploadBatch and happens when the batch is next submitted
+	bool loadImageFromAsset(VulkanEngine& engine, const char* filename, VkFormat format, uint32_t* outMipLevels, AllocatedImage& outImage, VkFormat* outFormat, VkComponentMapping* outComponents);
 
 	bool loadImageFromFile(VulkanEngine& engine, const char* file, AllocatedImage& outImage, uint32_t* outMipLevels, VkFormat format);
 